@@ -0,0 +1,315 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+export module allocator;
+
+
+// 按大小分级的内存池，用于 quickjs 运行时中大量短生命周期的小对象
+// 每个运行时有自己的内存池，小于等于 512 字节的内存块从对应级别的空闲链表中分配，更大的内存块直接使用 malloc
+// 每个内存页只属于一个级别，并记录其中正在使用的内存块数量，trim 时把完全空闲的内存页还给系统
+// 内存池不加锁，同一时间只能由一个线程使用；多目标模式中一个运行时的事件循环同一时间只在一个线程上执行
+export namespace allocator {
+    // 每个内存块前面的头部大小，同时也是内存块的对齐大小
+    constexpr size_t headerSize = 16;
+
+    class Pool;
+
+    auto usableSize(const void* ptr) -> size_t;
+}
+
+
+// 内存块的头部，sizeClass 为 largeClass 时表示直接使用 malloc 分配的大内存块，slab 为内存块所在的内存页的下标
+struct alignas(allocator::headerSize) BlockHeader {
+    uint32_t sizeClass;
+    uint32_t slab;
+    size_t size;
+};
+
+// 空闲的内存块复用头部中 size 的空间组成单向链表，sizeClass 和 slab 保持不变
+struct FreeBlock {
+    uint32_t sizeClass;
+    uint32_t slab;
+    FreeBlock* next;
+};
+
+static_assert(sizeof(FreeBlock) <= sizeof(BlockHeader));
+
+// 向系统申请的内存页，memory 为空表示已经释放，下标可以被新的内存页复用
+struct Slab {
+    std::byte* memory;
+    size_t liveBlocks;
+};
+
+
+constexpr uint32_t largeClass = 0xFFFFFFFF;
+
+// 每一级内存块的可用大小
+constexpr std::array<size_t, 16> classSizes = { 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512 };
+
+constexpr size_t maxPooledSize = classSizes.back();
+
+// 每次向系统申请的内存页大小，与 Windows 上 VirtualAlloc 的分配粒度相同
+constexpr size_t slabSize = 64 * 1024;
+
+// 内存页直接向系统申请，不经过 malloc，trim 释放后立即从常驻内存中移除
+auto allocateSlab() -> std::byte* {
+#ifdef _WIN32
+    return static_cast<std::byte*>(VirtualAlloc(nullptr, slabSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+    void* memory = mmap(nullptr, slabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? nullptr : static_cast<std::byte*>(memory);
+#endif
+}
+
+void freeSlab(std::byte* memory) {
+    if (!memory)
+        return;
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, slabSize);
+#endif
+}
+
+// 以 16 字节为单位，查找对应的内存块级别
+constexpr auto classIndexTable = []() {
+    std::array<uint8_t, maxPooledSize / 16 + 1> table {};
+    for (size_t units = 0, index = 0; units < table.size(); units++) {
+        while (classSizes[index] < units * 16)
+            index++;
+        table[units] = static_cast<uint8_t>(index);
+    }
+    return table;
+}();
+
+
+class allocator::Pool {
+public:
+    Pool() = default;
+
+    // 释放所有内存页，需要在所有内存块都不再使用之后 (运行时销毁之后) 销毁
+    ~Pool();
+
+    auto allocate(size_t size) -> void*;
+
+    void deallocate(void* ptr);
+
+    auto reallocate(void* ptr, size_t size) -> void*;
+
+    // 正在使用的字节数
+    auto liveBytes() const -> size_t { return live; }
+
+    // 释放没有正在使用的内存块的内存页，返回释放的字节数；需要遍历所有空闲链表，适合在 GC 之后调用
+    auto trim() -> size_t;
+
+    // 统计信息: 正在使用的字节数、峰值、向系统申请的字节数、碎片率
+    auto stats() const;
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+private:
+    std::array<FreeBlock*, classSizes.size()> freeLists {};
+    std::vector<Slab> slabs {};
+    std::vector<uint32_t> freeSlabIndices {};
+    size_t slabCount = 0;
+
+    size_t live = 0;
+    size_t peakBytes = 0;
+    size_t pooledLiveBytes = 0;
+    size_t largeBytes = 0;
+
+    void refill(uint32_t sizeClass);
+
+    void track(ptrdiff_t bytes) {
+        live += bytes;
+        peakBytes = std::max(peakBytes, live);
+    }
+};
+
+
+allocator::Pool::~Pool() {
+    for (Slab& slab: slabs)
+        freeSlab(slab.memory);
+}
+
+
+void allocator::Pool::refill(uint32_t sizeClass) {
+    size_t blockSize = allocator::headerSize + classSizes[sizeClass];
+    std::byte* memory = allocateSlab();
+    if (!memory)
+        return;
+
+    uint32_t index;
+    if (!freeSlabIndices.empty()) {
+        index = freeSlabIndices.back();
+        freeSlabIndices.pop_back();
+        slabs[index] = { memory, 0 };
+    }
+    else {
+        index = static_cast<uint32_t>(slabs.size());
+        slabs.push_back({ memory, 0 });
+    }
+    slabCount++;
+
+    for (size_t offset = 0; offset + blockSize <= slabSize; offset += blockSize) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(memory + offset);
+        block->sizeClass = sizeClass;
+        block->slab = index;
+        block->next = freeLists[sizeClass];
+        freeLists[sizeClass] = block;
+    }
+}
+
+
+
+
+auto allocator::Pool::allocate(size_t size) -> void* {
+    BlockHeader* header;
+
+    if (size <= maxPooledSize) {
+        uint32_t sizeClass = classIndexTable[(size + 15) / 16];
+
+        if (!freeLists[sizeClass])
+            refill(sizeClass);
+
+        FreeBlock* block = freeLists[sizeClass];
+        if (!block)
+            return nullptr;
+        freeLists[sizeClass] = block->next;
+        slabs[block->slab].liveBlocks++;
+
+        header = reinterpret_cast<BlockHeader*>(block);
+        header->size = classSizes[sizeClass];
+        pooledLiveBytes += header->size;
+    }
+
+    else {
+        header = static_cast<BlockHeader*>(std::malloc(headerSize + size));
+        if (!header)
+            return nullptr;
+        header->sizeClass = largeClass;
+        header->size = size;
+        largeBytes += size;
+    }
+
+    track(header->size);
+    return reinterpret_cast<std::byte*>(header) + headerSize;
+}
+
+
+void allocator::Pool::deallocate(void* ptr) {
+    if (!ptr)
+        return;
+
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<std::byte*>(ptr) - headerSize);
+    track(-static_cast<ptrdiff_t>(header->size));
+
+    if (header->sizeClass == largeClass) {
+        largeBytes -= header->size;
+        std::free(header);
+        return;
+    }
+
+    pooledLiveBytes -= header->size;
+    slabs[header->slab].liveBlocks--;
+
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(header);
+    block->next = freeLists[block->sizeClass];
+    freeLists[block->sizeClass] = block;
+}
+
+
+// 先从空闲链表中去掉空闲内存页中的内存块，再释放这些内存页
+auto allocator::Pool::trim() -> size_t {
+    for (FreeBlock*& head: freeLists) {
+        FreeBlock** link = &head;
+        while (FreeBlock* block = *link) {
+            if (slabs[block->slab].liveBlocks == 0)
+                *link = block->next;
+            else link = &block->next;
+        }
+    }
+
+    size_t released = 0;
+    for (uint32_t index = 0; index < slabs.size(); index++) {
+        Slab& slab = slabs[index];
+        if (!slab.memory || slab.liveBlocks > 0)
+            continue;
+        freeSlab(slab.memory);
+        slab.memory = nullptr;
+        freeSlabIndices.push_back(index);
+        slabCount--;
+        released += slabSize;
+    }
+    return released;
+}
+
+
+auto allocator::Pool::reallocate(void* ptr, size_t size) -> void* {
+    if (!ptr)
+        return allocate(size);
+
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<std::byte*>(ptr) - headerSize);
+
+    // 原来的内存块已经足够大，并且不会浪费太多空间时，直接复用
+    if (header->sizeClass != largeClass && size <= header->size && (size > maxPooledSize / 2 || size * 2 > header->size))
+        return ptr;
+
+    // 大内存块之间直接使用 realloc
+    if (header->sizeClass == largeClass && size > maxPooledSize) {
+        size_t oldSize = header->size;
+        BlockHeader* newHeader = static_cast<BlockHeader*>(std::realloc(header, headerSize + size));
+        if (!newHeader)
+            return nullptr;
+        newHeader->size = size;
+        largeBytes += size - oldSize;
+        track(static_cast<ptrdiff_t>(size) - static_cast<ptrdiff_t>(oldSize));
+        return reinterpret_cast<std::byte*>(newHeader) + headerSize;
+    }
+
+    void* newPtr = allocate(size);
+    if (!newPtr)
+        return nullptr;
+    memcpy(newPtr, ptr, std::min(size, header->size));
+    deallocate(ptr);
+    return newPtr;
+}
+
+
+auto allocator::usableSize(const void* ptr) -> size_t {
+    if (!ptr)
+        return 0;
+    return reinterpret_cast<const BlockHeader*>(static_cast<const std::byte*>(ptr) - headerSize)->size;
+}
+
+
+auto allocator::Pool::stats() const {
+    double slabBytes = static_cast<double>(slabCount * slabSize);
+    double reservedBytes = slabBytes + largeBytes;
+
+    // 碎片率: 内存页中没有被使用的部分所占的比例
+    double fragmentation = slabBytes > 0 ? 1.0 - pooledLiveBytes / slabBytes : 0.0;
+
+    return std::make_tuple(
+        std::make_pair("liveBytes", static_cast<double>(live)),
+        std::make_pair("peakBytes", static_cast<double>(peakBytes)),
+        std::make_pair("reservedBytes", reservedBytes),
+        std::make_pair("fragmentation", fragmentation)
+    );
+}
@@ -1,104 +1,480 @@
+import { print, input, log, setState, setCounter, addCounter } from "native:console"
+import { 
+    getPid, getHwnd, getWndSize, captureWindow, saveBitmapImage, setFramePoolCapacity, framePoolStats,
+    addFrameRegion, clearFrameRegions, getFramePixel, captureFrame, frameCacheStats,
+    trackWindow, untrackWindow, validateWindow, 
+    createCalibration, destroyCalibration, addCalibrationPoint, addCalibrationRect, updateCalibration, getCalibrationPoint, getCalibrationRect,
+    getDC, getPixel, postMessageW, releaseDC, clipCursor, setForegroundWindow, keybdEvent, mouseEvent, isKeyDown,
+    tryBeginInput, endInput
+} from "native:win"
+import { fingerprint, compareFingerprints, findBlobs, sobel, createOutlineTemplate, destroyOutlineTemplate, matchOutline, createDetectorBank, destroyDetectorBank, addDetector, scanDetectorBank, detectorBankStats } from "native:image"
+import { createWatcher, destroyWatcher, scanWatcher } from "native:process"
+import { mkdir, allocatorStats, startupReady, setReloadTarget } from "native:os"
+import { memoryUsage, setGCThreshold, setMemoryLimit, gc, gcStats, setWatchdog, watchdogStats, sleep as sleepSync } from "native:runtime"
+import { intern, write as writeEvent, writeText as writeEventText, stats as eventLogStats } from "native:eventlog"
+import { enable as traceEnable, isEnabled as traceIsEnabled, now as traceNow, complete as traceComplete, instant as traceInstant, save as saveTrace, stats as traceStats } from "native:trace"
+
 export function sleep(ms) {
   return new Promise((resolve, reject) => setTimeout(resolve, ms));
 }
 
+// 多目标模式下其它目标持有输入事务时，输入函数不执行并返回 false，每隔 5ms 重试直到成功
+async function retryInput(attempt) {
+    let result
+    while(!(result = attempt()))
+        await sleep(5)
+    return result
+}
+
 export const console = {
-    log: (text) => {
-        const date = new Date()
-        const hours = date.getHours().toString().padStart(2, '0')
-        const miuntes = date.getMinutes().toString().padStart(2, '0')
-        const seconds = date.getSeconds().toString().padStart(2, '0')
-        
-        _print(`[${hours}:${miuntes}:${seconds}]${text}\n`)
-    },
+    /** 带时间戳的日志，时间戳由原生代码生成；状态面板开启时显示在面板的最近事件中
+     * @type {function(string)} */
+    log,
 
     info: (text) => console.log(`${ansi.green("[Info]")} ${text}`),
-    error: (text) => console.log(`${ansi.red("[Error]")} ${text}`),
+    error: (text) => {
+        eventlog.error(text)
+        console.log(`${ansi.red("[Error]")} ${text}`)
+    },
     
     /**@type {function(any)} */
-    print: _print,
+    print,
     
     /**@type {function(): string} */
-    input: _input
+    input
+}
+
+// 控制台状态面板，原地刷新显示当前状态和计数器
+export const status = {
+    /**@type {function(string)} */
+    setState,
+
+    /**@type {function(name, value)} */
+    set: setCounter,
+
+    /**@type {function(name, delta)} */
+    add: (name, delta = 1) => addCounter(name, delta),
 }
 
 export const win = {
     /**@type {function(processName): pid} */
-    getPid: _getPid,
+    getPid,
 
     /**@type {function(pid): hwnd} */
-    getHwnd: _getHwnd,
+    getHwnd,
     
     /**@type {function(hwnd): {width:number, height: number}} */
-    getWndSize: _getWndSize,
+    getWndSize,
 
     /**@type {function(hwnd): hdc} */
-    getDC: _getDC,
+    getDC,
 
     /**@type {function(hwnd, x, y): number} */
-    getPixel: _getPixel,
-
-    /**@type {function(hwnd): boolean} */
-    setForegroundWindow: _setForegroundWindow,
+    getPixel,
+
+    /** 多目标模式下其它目标的输入事务进行中时返回 false，clipCursor、keybdEvent 和 mouseEvent 也是如此
+     * @type {function(hwnd): boolean} */
+    setForegroundWindow,
+
+    /** 执行一次输入，其它目标的输入事务进行中时等待它结束后重试，例如 await win.retryInput(() => keyboard.keyDown('F'))
+     * @type {function(function(): boolean): Promise<boolean>} */
+    retryInput,
+
+    /** 在输入事务中把 hwnd 切换到前台并执行 action，action 返回的 Promise 完成之前其它目标的输入都会失败
+     *  用于一组连续的输入，例如按下、等待、松开按键；其它目标持有事务时先等待它结束
+     * @type {function(hwnd, function(): Promise<any>): Promise<any>} */
+    async withInput(hwnd, action) {
+        await retryInput(tryBeginInput)
+        try {
+            setForegroundWindow(hwnd)
+            return await action()
+        } finally {
+            endInput()
+        }
+    },
 
     /** 发送窗口事件通用方法；
      *  使用方法: https://learn.microsoft.com/zh-cn/windows/win32/api/winuser/nf-winuser-postmessagew
      * @type {function(hwnd, msg, wparam, lparam): boolean} */
-    postMessageW: _postMessageW,
+    postMessageW,
 
     /**@type {function(hwnd, hdc): boolean} */
-    releaseDC: _releaseDC,
+    releaseDC,
 
-    /**@type {function(): boolean} */
-    releaseCursorClip: () => _clipCursor(0) != 0,
+    /** 其它目标的输入事务进行中时返回 false
+     * @type {function(): boolean} */
+    releaseCursorClip: () => clipCursor(0),
     
     /**@type {function(hwnd, [_left, _top, _right, _bottom]): {width:number, height:number, step:number, channels: number, data:ArrayBuffer}} */
-    captureWindow: _captureWindow,
+    captureWindow,
 
     /**@type {function(savePath, data, width, height, step): boolean} */
-    saveBitmapImage: _saveBitmapImage,
+    saveBitmapImage,
+
+    /** 截图的缓冲区会在 data 被回收后归还到缓冲池中复用，这里设置缓冲池最多保留的字节数
+     * @type {function(bytes)} */
+    setFramePoolCapacity,
+
+    /**@type {function(): {hits: number, misses: number, hitRate: number, retainedBytes: number, capacity: number}} */
+    framePoolStats,
+
+    /** 注册一个截图区域，同一帧 (两次 sleep 之间) 中第一次读取该区域时截图，之后的读取都直接使用这次的截图
+     *  读取的位置不在任何注册的区域中时，会截取整个窗口 (一帧中最多一次)；完全在窗口之外的读取不截图，getFramePixel 返回 0xFFFFFFFF
+     * @type {function(hwnd, [_left, _top, _right, _bottom])} */
+    addFrameRegion,
+
+    /**@type {function(hwnd)} */
+    clearFrameRegions,
+
+    /** 从本帧的截图中读取像素，返回值的格式与 getPixel 相同
+     * @type {function(hwnd, x, y): number} */
+    getFramePixel,
+
+    /** 与 captureWindow 相同，但是从本帧的截图中取图像
+     * @type {function(hwnd, [_left, _top, _right, _bottom]): {width:number, height:number, step:number, channels: number, data:ArrayBuffer}} */
+    captureFrame,
+
+    /** reads: 读取次数，hits: 命中缓存的次数，captures: 实际截图的次数
+     * @type {function(): {reads: number, hits: number, captures: number}} */
+    frameCacheStats,
+
+    /** 跟踪窗口的大小和 DPI，每隔 intervalMs 检查一次，变化时调用 onChange({ width, height, dpi })
+     *  窗口关闭时 width 和 height 为 0；返回值为停止跟踪的函数
+     * @type {function(hwnd, onChange, intervalMs?): function()} */
+    watchWindow(hwnd, onChange, intervalMs = 250) {
+        trackWindow(hwnd)
+        let stopped = false
+
+        const check = () => {
+            if(stopped)
+                return
+            const { changed, width, height, dpi } = validateWindow(hwnd)
+            if(changed)
+                onChange({ width, height, dpi })
+            setTimeout(check, intervalMs)
+        }
+        setTimeout(check, intervalMs)
+
+        return () => {
+            stopped = true
+            untrackWindow(hwnd)
+        }
+    },
 
     rgb: (r, g, b) => r | (g << 8) | (b << 16)
 }
 
+/** 在基准分辨率下登记像素点和区域，窗口大小变化时调用 update 统一换算为实际坐标
+ *  point 和 rect 返回的数组会在 update 时原地更新，可以直接保存使用 */
+export class Calibration {
+    static topLeft = 0
+    static bottomCenter = 1
+
+    #id
+    #points = []
+    #rects = []
+
+    constructor(baseWidth = 1920, baseHeight = 1080) {
+        this.#id = createCalibration(baseWidth, baseHeight)
+    }
+
+    /**@type {function([x, y], anchor?): [x, y]} */
+    point(pos, anchor = Calibration.topLeft) {
+        const index = addCalibrationPoint(this.#id, pos[0], pos[1], anchor)
+        if(index < 0)
+            throw new Error(`无效的 Calibration 或 anchor: ${anchor}`)
+        const mapped = [...pos]
+        this.#points.push({ index, mapped })
+        this.#read(getCalibrationPoint, index, mapped)
+        return mapped
+    }
+
+    /**@type {function([left, top, right, bottom], anchor?): [left, top, right, bottom]} */
+    rect(area, anchor = Calibration.topLeft) {
+        const index = addCalibrationRect(this.#id, area, anchor)
+        if(index < 0)
+            throw new Error(`无效的 Calibration 或 anchor: ${anchor}`)
+        const mapped = [...area]
+        this.#rects.push({ index, mapped })
+        this.#read(getCalibrationRect, index, mapped)
+        return mapped
+    }
+
+    update(width, height) {
+        updateCalibration(this.#id, width, height)
+        for(const { index, mapped } of this.#points)
+            this.#read(getCalibrationPoint, index, mapped)
+        for(const { index, mapped } of this.#rects)
+            this.#read(getCalibrationRect, index, mapped)
+    }
+
+    /** 释放原生的 Calibration，之后不能再使用；没有释放的会在脚本的上下文销毁 (热重载) 时释放 */
+    destroy() {
+        destroyCalibration(this.#id)
+    }
+
+    #read(getter, index, mapped) {
+        const result = getter(this.#id, index)
+        for(let i = 0; i < mapped.length; i++)
+            mapped[i] = result[i]
+    }
+}
+
+export const processes = {
+    /** 监视进程的启动和退出，没有监视的进程在运行时每隔 intervalMs 扫描一次，进程启动或退出时调用 onEvent({ type: "appear" | "exit", pid, name })
+     *  有监视的进程在运行时只需要发现进程退出，改为每隔 runningIntervalMs 扫描一次，减少枚举系统进程的开销
+     *  已经在运行的进程会在第一次扫描时作为 appear 事件报告；返回值为停止监视的函数
+     * @type {function(names: string[], onEvent, intervalMs?, runningIntervalMs?): function()} */
+    watch(names, onEvent, intervalMs = 200, runningIntervalMs = 2000) {
+        const id = createWatcher(names)
+        let stopped = false
+        let running = 0
+
+        const scan = () => {
+            if(stopped)
+                return
+            for(const event of scanWatcher(id)) {
+                running += event.type == "appear" ? 1 : -1
+                onEvent(event)
+            }
+            setTimeout(scan, running > 0 ? runningIntervalMs : intervalMs)
+        }
+        setTimeout(scan, 0)
+
+        return () => {
+            stopped = true
+            destroyWatcher(id)
+        }
+    }
+}
+
+export const image = {
+    /** 计算 BGRA 图像的指纹，图像被划分为 16 x 4 个格子，亮像素较多的格子对应的位为1
+     * @type {function(data, width, height, step, threshold): BigInt} */
+    fingerprint,
+
+    /** 比较两个指纹，added 为新变亮的格子数，removed 为变暗的格子数
+     * @type {function(BigInt, BigInt): {added: number, removed: number}} */
+    compareFingerprints,
+
+    /** 在 captureWindow / captureFrame 返回的图像中查找颜色与 color (win.rgb) 的每个通道相差不超过 tolerance 的连通区域，
+     *  用于定位位置不固定的界面元素 (对话选项、任务标记等)；只返回像素数不少于 minArea 的区域，坐标相对于图像左上角
+     * @type {function(image, color, tolerance?, minArea?): {left, top, right, bottom, area, x, y}[]} */
+    findBlobs: (image, color, tolerance = 16, minArea = 16) => 
+        image.data.byteLength == 0 ? [] : findBlobs(image.data, image.width, image.height, image.step, color, tolerance, minArea),
+
+    /** 计算图像的梯度，返回的图像每个像素 2 字节: [梯度大小, 方向 (0 ~ 7，每 22.5° 一个区间)]
+     * @type {function(image): {width, height, channels: 2, step, data: ArrayBuffer}} */
+    sobel: (image) => sobel(image.data, image.width, image.height, image.step),
+}
+
+/** 按轮廓 (梯度方向) 而不是颜色查找界面元素，不受滤镜、HDR 和亮度设置的影响
+ *  用截取到的界面元素图像创建模板，之后在其它截图中查找
+ */
+export class OutlineTemplate {
+    #id
+    #threshold
+
+    /** threshold 为梯度大小的阈值，只有轮廓上梯度足够强的点会作为特征点，最多 maxFeatures 个 */
+    constructor(image, threshold = 32, maxFeatures = 64) {
+        this.#id = createOutlineTemplate(image.data, image.width, image.height, image.step, threshold, maxFeatures)
+        this.#threshold = threshold
+        this.width = image.width
+        this.height = image.height
+    }
+
+    /** 返回得分不低于 minScore 的位置 (模板左上角相对于图像左上角的坐标)，按得分从高到低排列
+     * @type {function(image, minScore?): {x, y, score}[]} */
+    match(image, minScore = 0.8) {
+        if(image.data.byteLength == 0)
+            return []
+        return matchOutline(this.#id, image.data, image.width, image.height, image.step, this.#threshold, minScore)
+    }
+
+    destroy() {
+        destroyOutlineTemplate(this.#id)
+    }
+}
+
+// 多模板检测，多个模板共用一次扫描，先用平均颜色和采样点排除大部分位置，再做完整匹配
+// 适合同时查找很多个小图标，模板越多，每个模板分摊的耗时越少
+export class DetectorBank {
+    #id = createDetectorBank()
+
+    /** 添加一个模板 (例如 captureWindow 截取的图标)，返回模板的编号，scan 的结果按编号排列
+     * @type {function(image): number} */
+    add(image) {
+        return addDetector(this.#id, image.data, image.width, image.height, image.step)
+    }
+
+    /** 返回每个模板得分不低于 minScore 的位置 (模板左上角相对于图像左上角的坐标)
+     * meanTolerance 和 sampleTolerance 为平均颜色和采样点在每个通道上允许的差值
+     * @type {function(image, minScore?, meanTolerance?, sampleTolerance?): {x, y, score}[][]} */
+    scan(image, minScore = 0.9, meanTolerance = 16, sampleTolerance = 48) {
+        if(image.data.byteLength == 0)
+            return []
+        return scanDetectorBank(this.#id, image.data, image.width, image.height, image.step, meanTolerance, sampleTolerance, minScore)
+    }
+
+    /** 上一次扫描中每一级检查的通过次数，用于调整 meanTolerance 和 sampleTolerance
+     * @type {function(): {positions, meanChecks, meanPassed, samplePassed, hits}} */
+    stats() {
+        return detectorBankStats(this.#id)
+    }
+
+    destroy() {
+        destroyDetectorBank(this.#id)
+    }
+}
+
 export const keyboard = {
-    isKeyDown: (key) => _isKeyDown(keyCodes[key]),
+    isKeyDown: (key) => isKeyDown(keyCodes[key]),
 
     isKeysDown: (...keys) => keys.every(keyboard.isKeyDown),
 
-    sendKeyDown: (hwnd, key) => _postMessageW(hwnd, 0x0100, BigInt(keyCodes[key]), makeKeyEventLparam(1, key, false, false, false)),
+    sendKeyDown: (hwnd, key) => postMessageW(hwnd, 0x0100, BigInt(keyCodes[key]), makeKeyEventLparam(1, key, false, false, false)),
     
-    sendKeyUp: (hwnd, key) => _postMessageW(hwnd, 0x0101, BigInt(keyCodes[key]), makeKeyEventLparam(1, key, false, true, true)),
+    sendKeyUp: (hwnd, key) => postMessageW(hwnd, 0x0101, BigInt(keyCodes[key]), makeKeyEventLparam(1, key, false, true, true)),
 
     /** 全局键盘事件通用方法；
      *  使用方法: https://learn.microsoft.com/zh-cn/windows/win32/api/winuser/nf-winuser-keybd_event
-     * @type {function(keyCode, scanCode, dwFlags, BigInt)} 
+     * @type {function(keyCode, scanCode, dwFlags, BigInt): boolean} 
      */
-    keybdEvent: _keybdEvent,
+    keybdEvent,
 
-    keyDown: (key) => _keybdEvent(keyCodes[key], scanCodes[key], 0x0000, 0),
+    keyDown: (key) => keybdEvent(keyCodes[key], scanCodes[key], 0x0000, 0),
 
-    keyUp: (key) => _keybdEvent(keyCodes[key], scanCodes[key], 0x0002, 0),
+    keyUp: (key) => keybdEvent(keyCodes[key], scanCodes[key], 0x0002, 0),
 }
 
 export const mouse = {
-    sendLbuttonDown: (hwnd, x, y) => _postMessageW(hwnd, 0x0201, 0, BigInt(x | y << 16)),
+    sendLbuttonDown: (hwnd, x, y) => postMessageW(hwnd, 0x0201, 0, BigInt(x | y << 16)),
 
-    sendLbuttonUp: (hwnd, x, y) => _postMessageW(hwnd, 0x0202, 1, BigInt(x | y << 16)),
+    sendLbuttonUp: (hwnd, x, y) => postMessageW(hwnd, 0x0202, 1, BigInt(x | y << 16)),
 
     /** 全局鼠标事件通用方法；
      *  使用方法: https://learn.microsoft.com/zh-cn/windows/win32/api/winuser/nf-winuser-mouse_event
-     * @type {function(dwFlags, dx, dy, dwData, BigInt)}
+     * @type {function(dwFlags, dx, dy, dwData, BigInt): boolean}
      */
-    mouseEvent: _mouseEvent
+    mouseEvent
 }
 
 export const os = {
-    /**@type {function(millseconds)}*/
-    sleep: _sleep,
+    /** 同步等待，会阻塞事件循环；使用 --virtual-clock 启动时只推进虚拟时间
+     * @type {function(millseconds)}*/
+    sleep: sleepSync,
 
     /**@type {function(dirName) :boolean}*/
-    mkdir: _mkdir,
+    mkdir,
+
+    /** quickjs 内存池的统计信息，fragmentation 为内存页中未被使用的比例
+     * @type {function(): {liveBytes: number, peakBytes: number, reservedBytes: number, fragmentation: number}} */
+    allocatorStats,
+
+    /** 标记启动完成，在进入检测循环之前调用一次，之后的调用无效；使用 --trace-startup 参数启动时会输出每个启动阶段的耗时，
+     *  这个时间包括脚本等待游戏进程和窗口的时间，与原生的启动阶段分开输出
+     * @type {function()} */
+    startupReady,
+
+    /** 记录找到的游戏进程和窗口，进程退出时传入 (0, 0)；使用 --watch 启动时，修改脚本后重新执行的脚本通过全局变量 reloadTarget = { pid, hwnd } 得到
+     * @type {function(pid, hwnd)} */
+    setReloadTarget,
+}
+
+export const runtime = {
+    /** 按类别统计的 quickjs 内存使用情况 (mallocSize, objectCount, stringSize ...)
+     * @type {function(): Object<string, number>} */
+    memoryUsage,
+
+    /** 每一帧结束时内存分配量超过阈值则自动 GC，之后阈值变为剩余内存的 1.5 倍；小于 0 时关闭自动 GC
+     * @type {function(bytes)} */
+    setGCThreshold,
+
+    /** 限制 quickjs 的内存上限，小于等于 0 时不限制
+     * @type {function(bytes)} */
+    setMemoryLimit,
+
+    /** 立即执行一次 GC，返回耗时 (ms)；可以在空闲的时候调用，避免在剧情对话中触发自动 GC
+     * @type {function(): number} */
+    gc,
+
+    /** GC 的次数 (包括自动 GC 和热重载时的回收)、总耗时、最大耗时，以及耗时的直方图 (bucketsMs 为每个桶的上界)
+     * @type {function(): {count: number, totalMs: number, maxMs: number, bucketsMs: number[], counts: number[]}} */
+    gcStats,
+
+    /** 开启事件循环的看门狗，一帧 (一次计时器回调以及它引起的所有 Promise 任务) 超过 budgetMs 时输出报告
+     *  abortOnStall 为 true 时中断卡顿的那一帧；budgetMs 小于等于 0 时关闭
+     * @type {function(budgetMs, abortOnStall: boolean)} */
+    setWatchdog,
+
+    /** 卡顿次数、最长的一帧的耗时，以及最近一次卡顿的耗时、正在执行的原生函数和 JS 调用栈
+     * @type {function(): {stalls: number, worstTickMs: number, lastStallMs: number, lastBinding: string, lastStack: string}} */
+    watchdogStats,
+}
+
+// 二进制事件日志，保存在 logs/events.bin，可以用 eventlog 工具转换为文本或 CSV
+// 消息和错误的文本直接写在记录后面；检测的名称会被转换为编号，同一个名称只保存一次，所以只能使用固定的名称
+export const eventlog = {
+    /**@type {function(string)} */
+    message: (text) => writeEventText(eventTypes.message, String(text), 0, 0),
+
+    /**@type {function(string)} */
+    error: (text) => writeEventText(eventTypes.error, String(text), 0, 0),
+
+    /** 记录检测状态的变化，例如进入或离开剧情对话
+     * @type {function(name, state: number)} */
+    detection: (name, state) => writeEvent(eventTypes.detection, intern(name), state, 0),
+
+    /**@type {function(): {written: number, dropped: number, flushedBytes: number}} */
+    stats: eventLogStats,
+}
+
+// 与 eventlog::Type 对应
+const eventTypes = { message: 1, error: 2, input: 3, capture: 4, detection: 5, tick: 6 }
+
+// 性能追踪，导出为 Chrome Trace Event 格式，可以在 chrome://tracing 或 https://ui.perfetto.dev 中打开
+// 开启后自动记录每次原生函数调用、计时器回调、Promise 任务和脚本加载的耗时
+export const trace = {
+    /** 开启追踪；使用 --trace 参数启动时从一开始就开启，并在退出时保存到 logs/trace.json
+     * @type {function()} */
+    enable: traceEnable,
+
+    /**@type {function(): boolean} */
+    isEnabled: traceIsEnabled,
+
+    /** 记录 fn 的耗时，fn 返回 Promise 时记录到 Promise 结束为止，返回 fn 的返回值
+     * @type {function(name, fn): any} */
+    span(name, fn) {
+        if(!traceIsEnabled())
+            return fn()
+
+        const start = traceNow()
+        let result
+        try {
+            result = fn()
+        }
+        catch(e) {
+            traceComplete(name, start)
+            throw e
+        }
+
+        if(result instanceof Promise)
+            return result.finally(() => traceComplete(name, start))
+
+        traceComplete(name, start)
+        return result
+    },
+
+    /** 瞬时事件，例如检测到剧情对话
+     * @type {function(name)} */
+    instant: traceInstant,
+
+    /** 保存到文件 (相对于程序所在的目录)，不清空已经记录的事件
+     * @type {function(path?): boolean} */
+    save: (path = "logs/trace.json") => saveTrace(path),
+
+    /**@type {function(): {events: number, overwritten: number, threads: number}} */
+    stats: traceStats,
 }
 
 // ANSI转义序列
@@ -1,11 +1,16 @@
 module;
 
 #include <string>
+#include <string_view>
 #include <cstdio>
+#include <algorithm>
 #include <windows.h>
 
 export module console;
 
+export import panel;
+import eventlog;
+
 export namespace console {
     auto init(const std::string& title, short cols, short lines) -> bool;
 
@@ -14,20 +19,12 @@ export namespace console {
     void info(const std::string& text);
     
     void error(const std::string& text);
-}
 
+    // 带时间戳的日志，状态面板开启时记录为面板中的事件
+    void log(const char* text);
 
-export namespace console::ansi {
-    constexpr char bold[] = "\x1b[1m";
-    constexpr char reset[] = "\033[0m";
-    constexpr char cleanLine[] = "\r\033[K";
-    
-    #define rgb(R, G, B) "\x1b[38;2;" #R ";" #G ";" #B "m"
-    constexpr char green[] = rgb(96, 200, 135);
-    constexpr char blue[] = rgb(76, 186, 250);
-    constexpr char orange[] = rgb(241, 149, 88);
-    constexpr char red[] = rgb(247, 101, 104);
-    #undef rgb
+    // 等待用户按下任意键
+    void pause();
 }
 
 
@@ -61,12 +58,17 @@ auto console::init(const std::string& title, short cols, short lines) -> bool {
     SetConsoleTitleA(title.c_str());
 
     // 设置控制台大小
-    char command[64];
-    sprintf_s(command, 64, "mode con cols=%d lines=%d", cols, lines);
-    system(command);
+    // 窗口不能比缓冲区大，所以先把窗口缩到最小，设置缓冲区大小之后再设置窗口大小
+    SMALL_RECT minWindow = { 0, 0, 0, 0 };
+    SetConsoleWindowInfo(hOutput, TRUE, &minWindow);
     SetConsoleScreenBufferSize(hOutput, (COORD){ cols, static_cast<short>(lines * 10) });
 
-    system("cls");
+    COORD largest = GetLargestConsoleWindowSize(hOutput);
+    SMALL_RECT window = { 0, 0, static_cast<short>(std::min(cols, largest.X) - 1), static_cast<short>(std::min(lines, largest.Y) - 1) };
+    SetConsoleWindowInfo(hOutput, TRUE, &window);
+
+    // 清空屏幕和滚动缓冲区，并把光标移动到左上角
+    printf("\x1b[2J\x1b[3J\x1b[H");
 
     if(HWND hwnd = GetConsoleWindow()) {
         // 设置窗口透明度
@@ -88,13 +90,61 @@ auto console::init(const std::string& title, short cols, short lines) -> bool {
 
 
 void console::print(const char* text) {
+    // 面板开启时，print 输出的提示文本作为当前状态显示
+    if(panel::isRunning()) {
+        std::string state = text;
+        for(std::string_view sequence: { ansi::cleanLine, "\r", "\n" }) {
+            for(size_t pos; (pos = state.find(sequence)) != std::string::npos; )
+                state.erase(pos, sequence.size());
+        }
+        if(!state.empty())
+            panel::setState(state.c_str());
+        return;
+    }
+
     printf("%s", text);
 }
 
 void console::info(const std::string& text) {
+    if(panel::isRunning())
+        return panel::event(std::string(ansi::green) + "[Info]" + ansi::reset + " " + text);
+
     printf("%s[Info]%s %s\n", ansi::green, ansi::reset, text.c_str());
 }
 
 void console::error(const std::string& text) {
+    eventlog::writeText(eventlog::Type::Error, text);
+
+    if(panel::isRunning())
+        return panel::event(std::string(ansi::red) + "[Error]" + ansi::reset + " " + text);
+
     printf("%s[Error]%s %s\n", ansi::red, ansi::reset, text.c_str());
-}
\ No newline at end of file
+}
+
+void console::log(const char* text) {
+    if(panel::isRunning())
+        return panel::event(text);
+
+    printf("%s%s\n", console::timestamp().c_str(), text);
+}
+
+
+void console::pause() {
+    printf("按任意键继续...");
+    fflush(stdout);
+
+    HANDLE hInput = GetStdHandle(STD_INPUT_HANDLE);
+    if(hInput == INVALID_HANDLE_VALUE)
+        return;
+
+    // 丢弃之前的输入，只响应按键按下的事件
+    FlushConsoleInputBuffer(hInput);
+
+    INPUT_RECORD record;
+    DWORD count = 0;
+    while(ReadConsoleInputW(hInput, &record, 1, &count)) {
+        if(record.EventType == KEY_EVENT && record.Event.KeyEvent.bKeyDown)
+            break;
+    }
+    printf("\n");
+}
@@ -0,0 +1,426 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+export module detector;
+
+
+// 多模板检测
+// 一组模板共用一次扫描: 整张图像只计算一次积分图，每个位置按级联依次检查，前面的检查越便宜、淘汰的位置越多
+//   1. 平均颜色: 从积分图中得到探测窗口的平均颜色，只检查平均颜色所在的网格格子中的模板，再检查模板大小的窗口的平均颜色
+//   2. 采样点: 模板中几个最有区分度的像素
+//   3. 完整匹配: 逐像素比较，差值超过上限时提前结束
+// 探测窗口为所有模板共有的左上角部分 (最小的宽度 x 最小的高度)，大小不同的模板也共用每个位置的平均颜色和网格，
+// 每个位置的开销与模板的数量和大小的种类都无关，平均颜色相差较大的模板不会被检查，模板越多，每个模板分摊的扫描开销越少
+export namespace detector {
+    constexpr int sampleCount = 8;
+
+    struct Hit {
+        int x;
+        int y;
+        double score;       // 1 - 每个通道的平均差值 / 255
+    };
+
+    struct Options {
+        int meanTolerance = 16;     // 窗口与模板的平均颜色在每个通道上的最大差值
+        int sampleTolerance = 48;   // 采样点在每个通道上的最大差值
+        double minScore = 0.9;
+    };
+
+    // 上一次扫描中每一级的通过次数，用于调整级联的参数
+    struct ScanStats {
+        double positions = 0;       // 扫描的位置数 (探测窗口的位置，所有模板共用)
+        double meanChecks = 0;      // 网格中找到的候选模板数
+        double meanPassed = 0;
+        double samplePassed = 0;
+        double hits = 0;
+    };
+
+    class Bank {
+    public:
+        // BGRA 模板图像，返回模板的编号，从 0 开始
+        auto add(const std::byte* data, int width, int height, int step) -> uint32_t;
+
+        auto size() const -> size_t { return templates.size(); }
+
+        // 每个模板的命中位置 (模板左上角)，下标为模板的编号；同一个模板互相重叠的位置只保留得分最高的
+        auto scan(const std::byte* data, int width, int height, int step, const Options& options) -> std::vector<std::vector<Hit>>;
+
+        auto lastStats() const -> const ScanStats& { return stats; }
+
+    private:
+        struct Sample {
+            int offset;             // 在模板像素中的下标
+            uint8_t color[3];
+        };
+
+        struct Template {
+            int width;
+            int height;
+            std::vector<uint8_t> pixels;    // BGR，每行 width * 3 字节
+            int mean[3];
+            int probeMean[3];               // 左上角探测窗口的平均颜色，探测窗口变化时重新计算
+            Sample samples[sampleCount];
+        };
+
+        // 按探测窗口的平均颜色划分的网格
+        // 平均颜色在模板的 meanTolerance 范围内的窗口可能落在的每个格子中都有这个模板，扫描时每个位置只查一个格子
+        struct Grid {
+            int probeWidth = 0;
+            int probeHeight = 0;
+            int tolerance = -1;             // 网格对应的 meanTolerance，添加模板后为 -1，下次扫描时重新划分
+            int cellCount = 0;              // 每个通道的格子数
+            uint8_t cellOf[256] {};         // 每个通道的值所在的格子，避免扫描时做除法
+            std::vector<uint32_t> cellStarts {};
+            std::vector<uint32_t> cellTemplates {};
+        };
+
+        std::vector<Template> templates {};
+        Grid grid {};
+        std::vector<uint32_t> integral {};  // 每个通道的积分图，交错排列
+        ScanStats stats {};
+
+        void buildGrid(int tolerance);
+
+        // 在 origin 处依次检查平均颜色、采样点和完整匹配，通过时返回得分
+        auto cascade(const Template& candidate, const uint8_t* origin, int step, const int mean[3], const Options& options) -> std::optional<double>;
+    };
+
+    // 以下函数供脚本使用，模板组以编号区分
+    auto createBank() -> uint32_t;
+
+    void destroyBank(uint32_t id);
+
+    // 返回模板在组中的编号，模板组不存在或图像无效时返回 -1
+    auto addTemplate(uint32_t bank, std::byte* data, int width, int height, int step) -> int;
+
+    // 返回 [[{ x, y, score }, ...], ...]，下标为模板的编号
+    auto scanBank(uint32_t bank, std::byte* data, int width, int height, int step, int meanTolerance, int sampleTolerance, double minScore);
+
+    auto bankStats(uint32_t bank);
+}
+
+
+auto detector::Bank::add(const std::byte* data, int width, int height, int step) -> uint32_t {
+    Template added { width, height, {}, {}, {}, {} };
+    added.pixels.resize(static_cast<size_t>(width) * height * 3);
+
+    int64_t sums[3] = {};
+    for (int y = 0; y < height; y++) {
+        const uint8_t* pixel = reinterpret_cast<const uint8_t*>(data + static_cast<size_t>(y) * step);
+        uint8_t* out = added.pixels.data() + static_cast<size_t>(y) * width * 3;
+        for (int x = 0; x < width; x++, pixel += 4, out += 3) {
+            for (int c = 0; c < 3; c++) {
+                out[c] = pixel[c];
+                sums[c] += pixel[c];
+            }
+        }
+    }
+
+    int area = width * height;
+    for (int c = 0; c < 3; c++)
+        added.mean[c] = static_cast<int>(sums[c] / area);
+
+    // 模板分为 4 x 2 个格子，每个格子中取与平均颜色相差最大的像素作为采样点
+    for (int cell = 0; cell < sampleCount; cell++) {
+        int left = width * (cell % 4) / 4, right = width * (cell % 4 + 1) / 4;
+        int top = height * (cell / 4) / 2, bottom = height * (cell / 4 + 1) / 2;
+        int best = -1, bestOffset = top * width + left;
+
+        for (int y = top; y < bottom; y++) {
+            for (int x = left; x < right; x++) {
+                const uint8_t* pixel = added.pixels.data() + (static_cast<size_t>(y) * width + x) * 3;
+                int difference = std::abs(pixel[0] - added.mean[0]) + std::abs(pixel[1] - added.mean[1]) + std::abs(pixel[2] - added.mean[2]);
+                if (difference > best)
+                    best = difference, bestOffset = y * width + x;
+            }
+        }
+
+        Sample& sample = added.samples[cell];
+        sample.offset = bestOffset;
+        for (int c = 0; c < 3; c++)
+            sample.color[c] = added.pixels[static_cast<size_t>(bestOffset) * 3 + c];
+    }
+
+    uint32_t index = static_cast<uint32_t>(templates.size());
+    grid.tolerance = -1;
+
+    templates.push_back(std::move(added));
+    return index;
+}
+
+
+void detector::Bank::buildGrid(int tolerance) {
+    grid.tolerance = tolerance;
+    int cellSize = std::max(8, tolerance * 2 + 1);
+    grid.cellCount = 255 / cellSize + 1;
+    for (int value = 0; value < 256; value++)
+        grid.cellOf[value] = static_cast<uint8_t>(value / cellSize);
+
+    // 探测窗口为所有模板都包含的左上角部分
+    grid.probeWidth = std::numeric_limits<int>::max();
+    grid.probeHeight = std::numeric_limits<int>::max();
+    for (const Template& item: templates) {
+        grid.probeWidth = std::min(grid.probeWidth, item.width);
+        grid.probeHeight = std::min(grid.probeHeight, item.height);
+    }
+
+    for (Template& item: templates) {
+        int64_t sums[3] = {};
+        for (int y = 0; y < grid.probeHeight; y++) {
+            const uint8_t* pixel = item.pixels.data() + static_cast<size_t>(y) * item.width * 3;
+            for (int x = 0; x < grid.probeWidth; x++, pixel += 3) {
+                for (int c = 0; c < 3; c++)
+                    sums[c] += pixel[c];
+            }
+        }
+        for (int c = 0; c < 3; c++)
+            item.probeMean[c] = static_cast<int>(sums[c] / (grid.probeWidth * grid.probeHeight));
+    }
+
+    // 模板的 [probeMean - tolerance, probeMean + tolerance] 覆盖的格子，每个通道最多两个
+    auto forEachCell = [&](const Template& item, auto&& visit) {
+        int first[3], last[3];
+        for (int c = 0; c < 3; c++) {
+            first[c] = grid.cellOf[std::max(item.probeMean[c] - tolerance, 0)];
+            last[c] = grid.cellOf[std::min(item.probeMean[c] + tolerance, 255)];
+        }
+
+        for (int b = first[0]; b <= last[0]; b++) {
+            for (int g = first[1]; g <= last[1]; g++) {
+                for (int r = first[2]; r <= last[2]; r++)
+                    visit((b * grid.cellCount + g) * grid.cellCount + r);
+            }
+        }
+    };
+
+    // 先计数再填充，每个格子的模板连续存放
+    grid.cellStarts.assign(static_cast<size_t>(grid.cellCount) * grid.cellCount * grid.cellCount + 1, 0);
+    for (const Template& item: templates)
+        forEachCell(item, [&](int cell) { grid.cellStarts[cell + 1]++; });
+    for (size_t i = 1; i < grid.cellStarts.size(); i++)
+        grid.cellStarts[i] += grid.cellStarts[i - 1];
+
+    std::vector<uint32_t> next(grid.cellStarts.begin(), grid.cellStarts.end() - 1);
+    grid.cellTemplates.resize(grid.cellStarts.back());
+    for (uint32_t index = 0; index < templates.size(); index++)
+        forEachCell(templates[index], [&](int cell) { grid.cellTemplates[next[cell]++] = index; });
+}
+
+
+auto detector::Bank::cascade(const Template& candidate, const uint8_t* origin, int step, const int mean[3], const Options& options) -> std::optional<double> {
+    stats.meanChecks++;
+
+    if (std::abs(mean[0] - candidate.mean[0]) > options.meanTolerance
+        || std::abs(mean[1] - candidate.mean[1]) > options.meanTolerance
+        || std::abs(mean[2] - candidate.mean[2]) > options.meanTolerance)
+        return std::nullopt;
+    stats.meanPassed++;
+
+    bool samplesMatched = std::all_of(std::begin(candidate.samples), std::end(candidate.samples), [&](const Sample& sample) {
+        const uint8_t* pixel = origin + static_cast<size_t>(sample.offset / candidate.width) * step + (sample.offset % candidate.width) * 4;
+        return std::abs(pixel[0] - sample.color[0]) <= options.sampleTolerance
+            && std::abs(pixel[1] - sample.color[1]) <= options.sampleTolerance
+            && std::abs(pixel[2] - sample.color[2]) <= options.sampleTolerance;
+    });
+    if (!samplesMatched)
+        return std::nullopt;
+    stats.samplePassed++;
+
+    // 差值的总和超过 budget 时得分一定低于 minScore
+    int area = candidate.width * candidate.height;
+    int64_t budget = static_cast<int64_t>((1 - options.minScore) * 255 * 3 * area);
+    int64_t difference = 0;
+
+    for (int row = 0; row < candidate.height && difference <= budget; row++) {
+        const uint8_t* pixel = origin + static_cast<size_t>(row) * step;
+        const uint8_t* expected = candidate.pixels.data() + static_cast<size_t>(row) * candidate.width * 3;
+        for (int col = 0; col < candidate.width; col++, pixel += 4, expected += 3)
+            difference += std::abs(pixel[0] - expected[0]) + std::abs(pixel[1] - expected[1]) + std::abs(pixel[2] - expected[2]);
+    }
+
+    if (difference > budget)
+        return std::nullopt;
+    return 1 - static_cast<double>(difference) / (255.0 * 3 * area);
+}
+
+
+auto detector::Bank::scan(const std::byte* data, int width, int height, int step, const Options& options) -> std::vector<std::vector<Hit>> {
+    std::vector<std::vector<Hit>> hits(templates.size());
+    stats = ScanStats();
+
+    if (!data || width <= 0 || height <= 0)
+        return hits;
+
+    // 每个通道的积分图，所有模板共用
+    size_t stride = static_cast<size_t>(width + 1) * 3;
+    integral.assign(stride * (height + 1), 0);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* pixel = reinterpret_cast<const uint8_t*>(data + static_cast<size_t>(y) * step);
+        uint32_t rowSums[3] = {};
+        uint32_t* above = integral.data() + static_cast<size_t>(y) * stride + 3;
+        uint32_t* out = above + stride;
+
+        for (int x = 0; x < width; x++, pixel += 4) {
+            for (int c = 0; c < 3; c++) {
+                rowSums[c] += pixel[c];
+                out[x * 3 + c] = above[x * 3 + c] + rowSums[c];
+            }
+        }
+    }
+
+    if (templates.empty())
+        return hits;
+
+    int tolerance = std::clamp(options.meanTolerance, 0, 255);
+    if (grid.tolerance != tolerance)
+        buildGrid(tolerance);
+
+    // 窗口 [x, x + w) x [y, y + h) 的平均颜色
+    auto windowMean = [&](int x, int y, int w, int h, int mean[3]) {
+        const uint32_t* top = integral.data() + static_cast<size_t>(y) * stride;
+        const uint32_t* bottom = top + static_cast<size_t>(h) * stride;
+        float inverseArea = 1.0f / (w * h);
+        for (int c = 0; c < 3; c++) {
+            size_t left = static_cast<size_t>(x) * 3 + c, right = static_cast<size_t>(x + w) * 3 + c;
+            mean[c] = static_cast<int>((bottom[right] - bottom[left] - top[right] + top[left]) * inverseArea);
+        }
+    };
+
+    for (int y = 0; y + grid.probeHeight <= height; y++) {
+        stats.positions += width - grid.probeWidth + 1;
+
+        for (int x = 0; x + grid.probeWidth <= width; x++) {
+            int probe[3];
+            windowMean(x, y, grid.probeWidth, grid.probeHeight, probe);
+
+            int cell = (grid.cellOf[probe[0]] * grid.cellCount + grid.cellOf[probe[1]]) * grid.cellCount + grid.cellOf[probe[2]];
+            const uint8_t* origin = reinterpret_cast<const uint8_t*>(data + static_cast<size_t>(y) * step) + x * 4;
+
+            for (uint32_t i = grid.cellStarts[cell]; i < grid.cellStarts[cell + 1]; i++) {
+                uint32_t index = grid.cellTemplates[i];
+                const Template& candidate = templates[index];
+                if (x + candidate.width > width || y + candidate.height > height)
+                    continue;
+
+                // 与探测窗口大小相同的模板不需要再计算一次
+                int mean[3] = { probe[0], probe[1], probe[2] };
+                if (candidate.width != grid.probeWidth || candidate.height != grid.probeHeight)
+                    windowMean(x, y, candidate.width, candidate.height, mean);
+
+                if (auto score = cascade(candidate, origin, step, mean, options))
+                    hits[index].push_back({ x, y, *score });
+            }
+        }
+    }
+
+    // 同一个模板互相重叠超过一半的位置只保留得分最高的
+    for (size_t index = 0; index < hits.size(); index++) {
+        const Template& candidate = templates[index];
+        std::vector<Hit>& found = hits[index];
+        std::stable_sort(found.begin(), found.end(), [](const Hit& a, const Hit& b) { return a.score > b.score; });
+
+        std::vector<Hit> kept;
+        for (const Hit& hit: found) {
+            bool overlapped = std::any_of(kept.begin(), kept.end(), [&](const Hit& other) {
+                return std::abs(other.x - hit.x) * 2 < candidate.width && std::abs(other.y - hit.y) * 2 < candidate.height;
+            });
+            if (!overlapped)
+                kept.push_back(hit);
+        }
+
+        found = std::move(kept);
+        stats.hits += found.size();
+    }
+
+    return hits;
+}
+
+
+struct BankRegistry {
+    std::mutex mutex;
+    std::unordered_map<uint32_t, std::shared_ptr<detector::Bank>> banks {};
+    uint32_t nextId = 1;
+};
+
+BankRegistry bankRegistry;
+
+
+// 扫描时不持有注册表的锁，不同的目标可以同时扫描各自的模板组
+auto findBank(uint32_t id) -> std::shared_ptr<detector::Bank> {
+    std::lock_guard lock(bankRegistry.mutex);
+    auto it = bankRegistry.banks.find(id);
+    return it == bankRegistry.banks.end() ? nullptr : it->second;
+}
+
+
+auto detector::createBank() -> uint32_t {
+    std::lock_guard lock(bankRegistry.mutex);
+    uint32_t id = bankRegistry.nextId++;
+    bankRegistry.banks.emplace(id, std::make_shared<Bank>());
+    return id;
+}
+
+
+void detector::destroyBank(uint32_t id) {
+    std::lock_guard lock(bankRegistry.mutex);
+    bankRegistry.banks.erase(id);
+}
+
+
+auto detector::addTemplate(uint32_t bank, std::byte* data, int width, int height, int step) -> int {
+    std::shared_ptr<Bank> found = findBank(bank);
+    if (!found || !data || width <= 0 || height <= 0)
+        return -1;
+    return static_cast<int>(found->add(data, width, height, step));
+}
+
+
+auto detector::scanBank(uint32_t bank, std::byte* data, int width, int height, int step, int meanTolerance, int sampleTolerance, double minScore) {
+    using HitObject = std::tuple<
+        std::pair<const char*, int>,
+        std::pair<const char*, int>,
+        std::pair<const char*, double>
+    >;
+
+    std::vector<std::vector<HitObject>> result;
+
+    std::shared_ptr<Bank> found = findBank(bank);
+    if (!found)
+        return result;
+
+    for (const std::vector<Hit>& hits: found->scan(data, width, height, step, { meanTolerance, sampleTolerance, minScore })) {
+        std::vector<HitObject>& objects = result.emplace_back();
+        for (const Hit& hit: hits)
+            objects.emplace_back(std::make_pair("x", hit.x), std::make_pair("y", hit.y), std::make_pair("score", hit.score));
+    }
+
+    return result;
+}
+
+
+auto detector::bankStats(uint32_t bank) {
+    ScanStats stats;
+    if (std::shared_ptr<Bank> found = findBank(bank))
+        stats = found->lastStats();
+
+    return std::make_tuple(
+        std::make_pair("positions", stats.positions),
+        std::make_pair("meanChecks", stats.meanChecks),
+        std::make_pair("meanPassed", stats.meanPassed),
+        std::make_pair("samplePassed", stats.samplePassed),
+        std::make_pair("hits", stats.hits)
+    );
+}
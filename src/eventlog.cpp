@@ -0,0 +1,438 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+export module eventlog;
+
+
+// 二进制事件日志
+// 记录固定为 32 字节，写入时只把记录放进无锁的环形队列，不做任何格式化；后台线程定时把记录写入文件
+// 文件由 FileHeader 开头，后面是连续的 Record；Type::String 记录后面紧跟字符串的内容 (补齐到 32 字节)
+// 固定的名称先通过 intern 转换为编号，每个文件中字符串在第一次被引用之前写入；
+// 每次都不同的文本 (错误信息、带参数的消息) 通过 writeText 写入，文本跟在记录后面，不进入字符串表
+export namespace eventlog {
+    enum class Type : uint16_t {
+        String = 0,     // 字符串定义: message 为编号，values[0] 为字符串长度
+        Message,        // 普通消息
+        Error,          // 错误信息
+        Input,          // 输入: message 为输入函数的名称，values 为 窗口消息/事件标志 和 参数
+        Capture,        // 截图: values 为 耗时(ms) 和 像素数
+        Detection,      // 检测状态变化: message 为检测的名称，values[0] 为新的状态
+        Tick,           // 一帧结束: values[0] 为这一帧的耗时(ms)
+    };
+
+    struct Record {
+        int64_t time;       // 距离文件头中 startTime 的纳秒数
+        Type type;
+        uint16_t thread;    // 写入记录的线程编号
+        uint32_t message;   // intern 得到的字符串编号，0 表示没有；最高位为 1 时低 31 位为记录后面紧跟的文本的字节数
+        double values[2];
+    };
+
+    struct FileHeader {
+        char magic[4];          // "GAEV"
+        uint32_t version;
+        int64_t startTime;      // 开始记录时的系统时间 (距离 1970-01-01 的纳秒数)
+        uint32_t recordSize;
+        uint32_t reserved[3];
+    };
+
+    constexpr char magic[4] = { 'G', 'A', 'E', 'V' };
+    constexpr uint32_t version = 2;
+
+    // message 的最高位，表示记录后面紧跟文本 (补齐到 32 字节)
+    constexpr uint32_t inlineText = 0x80000000;
+
+    // writeText 的文本超过这个长度时截断
+    constexpr size_t maxTextBytes = 1024;
+
+    auto typeName(Type type) -> const char*;
+
+    // 开始记录到 dir/events.bin，文件超过 maxFileBytes 时轮换为 events.1.bin、events.2.bin ...，最多保留 maxFiles 个文件
+    // 后台线程每隔 flushIntervalMs 把队列中的记录写入文件
+    auto open(const std::filesystem::path& dir, size_t maxFileBytes = 4 * 1024 * 1024, int maxFiles = 4, int flushIntervalMs = 250) -> bool;
+
+    // 停止后台线程，并把剩余的记录写入文件
+    void close();
+
+    // 字符串表只增不减，只能用于固定的名称
+    auto intern(std::string_view text) -> uint32_t;
+
+    // 没有开始记录或者队列已满时直接丢弃
+    void write(Type type, uint32_t message = 0, double value0 = 0, double value1 = 0);
+
+    // 写入一条带有文本的记录，文本和记录一起放进队列，占用 1 + 文本长度 / 32 个位置
+    void writeText(Type type, std::string_view text, double value0 = 0, double value1 = 0);
+
+    // 记录后面紧跟的文本占用的记录数
+    constexpr auto textRecords(size_t bytes) -> size_t {
+        return (bytes + sizeof(Record) - 1) / sizeof(Record);
+    }
+
+    // 写入的记录数 (包括文本占用的记录)、因为队列已满丢弃的记录数、写入文件的字节数
+    auto stats();
+}
+
+
+static_assert(sizeof(eventlog::Record) == 32);
+static_assert(sizeof(eventlog::FileHeader) == 32);
+
+
+// 多生产者单消费者的有界环形队列 (Dmitry Vyukov 的算法)
+// 每个格子有一个序号，生产者通过 CAS 抢占写入的位置，序号用来判断格子是否可写、可读
+template<size_t capacity>
+class RecordRing {
+    static_assert((capacity & (capacity - 1)) == 0, "capacity 必须是 2 的幂");
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        eventlog::Record record;
+    };
+
+    std::array<Cell, capacity> cells;
+    alignas(64) std::atomic<size_t> enqueuePos = 0;
+    alignas(64) size_t dequeuePos = 0;
+
+public:
+    // 成功放进队列的记录数
+    size_t pushed() const {
+        return enqueuePos.load(std::memory_order_relaxed);
+    }
+
+    RecordRing() {
+        for (size_t i = 0; i < capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(const eventlog::Record& record) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = cells[pos & (capacity - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.record = record;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            // 队列已满
+            else if (diff < 0)
+                return false;
+            else pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // 把 count 条记录放进连续的位置，要么全部放入，要么全部不放入
+    // 消费者按顺序释放格子，所以最后一个格子可写时前面的格子也都可写
+    bool pushMany(const eventlog::Record* records, size_t count) {
+        if (count == 0 || count > capacity)
+            return false;
+
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& last = cells[(pos + count - 1) & (capacity - 1)];
+            size_t sequence = last.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + count - 1);
+
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                    for (size_t i = 0; i < count; i++) {
+                        Cell& cell = cells[(pos + i) & (capacity - 1)];
+                        cell.record = records[i];
+                        cell.sequence.store(pos + i + 1, std::memory_order_release);
+                    }
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // 只能由一个线程调用
+    bool pop(eventlog::Record& record) {
+        Cell& cell = cells[dequeuePos & (capacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+            return false;
+
+        record = cell.record;
+        cell.sequence.store(dequeuePos + capacity, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+};
+
+
+struct EventLog {
+    RecordRing<8192> ring;
+
+    std::atomic<bool> enabled = false;
+    std::atomic<size_t> dropped = 0;
+    std::atomic<uint16_t> nextThreadId = 0;
+
+    std::chrono::steady_clock::time_point startTime;
+
+    // 字符串表，编号为下标 + 1
+    std::mutex stringsMutex;
+    std::unordered_map<std::string, uint32_t> stringIds {};
+    std::vector<std::string> strings {};
+
+    // 以下只由后台线程访问
+    std::thread flusher;
+    std::mutex flusherMutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+    std::chrono::milliseconds flushInterval {};
+
+    std::filesystem::path dir;
+    size_t maxFileBytes = 0;
+    int maxFiles = 0;
+    FILE* file = nullptr;
+    size_t fileBytes = 0;
+    size_t writtenStrings = 0;
+    std::atomic<size_t> flushedBytes = 0;
+
+    bool openFile();
+    void rotate();
+    void flush();
+};
+
+EventLog eventLog;
+
+auto eventlog::typeName(Type type) -> const char* {
+    constexpr const char* names[] = { "string", "message", "error", "input", "capture", "detection", "tick" };
+    size_t index = static_cast<size_t>(type);
+    return index < std::size(names) ? names[index] : "unknown";
+}
+
+
+bool EventLog::openFile() {
+    file = fopen((dir / "events.bin").string().c_str(), "wb");
+    if (!file)
+        return false;
+
+    auto startSystemTime = std::chrono::system_clock::now() - (std::chrono::steady_clock::now() - startTime);
+
+    eventlog::FileHeader header {};
+    std::copy(std::begin(eventlog::magic), std::end(eventlog::magic), header.magic);
+    header.version = eventlog::version;
+    header.startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(startSystemTime.time_since_epoch()).count();
+    header.recordSize = sizeof(eventlog::Record);
+
+    fwrite(&header, sizeof(header), 1, file);
+    fileBytes = sizeof(header);
+    flushedBytes += sizeof(header);
+
+    // 新文件需要重新写入所有的字符串
+    writtenStrings = 0;
+    return true;
+}
+
+
+// events.bin -> events.1.bin -> events.2.bin ...，超过 maxFiles 的最旧的文件被删除
+void EventLog::rotate() {
+    fclose(file);
+    file = nullptr;
+
+    auto rotatedPath = [&](int index) {
+        return dir / (index == 0 ? std::string("events.bin") : "events." + std::to_string(index) + ".bin");
+    };
+
+    std::error_code ec;
+    std::filesystem::remove(rotatedPath(maxFiles - 1), ec);
+    for (int index = maxFiles - 2; index >= 0; index--)
+        std::filesystem::rename(rotatedPath(index), rotatedPath(index + 1), ec);
+
+    openFile();
+}
+
+
+void EventLog::flush() {
+    // 带有文本的记录和它的文本在队列中是连续的，但生产者可能还没有写完后面的格子，
+    // 等到文本完整之后再写入文件，避免新的字符串定义插到记录和文本之间
+    std::vector<eventlog::Record> records;
+    size_t pendingText = 0;
+    for (eventlog::Record record; ; ) {
+        if (!ring.pop(record)) {
+            if (pendingText == 0)
+                break;
+            std::this_thread::yield();
+            continue;
+        }
+
+        records.push_back(record);
+        if (pendingText > 0)
+            pendingText--;
+        else if (record.message & eventlog::inlineText)
+            pendingText = eventlog::textRecords(record.message & ~eventlog::inlineText);
+    }
+
+    if (records.empty() || !file)
+        return;
+
+    if (fileBytes >= maxFileBytes)
+        rotate();
+    if (!file)
+        return;
+
+    // 记录被放进队列之前，它引用的字符串已经在字符串表中了，所以先取出记录再写入新的字符串
+    std::vector<std::string> newStrings;
+    {
+        std::lock_guard lock(stringsMutex);
+        newStrings.assign(strings.begin() + writtenStrings, strings.end());
+    }
+
+    auto startId = static_cast<uint32_t>(writtenStrings + 1);
+    for (size_t i = 0; i < newStrings.size(); i++) {
+        const std::string& text = newStrings[i];
+        eventlog::Record definition { 0, eventlog::Type::String, 0, static_cast<uint32_t>(startId + i), { static_cast<double>(text.size()), 0 } };
+
+        size_t paddedSize = (text.size() + sizeof(eventlog::Record) - 1) / sizeof(eventlog::Record) * sizeof(eventlog::Record);
+        std::string padded = text;
+        padded.resize(paddedSize, '\0');
+
+        fwrite(&definition, sizeof(definition), 1, file);
+        fwrite(padded.data(), 1, padded.size(), file);
+        fileBytes += sizeof(definition) + padded.size();
+        flushedBytes += sizeof(definition) + padded.size();
+    }
+    writtenStrings += newStrings.size();
+
+    size_t bytes = records.size() * sizeof(eventlog::Record);
+    fwrite(records.data(), 1, bytes, file);
+    fflush(file);
+    fileBytes += bytes;
+    flushedBytes += bytes;
+}
+
+
+auto eventlog::open(const std::filesystem::path& dir, size_t maxFileBytes, int maxFiles, int flushIntervalMs) -> bool {
+    if (eventLog.enabled)
+        return true;
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    eventLog.dir = dir;
+    eventLog.maxFileBytes = maxFileBytes;
+    eventLog.maxFiles = std::max(maxFiles, 1);
+    eventLog.flushInterval = std::chrono::milliseconds(flushIntervalMs);
+    eventLog.startTime = std::chrono::steady_clock::now();
+
+    if (!eventLog.openFile())
+        return false;
+
+    eventLog.stopping = false;
+    eventLog.enabled = true;
+
+    eventLog.flusher = std::thread([]() {
+        std::unique_lock lock(eventLog.flusherMutex);
+        while (!eventLog.stopping) {
+            eventLog.wakeup.wait_for(lock, eventLog.flushInterval);
+            eventLog.flush();
+        }
+    });
+
+    return true;
+}
+
+
+void eventlog::close() {
+    if (!eventLog.enabled)
+        return;
+
+    eventLog.enabled = false;
+    {
+        std::lock_guard lock(eventLog.flusherMutex);
+        eventLog.stopping = true;
+    }
+    eventLog.wakeup.notify_all();
+    eventLog.flusher.join();
+
+    eventLog.flush();
+    fclose(eventLog.file);
+    eventLog.file = nullptr;
+}
+
+
+auto eventlog::intern(std::string_view text) -> uint32_t {
+    std::lock_guard lock(eventLog.stringsMutex);
+
+    auto it = eventLog.stringIds.find(std::string(text));
+    if (it != eventLog.stringIds.end())
+        return it->second;
+
+    eventLog.strings.emplace_back(text);
+    auto id = static_cast<uint32_t>(eventLog.strings.size());
+    eventLog.stringIds.emplace(text, id);
+    return id;
+}
+
+
+// 写入记录的线程编号，每个线程第一次写入时分配
+uint16_t currentThreadId() {
+    thread_local uint16_t threadId = eventLog.nextThreadId++;
+    return threadId;
+}
+
+
+void eventlog::write(Type type, uint32_t message, double value0, double value1) {
+    if (!eventLog.enabled.load(std::memory_order_relaxed))
+        return;
+
+    Record record {
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - eventLog.startTime).count(),
+        type, currentThreadId(), message, { value0, value1 }
+    };
+
+    if (!eventLog.ring.push(record))
+        eventLog.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void eventlog::writeText(Type type, std::string_view text, double value0, double value1) {
+    if (!eventLog.enabled.load(std::memory_order_relaxed))
+        return;
+
+    text = text.substr(0, maxTextBytes);
+    std::array<Record, 1 + textRecords(maxTextBytes)> records {};
+    records[0] = {
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - eventLog.startTime).count(),
+        type, currentThreadId(), static_cast<uint32_t>(text.size()) | inlineText, { value0, value1 }
+    };
+    std::copy(text.begin(), text.end(), reinterpret_cast<char*>(&records[1]));
+
+    if (!eventLog.ring.pushMany(records.data(), 1 + textRecords(text.size())))
+        eventLog.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+auto eventlog::stats() {
+    return std::make_tuple(
+        std::make_pair("written", static_cast<double>(eventLog.ring.pushed())),
+        std::make_pair("dropped", static_cast<double>(eventLog.dropped)),
+        std::make_pair("flushedBytes", static_cast<double>(eventLog.flushedBytes))
+    );
+}
@@ -0,0 +1,116 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstddef>
+
+export module frame;
+
+
+// 截图用的帧缓冲池
+// 截图的大小通常是固定的几种，缓冲区在 ArrayBuffer 被 quickjs 释放时归还到池中，下一次截图直接复用
+export namespace frame {
+    struct Buffer {
+        std::byte* data;
+        size_t size;
+    };
+
+    auto acquire(size_t size) -> Buffer;
+
+    void release(std::byte* data, size_t size);
+
+    // 池中最多保留的字节数，超过时归还的缓冲区会被直接释放
+    void setCapacity(double bytes);
+
+    // 命中次数、未命中次数、命中率、池中保留的字节数以及上限
+    auto stats();
+}
+
+
+struct FramePool {
+    std::mutex mutex;
+    std::unordered_map<size_t, std::vector<std::byte*>> buffers {};
+    size_t retainedBytes = 0;
+    size_t capacity = 64 * 1024 * 1024;
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+FramePool framePool;
+
+
+auto frame::acquire(size_t size) -> Buffer {
+    if (size == 0)
+        return { nullptr, 0 };
+
+    {
+        std::lock_guard lock(framePool.mutex);
+        auto it = framePool.buffers.find(size);
+        if (it != framePool.buffers.end() && !it->second.empty()) {
+            std::byte* data = it->second.back();
+            it->second.pop_back();
+            framePool.retainedBytes -= size;
+            framePool.hits++;
+            return { data, size };
+        }
+        framePool.misses++;
+    }
+
+    return { new std::byte[size], size };
+}
+
+
+void frame::release(std::byte* data, size_t size) {
+    if (!data)
+        return;
+
+    {
+        std::lock_guard lock(framePool.mutex);
+        if (framePool.retainedBytes + size <= framePool.capacity) {
+            framePool.buffers[size].push_back(data);
+            framePool.retainedBytes += size;
+            return;
+        }
+    }
+
+    delete[] data;
+}
+
+
+void frame::setCapacity(double bytes) {
+    std::vector<std::byte*> freed;
+
+    {
+        std::lock_guard lock(framePool.mutex);
+        framePool.capacity = bytes > 0 ? static_cast<size_t>(bytes) : 0;
+
+        // 释放超出上限的缓冲区
+        for (auto& [size, buffers]: framePool.buffers) {
+            while (!buffers.empty() && framePool.retainedBytes > framePool.capacity) {
+                freed.push_back(buffers.back());
+                buffers.pop_back();
+                framePool.retainedBytes -= size;
+            }
+        }
+    }
+
+    for (std::byte* data: freed)
+        delete[] data;
+}
+
+
+auto frame::stats() {
+    std::lock_guard lock(framePool.mutex);
+    double total = static_cast<double>(framePool.hits + framePool.misses);
+
+    return std::make_tuple(
+        std::make_pair("hits", static_cast<double>(framePool.hits)),
+        std::make_pair("misses", static_cast<double>(framePool.misses)),
+        std::make_pair("hitRate", total > 0 ? framePool.hits / total : 0.0),
+        std::make_pair("retainedBytes", static_cast<double>(framePool.retainedBytes)),
+        std::make_pair("capacity", static_cast<double>(framePool.capacity))
+    );
+}
@@ -0,0 +1,254 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+
+export module geometry;
+
+
+// 窗口几何信息的跟踪，以及基准分辨率坐标到实际窗口坐标的换算
+// 不依赖具体的平台，窗口信息通过 Tracker::Query 获取，可以用模拟的窗口大小变化来验证换算结果
+export namespace geometry {
+    struct WindowGeometry {
+        int width = 0;
+        int height = 0;
+        unsigned dpi = 96;
+
+        bool operator==(const WindowGeometry&) const = default;
+    };
+
+    // 缓存窗口的几何信息，每次 validate 时重新查询并与缓存比较
+    class Tracker {
+    public:
+        // 查询失败 (例如窗口已经关闭) 时返回 false
+        using Query = std::function<bool(WindowGeometry&)>;
+
+        Tracker(Query query);
+
+        // 重新查询，几何信息发生变化时返回 true
+        bool validate();
+
+        auto current() const -> const WindowGeometry& { return geometry; }
+
+    private:
+        Query query;
+        WindowGeometry geometry {};
+    };
+
+    // 坐标的基准位置，游戏界面中的元素按宽高中较小的比例缩放，并且相对于窗口的某个位置对齐
+    enum class Anchor : int {
+        TopLeft = 0,
+        BottomCenter = 1,
+    };
+
+    // 在基准分辨率 (默认 1920 x 1080) 下登记点和区域，窗口大小变化时统一换算到实际坐标
+    class Calibration {
+    public:
+        Calibration(int baseWidth = 1920, int baseHeight = 1080);
+
+        auto addPoint(int x, int y, Anchor anchor) -> uint32_t;
+
+        auto addRect(std::tuple<int, int, int, int> area, Anchor anchor) -> uint32_t;
+
+        // 根据窗口大小重新换算所有登记的坐标
+        void update(int width, int height);
+
+        auto point(uint32_t index) const -> std::tuple<int, int>;
+
+        auto rect(uint32_t index) const -> std::tuple<int, int, int, int>;
+
+        auto scale() const -> double { return currentScale; }
+
+    private:
+        struct Entry {
+            std::tuple<int, int, int, int> base;
+            std::tuple<int, int, int, int> mapped;
+            Anchor anchor;
+        };
+
+        auto map(int x, int y, Anchor anchor) const -> std::pair<int, int>;
+
+        int baseWidth;
+        int baseHeight;
+        int width;
+        int height;
+        double currentScale = 1;
+        std::vector<Entry> entries {};
+    };
+
+    // 以下函数供脚本使用，Calibration 以编号区分
+    auto createCalibration(int baseWidth, int baseHeight) -> uint32_t;
+
+    void destroyCalibration(uint32_t id);
+
+    // 返回登记的下标，编号不存在或者 anchor 无效时返回 -1
+    auto addCalibrationPoint(uint32_t id, int x, int y, int anchor) -> int32_t;
+
+    auto addCalibrationRect(uint32_t id, std::tuple<int, int, int, int> area, int anchor) -> int32_t;
+
+    void updateCalibration(uint32_t id, int width, int height);
+
+    auto getCalibrationPoint(uint32_t id, uint32_t index) -> std::tuple<int, int>;
+
+    auto getCalibrationRect(uint32_t id, uint32_t index) -> std::tuple<int, int, int, int>;
+}
+
+
+geometry::Tracker::Tracker(Query query) : query(std::move(query)) {
+    validate();
+}
+
+
+bool geometry::Tracker::validate() {
+    WindowGeometry latest;
+    if (!query(latest))
+        latest = WindowGeometry { 0, 0, 0 };
+
+    if (latest == geometry)
+        return false;
+
+    geometry = latest;
+    return true;
+}
+
+
+geometry::Calibration::Calibration(int baseWidth, int baseHeight)
+    : baseWidth(baseWidth), baseHeight(baseHeight), width(baseWidth), height(baseHeight) {}
+
+
+// 宽高比大于基准时按高度缩放，否则按宽度缩放
+auto geometry::Calibration::map(int x, int y, Anchor anchor) const -> std::pair<int, int> {
+    double offsetX = 0, offsetY = 0;
+
+    if (anchor == Anchor::BottomCenter) {
+        offsetX = (width - baseWidth * currentScale) / 2;
+        offsetY = height - baseHeight * currentScale;
+    }
+
+    return { static_cast<int>(std::lround(x * currentScale + offsetX)), static_cast<int>(std::lround(y * currentScale + offsetY)) };
+}
+
+
+auto geometry::Calibration::addPoint(int x, int y, Anchor anchor) -> uint32_t {
+    auto [mappedX, mappedY] = map(x, y, anchor);
+    entries.push_back({ { x, y, x, y }, { mappedX, mappedY, mappedX, mappedY }, anchor });
+    return static_cast<uint32_t>(entries.size() - 1);
+}
+
+
+auto geometry::Calibration::addRect(std::tuple<int, int, int, int> area, Anchor anchor) -> uint32_t {
+    auto& [left, top, right, bottom] = area;
+    auto [mappedLeft, mappedTop] = map(left, top, anchor);
+    auto [mappedRight, mappedBottom] = map(right, bottom, anchor);
+    entries.push_back({ area, { mappedLeft, mappedTop, mappedRight, mappedBottom }, anchor });
+    return static_cast<uint32_t>(entries.size() - 1);
+}
+
+
+void geometry::Calibration::update(int width, int height) {
+    if (width <= 0 || height <= 0)
+        return;
+
+    this->width = width;
+    this->height = height;
+    currentScale = static_cast<int64_t>(width) * baseHeight > static_cast<int64_t>(height) * baseWidth
+        ? static_cast<double>(height) / baseHeight
+        : static_cast<double>(width) / baseWidth;
+
+    for (Entry& entry: entries) {
+        auto& [left, top, right, bottom] = entry.base;
+        auto [mappedLeft, mappedTop] = map(left, top, entry.anchor);
+        auto [mappedRight, mappedBottom] = map(right, bottom, entry.anchor);
+        entry.mapped = { mappedLeft, mappedTop, mappedRight, mappedBottom };
+    }
+}
+
+
+auto geometry::Calibration::point(uint32_t index) const -> std::tuple<int, int> {
+    if (index >= entries.size())
+        return { 0, 0 };
+    auto& [x, y, _right, _bottom] = entries[index].mapped;
+    return { x, y };
+}
+
+
+auto geometry::Calibration::rect(uint32_t index) const -> std::tuple<int, int, int, int> {
+    if (index >= entries.size())
+        return { 0, 0, 0, 0 };
+    return entries[index].mapped;
+}
+
+
+// 多目标模式下不同的线程会同时访问
+struct CalibrationRegistry {
+    std::mutex mutex;
+    std::unordered_map<uint32_t, geometry::Calibration> calibrations {};
+    uint32_t nextId = 1;
+};
+
+CalibrationRegistry calibrationRegistry;
+
+
+auto geometry::createCalibration(int baseWidth, int baseHeight) -> uint32_t {
+    std::lock_guard lock(calibrationRegistry.mutex);
+    uint32_t id = calibrationRegistry.nextId++;
+    calibrationRegistry.calibrations.emplace(id, Calibration(baseWidth, baseHeight));
+    return id;
+}
+
+
+void geometry::destroyCalibration(uint32_t id) {
+    std::lock_guard lock(calibrationRegistry.mutex);
+    calibrationRegistry.calibrations.erase(id);
+}
+
+
+bool isValidAnchor(int anchor) {
+    return anchor == static_cast<int>(geometry::Anchor::TopLeft) || anchor == static_cast<int>(geometry::Anchor::BottomCenter);
+}
+
+
+auto geometry::addCalibrationPoint(uint32_t id, int x, int y, int anchor) -> int32_t {
+    std::lock_guard lock(calibrationRegistry.mutex);
+    auto it = calibrationRegistry.calibrations.find(id);
+    if (it == calibrationRegistry.calibrations.end() || !isValidAnchor(anchor))
+        return -1;
+    return static_cast<int32_t>(it->second.addPoint(x, y, static_cast<Anchor>(anchor)));
+}
+
+
+auto geometry::addCalibrationRect(uint32_t id, std::tuple<int, int, int, int> area, int anchor) -> int32_t {
+    std::lock_guard lock(calibrationRegistry.mutex);
+    auto it = calibrationRegistry.calibrations.find(id);
+    if (it == calibrationRegistry.calibrations.end() || !isValidAnchor(anchor))
+        return -1;
+    return static_cast<int32_t>(it->second.addRect(area, static_cast<Anchor>(anchor)));
+}
+
+
+void geometry::updateCalibration(uint32_t id, int width, int height) {
+    std::lock_guard lock(calibrationRegistry.mutex);
+    auto it = calibrationRegistry.calibrations.find(id);
+    if (it != calibrationRegistry.calibrations.end())
+        it->second.update(width, height);
+}
+
+
+auto geometry::getCalibrationPoint(uint32_t id, uint32_t index) -> std::tuple<int, int> {
+    std::lock_guard lock(calibrationRegistry.mutex);
+    auto it = calibrationRegistry.calibrations.find(id);
+    return it == calibrationRegistry.calibrations.end() ? std::tuple<int, int>() : it->second.point(index);
+}
+
+
+auto geometry::getCalibrationRect(uint32_t id, uint32_t index) -> std::tuple<int, int, int, int> {
+    std::lock_guard lock(calibrationRegistry.mutex);
+    auto it = calibrationRegistry.calibrations.find(id);
+    return it == calibrationRegistry.calibrations.end() ? std::tuple<int, int, int, int>() : it->second.rect(index);
+}
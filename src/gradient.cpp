@@ -0,0 +1,416 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define GRADIENT_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+export module gradient;
+
+import frame;
+
+
+// 基于梯度的轮廓匹配
+// 颜色滤镜、HDR 和亮度设置会改变界面元素的颜色，但不会改变它的轮廓，所以按梯度的方向而不是颜色匹配
+// Sobel 算子计算梯度的大小和方向，方向量化为 8 个区间 (不区分明暗反转，每个区间 22.5°)
+// 模板是轮廓上梯度较强的一组特征点，匹配时统计特征点处梯度方向相符的比例
+export namespace gradient {
+    // 梯度图，边界上一个像素的梯度为 0
+    struct GradientMap {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> magnitude {};      // (|gx| + |gy|) / 4，超过 255 时取 255
+        std::vector<uint8_t> orientation {};    // 0 ~ 7，角度 / 22.5°
+    };
+
+    // 当前平台是否可以使用 SSE2，不可用时使用标量实现，两种实现的结果完全相同
+    constexpr bool simdAvailable() {
+#ifdef GRADIENT_SSE2
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // 计算 BGRA 图像的梯度图，allowSimd 为 false 时强制使用标量实现 (用于对比两种实现)
+    void compute(const std::byte* data, int width, int height, int step, GradientMap& map, bool allowSimd = true);
+
+    struct Feature {
+        int16_t x;
+        int16_t y;
+        uint8_t orientation;
+    };
+
+    struct OutlineTemplate {
+        int width = 0;
+        int height = 0;
+        std::vector<Feature> features {};
+    };
+
+    // 从模板图像的梯度中选取梯度大小不低于 threshold 的特征点，按梯度从强到弱选取，特征点之间至少间隔 2 个像素
+    auto makeTemplate(const GradientMap& map, int threshold, int maxFeatures) -> OutlineTemplate;
+
+    struct Match {
+        int x;
+        int y;
+        double score;       // 方向相符的特征点的比例
+    };
+
+    // 在梯度图中查找模板，返回得分不低于 minScore 的位置 (模板的左上角)，按得分从高到低排列，互相重叠的位置只保留得分最高的
+    // 每个像素的方向扩散到相邻的 3 x 3 范围，方向相差一个区间也算相符，容许轮廓有 1 个像素的偏移和轻微的旋转
+    auto match(const GradientMap& map, const OutlineTemplate& outline, int threshold, double minScore) -> std::vector<Match>;
+
+    // 以下函数供脚本使用，参数与 captureWindow 返回的图像相同，模板以编号区分
+    // 返回 { width, height, channels: 2, step, data }，每个像素为 [梯度大小, 方向]
+    auto sobel(std::byte* data, int width, int height, int step);
+
+    auto createTemplate(std::byte* data, int width, int height, int step, int threshold, int maxFeatures) -> uint32_t;
+
+    void destroyTemplate(uint32_t id);
+
+    // 返回 [{ x, y, score }, ...]
+    auto matchTemplate(uint32_t id, std::byte* data, int width, int height, int step, int threshold, double minScore);
+}
+
+
+// 区间边界 22.5° * k (k = 1 ~ 7) 的 cos 和 sin，放大 4096 倍
+// 梯度方向 θ 在 [0°, 180°) 内时，θ > β 等价于 gy * cos(β) - gx * sin(β) > 0，方向所在的区间就是超过的边界数
+constexpr int16_t boundaryCos[7] = { 3784, 2896, 1567, 0, -1567, -2896, -3784 };
+constexpr int16_t boundarySin[7] = { 1567, 2896, 3784, 4096, 3784, 2896, 1567 };
+
+
+// 近似亮度，与 image::fingerprint 相同: (R * 2 + G * 5 + B) / 8
+void toGray(const std::byte* data, int width, int height, int step, std::vector<uint8_t>& gray) {
+    gray.resize(static_cast<size_t>(width) * height);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* pixel = reinterpret_cast<const uint8_t*>(data + static_cast<size_t>(y) * step);
+        uint8_t* out = gray.data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++, pixel += 4)
+            out[x] = static_cast<uint8_t>((pixel[2] * 2 + pixel[1] * 5 + pixel[0]) >> 3);
+    }
+}
+
+
+// 一个像素的梯度，rows 为上一行、当前行、下一行在 x 处的指针
+inline void sobelPixel(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t& magnitude, uint8_t& orientation) {
+    int gx = (above[1] + 2 * row[1] + below[1]) - (above[-1] + 2 * row[-1] + below[-1]);
+    int gy = (below[-1] + 2 * below[0] + below[1]) - (above[-1] + 2 * above[0] + above[1]);
+
+    magnitude = static_cast<uint8_t>(std::min((std::abs(gx) + std::abs(gy)) >> 2, 255));
+
+    // 方向不区分正负，翻转到 [0°, 180°)
+    if (gy < 0 || (gy == 0 && gx < 0)) {
+        gx = -gx;
+        gy = -gy;
+    }
+
+    int bin = 0;
+    for (int k = 0; k < 7; k++)
+        bin += gy * boundaryCos[k] - gx * boundarySin[k] > 0;
+    orientation = static_cast<uint8_t>(bin);
+}
+
+
+#ifdef GRADIENT_SSE2
+// 一次计算 8 个像素，返回处理到的位置，剩下的像素由标量实现处理
+int sobelRowSse2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* magnitude, uint8_t* orientation, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = 1;
+
+    auto load = [&](const uint8_t* p) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero); };
+
+    for (; x + 8 <= width - 1; x += 8) {
+        __m128i a0 = load(above + x - 1), a1 = load(above + x), a2 = load(above + x + 1);
+        __m128i r0 = load(row + x - 1), r2 = load(row + x + 1);
+        __m128i b0 = load(below + x - 1), b1 = load(below + x), b2 = load(below + x + 1);
+
+        __m128i gx = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(a2, b2), _mm_slli_epi16(r2, 1)),
+                                   _mm_add_epi16(_mm_add_epi16(a0, b0), _mm_slli_epi16(r0, 1)));
+        __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(b0, b2), _mm_slli_epi16(b1, 1)),
+                                   _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_slli_epi16(a1, 1)));
+
+        // |v| = (v ^ sign) - sign
+        __m128i gxSign = _mm_srai_epi16(gx, 15), gySign = _mm_srai_epi16(gy, 15);
+        __m128i absSum = _mm_add_epi16(_mm_sub_epi16(_mm_xor_si128(gx, gxSign), gxSign), _mm_sub_epi16(_mm_xor_si128(gy, gySign), gySign));
+        __m128i mag = _mm_srli_epi16(absSum, 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(magnitude + x), _mm_packus_epi16(mag, zero));
+
+        // gy < 0 或者 gy == 0 且 gx < 0 时取反
+        __m128i flip = _mm_or_si128(gySign, _mm_and_si128(_mm_cmpeq_epi16(gy, zero), gxSign));
+        gx = _mm_sub_epi16(_mm_xor_si128(gx, flip), flip);
+        gy = _mm_sub_epi16(_mm_xor_si128(gy, flip), flip);
+
+        // 交错排列 (gy, gx)，madd 得到 32 位的 gy * cos - gx * sin
+        __m128i lo = _mm_unpacklo_epi16(gy, gx), hi = _mm_unpackhi_epi16(gy, gx);
+        __m128i bin = zero;
+
+        for (int k = 0; k < 7; k++) {
+            __m128i coefficients = _mm_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(-boundarySin[k])) << 16) | static_cast<uint16_t>(boundaryCos[k])));
+            __m128i above0 = _mm_cmpgt_epi32(_mm_madd_epi16(lo, coefficients), zero);
+            __m128i above1 = _mm_cmpgt_epi32(_mm_madd_epi16(hi, coefficients), zero);
+            bin = _mm_sub_epi16(bin, _mm_packs_epi32(above0, above1));
+        }
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(orientation + x), _mm_packus_epi16(bin, zero));
+    }
+
+    return x;
+}
+#endif
+
+
+// 每次调用复用的灰度图
+thread_local std::vector<uint8_t> grayScratch;
+
+
+void gradient::compute(const std::byte* data, int width, int height, int step, GradientMap& map, bool allowSimd) {
+    map.width = std::max(width, 0);
+    map.height = std::max(height, 0);
+    map.magnitude.assign(static_cast<size_t>(map.width) * map.height, 0);
+    map.orientation.assign(static_cast<size_t>(map.width) * map.height, 0);
+
+    if (!data || width < 3 || height < 3)
+        return;
+
+    toGray(data, width, height, step, grayScratch);
+
+    for (int y = 1; y < height - 1; y++) {
+        const uint8_t* row = grayScratch.data() + static_cast<size_t>(y) * width;
+        const uint8_t* above = row - width;
+        const uint8_t* below = row + width;
+        uint8_t* magnitude = map.magnitude.data() + static_cast<size_t>(y) * width;
+        uint8_t* orientation = map.orientation.data() + static_cast<size_t>(y) * width;
+
+        int x = 1;
+#ifdef GRADIENT_SSE2
+        if (allowSimd)
+            x = sobelRowSse2(above, row, below, magnitude, orientation, width);
+#endif
+        for (; x < width - 1; x++)
+            sobelPixel(above + x, row + x, below + x, magnitude[x], orientation[x]);
+    }
+}
+
+
+auto gradient::makeTemplate(const GradientMap& map, int threshold, int maxFeatures) -> OutlineTemplate {
+    OutlineTemplate outline { map.width, map.height };
+
+    std::vector<std::pair<uint8_t, int>> candidates;
+    for (int i = 0; i < map.width * map.height; i++) {
+        if (map.magnitude[i] >= threshold)
+            candidates.emplace_back(map.magnitude[i], i);
+    }
+
+    // 梯度相同时按位置排序，保证结果稳定
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    for (const auto& [magnitude, index]: candidates) {
+        if (static_cast<int>(outline.features.size()) >= maxFeatures)
+            break;
+
+        int x = index % map.width, y = index / map.width;
+        bool tooClose = std::any_of(outline.features.begin(), outline.features.end(), [&](const Feature& feature) {
+            return std::abs(feature.x - x) < 2 && std::abs(feature.y - y) < 2;
+        });
+
+        if (!tooClose)
+            outline.features.push_back({ static_cast<int16_t>(x), static_cast<int16_t>(y), map.orientation[index] });
+    }
+
+    return outline;
+}
+
+
+// 每个像素的方向用一个位表示，梯度较弱的像素为 0
+void orientationBits(const gradient::GradientMap& map, int threshold, std::vector<uint8_t>& bits) {
+    bits.resize(map.magnitude.size());
+    for (size_t i = 0; i < bits.size(); i++)
+        bits[i] = map.magnitude[i] >= threshold ? static_cast<uint8_t>(1 << map.orientation[i]) : 0;
+}
+
+
+// 每个像素把自己的方向扩散到 3 x 3 的范围
+void spreadOrientations(const std::vector<uint8_t>& bits, int width, int height, std::vector<uint8_t>& spread) {
+    // 先横向再纵向
+    std::vector<uint8_t> horizontal(bits.size());
+    for (int y = 0; y < height; y++) {
+        const uint8_t* in = bits.data() + static_cast<size_t>(y) * width;
+        uint8_t* out = horizontal.data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++)
+            out[x] = in[x] | (x > 0 ? in[x - 1] : 0) | (x + 1 < width ? in[x + 1] : 0);
+    }
+
+    spread.resize(bits.size());
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = horizontal.data() + static_cast<size_t>(y) * width;
+        uint8_t* out = spread.data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++)
+            out[x] = row[x] | (y > 0 ? row[x - width] : 0) | (y + 1 < height ? row[x + width] : 0);
+    }
+}
+
+
+auto gradient::match(const GradientMap& map, const OutlineTemplate& outline, int threshold, double minScore) -> std::vector<Match> {
+    std::vector<Match> matches;
+    if (outline.features.empty() || map.width < outline.width || map.height < outline.height)
+        return matches;
+
+    std::vector<uint8_t> bits, spread;
+    orientationBits(map, threshold, bits);
+    spreadOrientations(bits, map.width, map.height, spread);
+
+    // 特征点的方向以及相邻的两个方向，特征点在梯度图中的偏移
+    std::vector<std::pair<ptrdiff_t, uint8_t>> probes;
+    for (const Feature& feature: outline.features) {
+        uint8_t bin = feature.orientation;
+        uint8_t mask = static_cast<uint8_t>((1 << bin) | (1 << ((bin + 1) & 7)) | (1 << ((bin + 7) & 7)));
+        probes.emplace_back(static_cast<ptrdiff_t>(feature.y) * map.width + feature.x, mask);
+    }
+
+    // 得分达不到 required 时提前结束
+    int total = static_cast<int>(probes.size());
+    auto countMatched = [&](const std::vector<uint8_t>& orientations, int x, int y, int required) {
+        const uint8_t* origin = orientations.data() + static_cast<size_t>(y) * map.width + x;
+        int matched = 0;
+        for (int i = 0; i < total && matched + (total - i) >= required; i++)
+            matched += (origin[probes[i].first] & probes[i].second) != 0;
+        return matched;
+    };
+
+    int required = static_cast<int>(minScore * total + 0.999);
+
+    for (int y = 0; y + outline.height <= map.height; y++) {
+        for (int x = 0; x + outline.width <= map.width; x++) {
+            int matched = countMatched(spread, x, y, required);
+            if (matched >= required)
+                matches.push_back({ x, y, static_cast<double>(matched) / total });
+        }
+    }
+
+    std::stable_sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) { return a.score > b.score; });
+
+    // 与得分更高的位置重叠超过一半的位置不再保留
+    std::vector<Match> result;
+    for (const Match& candidate: matches) {
+        bool overlapped = std::any_of(result.begin(), result.end(), [&](const Match& kept) {
+            return std::abs(kept.x - candidate.x) * 2 < outline.width && std::abs(kept.y - candidate.y) * 2 < outline.height;
+        });
+        if (!overlapped)
+            result.push_back(candidate);
+    }
+
+    // 扩散后相邻的位置得分往往相同，用没有扩散的方向在 3 x 3 范围内找到最准确的位置
+    for (Match& found: result) {
+        int bestX = found.x, bestY = found.y, best = -1;
+        for (int y = std::max(found.y - 1, 0); y <= std::min(found.y + 1, map.height - outline.height); y++) {
+            for (int x = std::max(found.x - 1, 0); x <= std::min(found.x + 1, map.width - outline.width); x++) {
+                int matched = countMatched(bits, x, y, 0);
+                if (matched > best)
+                    best = matched, bestX = x, bestY = y;
+            }
+        }
+        found.x = bestX;
+        found.y = bestY;
+    }
+
+    return result;
+}
+
+
+auto gradient::sobel(std::byte* data, int width, int height, int step) {
+    auto image = std::make_tuple(
+        std::make_pair("width", 0),
+        std::make_pair("height", 0),
+        std::make_pair("channels", 2),
+        std::make_pair("step", 0),
+        std::make_pair("data", frame::Buffer { nullptr, 0 })
+    );
+
+    if (!data || width <= 0 || height <= 0)
+        return image;
+
+    GradientMap map;
+    compute(data, width, height, step, map);
+
+    // 交错排列为 [梯度大小, 方向]，与截图一样使用帧缓冲池
+    size_t pixels = static_cast<size_t>(width) * height;
+    frame::Buffer buffer = frame::acquire(pixels * 2);
+    for (size_t i = 0; i < pixels; i++) {
+        buffer.data[i * 2] = std::byte { map.magnitude[i] };
+        buffer.data[i * 2 + 1] = std::byte { map.orientation[i] };
+    }
+
+    std::get<0>(image).second = width;
+    std::get<1>(image).second = height;
+    std::get<3>(image).second = width * 2;
+    std::get<4>(image).second = buffer;
+    return image;
+}
+
+
+struct TemplateRegistry {
+    std::mutex mutex;
+    std::unordered_map<uint32_t, gradient::OutlineTemplate> templates {};
+    uint32_t nextId = 1;
+};
+
+TemplateRegistry templateRegistry;
+
+
+auto gradient::createTemplate(std::byte* data, int width, int height, int step, int threshold, int maxFeatures) -> uint32_t {
+    GradientMap map;
+    compute(data, width, height, step, map);
+
+    std::lock_guard lock(templateRegistry.mutex);
+    uint32_t id = templateRegistry.nextId++;
+    templateRegistry.templates.emplace(id, makeTemplate(map, threshold, maxFeatures));
+    return id;
+}
+
+
+void gradient::destroyTemplate(uint32_t id) {
+    std::lock_guard lock(templateRegistry.mutex);
+    templateRegistry.templates.erase(id);
+}
+
+
+auto gradient::matchTemplate(uint32_t id, std::byte* data, int width, int height, int step, int threshold, double minScore) {
+    using MatchObject = std::tuple<
+        std::pair<const char*, int>,
+        std::pair<const char*, int>,
+        std::pair<const char*, double>
+    >;
+
+    std::vector<MatchObject> result;
+
+    OutlineTemplate outline;
+    {
+        std::lock_guard lock(templateRegistry.mutex);
+        auto it = templateRegistry.templates.find(id);
+        if (it == templateRegistry.templates.end())
+            return result;
+        outline = it->second;
+    }
+
+    GradientMap map;
+    compute(data, width, height, step, map);
+
+    for (const Match& found: match(map, outline, threshold, minScore))
+        result.emplace_back(std::make_pair("x", found.x), std::make_pair("y", found.y), std::make_pair("score", found.score));
+
+    return result;
+}
@@ -0,0 +1,274 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <vector>
+#include <algorithm>
+
+export module image;
+
+
+export namespace image {
+    auto fingerprint(std::byte* data, int width, int height, int step, int threshold) -> uint64_t;
+    auto compareFingerprints(uint64_t before, uint64_t after);
+
+    // 前景像素的颜色条件：与 color (0x00BBGGRR，与 GetPixel 和 win.rgb 相同) 每个通道的差都不超过 tolerance
+    struct ColorPredicate {
+        uint8_t lower[3];   // BGR 顺序，与像素数据相同
+        uint8_t range[3];
+
+        ColorPredicate(uint32_t color, int tolerance);
+
+        // 像素值减去下限后按无符号数比较，一次比较同时检查上下限
+        bool operator()(const uint8_t* pixel) const {
+            return static_cast<unsigned>(pixel[0] - lower[0]) <= range[0]
+                && static_cast<unsigned>(pixel[1] - lower[1]) <= range[1]
+                && static_cast<unsigned>(pixel[2] - lower[2]) <= range[2];
+        }
+    };
+
+    // 连通区域的包围盒 [left, top, right, bottom)、像素数和重心
+    struct Blob {
+        int left, top, right, bottom;
+        int area;
+        double centerX, centerY;
+    };
+
+    // 标记 BGRA 图像中前景像素的 8 连通区域，只返回像素数不少于 minArea 的区域，按区域中第一个像素的扫描顺序排列
+    auto labelBlobs(const std::byte* data, int width, int height, int step, const ColorPredicate& predicate, int minArea) -> std::vector<Blob>;
+
+    // 供脚本使用，返回 [{ left, top, right, bottom, area, x, y }, ...]，x 和 y 为重心
+    auto findBlobs(std::byte* data, int width, int height, int step, uint32_t color, int tolerance, int minArea);
+}
+
+
+// 指纹网格的列数和行数，列数 x 行数 = 64，正好对应 uint64_t 的每一位
+constexpr int gridCols = 16;
+constexpr int gridRows = 4;
+
+
+// 计算 BGRA 图像区域的指纹
+// 将区域划分为 16 x 4 个格子，格子中亮度不低于 threshold 的像素超过 1/32 时，对应的位为1
+// 对话文本是浅色的文字，所以指纹的每一位大致表示 "这个格子里有没有文字"
+auto image::fingerprint(std::byte* data, int width, int height, int step, int threshold) -> uint64_t {
+    if (!data || width < gridCols || height < gridRows)
+        return 0;
+
+    uint64_t result = 0;
+
+    for (int row = 0; row < gridRows; row++) {
+        int top = height * row / gridRows;
+        int bottom = height * (row + 1) / gridRows;
+
+        for (int col = 0; col < gridCols; col++) {
+            int left = width * col / gridCols;
+            int right = width * (col + 1) / gridCols;
+
+            int brightCount = 0;
+            for (int y = top; y < bottom; y++) {
+                const uint8_t* pixel = reinterpret_cast<const uint8_t*>(data + y * step) + left * 4;
+                for (int x = left; x < right; x++, pixel += 4) {
+                    // 近似亮度: (R * 2 + G * 5 + B) / 8
+                    int luminance = (pixel[2] * 2 + pixel[1] * 5 + pixel[0]) >> 3;
+                    brightCount += luminance >= threshold;
+                }
+            }
+
+            int cellArea = (right - left) * (bottom - top);
+            if (brightCount * 32 > cellArea)
+                result |= uint64_t(1) << (row * gridCols + col);
+        }
+    }
+
+    return result;
+}
+
+
+// 比较前后两个指纹，返回新出现文字的格子数 added 和文字消失的格子数 removed
+// 文字逐字显示时只会出现 added，切换到下一句对话时会出现 removed
+auto image::compareFingerprints(uint64_t before, uint64_t after) {
+    return std::make_tuple(
+        std::make_pair("added", std::popcount(~before & after)),
+        std::make_pair("removed", std::popcount(before & ~after))
+    );
+}
+
+
+image::ColorPredicate::ColorPredicate(uint32_t color, int tolerance) {
+    tolerance = std::clamp(tolerance, 0, 255);
+
+    // color 为 0x00BBGGRR，像素数据为 BGRA
+    for (int channel = 0; channel < 3; channel++) {
+        int value = (color >> ((2 - channel) * 8)) & 0xFF;
+        int low = std::max(value - tolerance, 0);
+        int high = std::min(value + tolerance, 255);
+        lower[channel] = static_cast<uint8_t>(low);
+        range[channel] = static_cast<uint8_t>(high - low);
+    }
+}
+
+
+// 一个标签中所有像素的统计，标签合并时统计也合并
+struct BlobAccumulator {
+    int left, top, right, bottom;
+    int64_t area = 0;
+    int64_t sumX = 0;
+    int64_t sumY = 0;
+
+    void merge(const BlobAccumulator& other) {
+        left = std::min(left, other.left);
+        top = std::min(top, other.top);
+        right = std::max(right, other.right);
+        bottom = std::max(bottom, other.bottom);
+        area += other.area;
+        sumX += other.sumX;
+        sumY += other.sumY;
+    }
+};
+
+
+// 每次调用复用的缓冲区，避免每一帧重新分配
+struct BlobScratch {
+    std::vector<uint32_t> parent {};
+    std::vector<BlobAccumulator> accumulators {};
+    std::vector<uint32_t> rows {};
+};
+
+thread_local BlobScratch blobScratch;
+
+
+uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t label) {
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+
+// 合并两个标签所在的集合，编号较小的根作为新的根，所以每个集合的根都是其中最早出现的标签
+uint32_t unite(std::vector<uint32_t>& parent, uint32_t a, uint32_t b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a > b)
+        std::swap(a, b);
+    parent[b] = a;
+    return a;
+}
+
+
+// 单遍扫描: 每个前景像素根据已经扫描过的相邻像素 (左、左上、上、右上) 得到标签，相邻的不同标签用并查集合并
+// 只保留上一行和当前行的标签，统计数据在扫描时累加到像素所在的标签，扫描结束后再合并到集合的根
+auto image::labelBlobs(const std::byte* data, int width, int height, int step, const ColorPredicate& predicate, int minArea) -> std::vector<Blob> {
+    std::vector<Blob> blobs;
+    if (!data || width <= 0 || height <= 0)
+        return blobs;
+
+    auto& [parent, accumulators, rows] = blobScratch;
+    parent.assign(1, 0);
+    accumulators.assign(1, BlobAccumulator {});
+
+    // 每行前后各留一个值为 0 的位置，边界上的像素不需要特殊处理
+    rows.assign(static_cast<size_t>(width + 2) * 2, 0);
+    uint32_t* previous = rows.data() + 1;
+    uint32_t* current = rows.data() + width + 3;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* pixel = reinterpret_cast<const uint8_t*>(data + static_cast<size_t>(y) * step);
+
+        for (int x = 0; x < width; x++, pixel += 4) {
+            if (!predicate(pixel)) {
+                current[x] = 0;
+                continue;
+            }
+
+            uint32_t label;
+
+            // 正上方的像素是前景时，它与左上、右上、左边的前景像素都已经相连
+            if (previous[x])
+                label = previous[x];
+
+            // 否则左边和左上的像素相连，只需要与右上合并
+            else {
+                uint32_t left = current[x - 1] ? current[x - 1] : previous[x - 1];
+                uint32_t upRight = previous[x + 1];
+
+                if (left && upRight && left != upRight)
+                    label = unite(parent, left, upRight);
+                else if (left || upRight)
+                    label = left ? left : upRight;
+                else {
+                    label = static_cast<uint32_t>(parent.size());
+                    parent.push_back(label);
+                    accumulators.push_back({ x, y, x + 1, y + 1 });
+                }
+            }
+
+            current[x] = label;
+
+            BlobAccumulator& accumulator = accumulators[label];
+            accumulator.left = std::min(accumulator.left, x);
+            accumulator.right = std::max(accumulator.right, x + 1);
+            accumulator.bottom = y + 1;
+            accumulator.area++;
+            accumulator.sumX += x;
+            accumulator.sumY += y;
+        }
+
+        std::swap(previous, current);
+    }
+
+    // 根的编号总是小于集合中的其它标签，倒序合并时每个标签的统计只会合并一次
+    for (uint32_t label = static_cast<uint32_t>(parent.size()) - 1; label > 0; label--) {
+        uint32_t root = findRoot(parent, label);
+        if (root != label)
+            accumulators[root].merge(accumulators[label]);
+    }
+
+    for (uint32_t label = 1; label < parent.size(); label++) {
+        const BlobAccumulator& accumulator = accumulators[label];
+        if (parent[label] != label || accumulator.area < minArea)
+            continue;
+
+        blobs.push_back({
+            accumulator.left, accumulator.top, accumulator.right, accumulator.bottom,
+            static_cast<int>(accumulator.area),
+            static_cast<double>(accumulator.sumX) / accumulator.area,
+            static_cast<double>(accumulator.sumY) / accumulator.area
+        });
+    }
+
+    return blobs;
+}
+
+
+auto image::findBlobs(std::byte* data, int width, int height, int step, uint32_t color, int tolerance, int minArea) {
+    using BlobObject = std::tuple<
+        std::pair<const char*, int>,
+        std::pair<const char*, int>,
+        std::pair<const char*, int>,
+        std::pair<const char*, int>,
+        std::pair<const char*, int>,
+        std::pair<const char*, double>,
+        std::pair<const char*, double>
+    >;
+
+    std::vector<BlobObject> result;
+
+    for (const Blob& blob: labelBlobs(data, width, height, step, ColorPredicate(color, tolerance), minArea)) {
+        result.emplace_back(
+            std::make_pair("left", blob.left),
+            std::make_pair("top", blob.top),
+            std::make_pair("right", blob.right),
+            std::make_pair("bottom", blob.bottom),
+            std::make_pair("area", blob.area),
+            std::make_pair("x", blob.centerX),
+            std::make_pair("y", blob.centerY)
+        );
+    }
+
+    return result;
+}
@@ -1,80 +1,691 @@
 #include <string>
+#include <tuple>
+#include <array>
 #include <format>
+#include <string_view>
 #include <filesystem>
+#include <future>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
 #include <windows.h>
 
 import console;
 import quickjs;
 import win;
+import image;
+import frame;
+import eventlog;
+import startup;
+import process;
+import geometry;
+import gradient;
+import detector;
+import scheduler;
+import trace;
+import metrics;
+import watch;
+import reload;
 
-auto bindGlobalFunctions(qjs::Value& globalObject) -> void;
+auto addNativeModules(qjs::Context& context) -> void;
+
+auto reportStall(const qjs::StallReport& report) -> void;
+
+auto runTargets(const std::filesystem::path& baseDir) -> void;
+
+auto runWithReload(const std::filesystem::path& baseDir, qjs::Runtime& runtime, const std::function<void(qjs::Context&)>& prepare) -> void;
+
+auto saveTrace() -> void;
  
 
-auto main() -> int {
+auto main(int argc, char* argv[]) -> int {
+    bool virtualClock = false;
+    bool multiTarget = false;
+    bool watchScripts = false;
+
+    for(int i = 1; i < argc; i++) {
+        // 在进入剧情检测的主循环时输出每个启动阶段的耗时
+        if(std::string_view(argv[i]) == "--trace-startup")
+            startup::enable();
+
+        // 计时器、sleep 和 Date.now 使用虚拟时间，用于快速且可重复地运行依赖计时的脚本
+        else if(std::string_view(argv[i]) == "--virtual-clock")
+            virtualClock = true;
+
+        // 同时控制所有找到的游戏客户端，每个客户端使用独立的运行时
+        else if(std::string_view(argv[i]) == "--multi")
+            multiTarget = true;
+
+        // 记录原生函数、事件循环和脚本加载的耗时，退出时保存到 logs/trace.json
+        else if(std::string_view(argv[i]) == "--trace")
+            trace::enable();
+
+        // 修改脚本后在同一个运行时中重新加载，不需要重启程序
+        else if(std::string_view(argv[i]) == "--watch")
+            watchScripts = true;
+    }
+
+    trace::setThreadName("main");
+
+    // 按 Ctrl+C 或者关闭控制台窗口时不会执行到 main 的结尾，在控制台的回调中保存性能追踪
+    // 返回 FALSE 交给默认的处理 (结束进程)
+    SetConsoleCtrlHandler([](DWORD type) -> BOOL {
+        if(type == CTRL_C_EVENT || type == CTRL_BREAK_EVENT || type == CTRL_CLOSE_EVENT)
+            saveTrace();
+        return FALSE;
+    }, TRUE);
+
     try {
         console::init("GenshinAuto V2", 100, 30);
-        console::info(std::format("GenshinAuto {}v2.4{}", console::ansi::blue, console::ansi::reset));
+        console::panel::start(std::format("GenshinAuto {}v2.4{}", console::ansi::blue, console::ansi::reset), 100, 30);
+        startup::phase("consoleInit");
 
         std::filesystem::path baseDir = win::getBaseDir();
-        win::loadResourceToFile(101, baseDir / "api.js");
-        win::loadResourceToFile(102, baseDir / "script.js");
 
-        qjs::Runtime jsRuntime(baseDir);
-        qjs::Context context = jsRuntime.createContext();
+        // 释放脚本文件和创建运行时互不依赖，同时进行
+        auto resourcesWritten = std::async(std::launch::async, [baseDir]() {
+            // api.js 调用的原生函数随程序更新，旧版本生成的 api.js 与当前程序不匹配时重新生成；script.js 由用户修改，只在不存在时生成
+            win::loadResourceToFile(101, baseDir / "api.js", true);
+            win::loadResourceToFile(102, baseDir / "script.js");
+        });
 
-        qjs::Value global = context.getGlobal();
+        eventlog::open(baseDir / "logs");
+        startup::phase("eventLogOpen");
 
-        bindGlobalFunctions(global);
-        
-        context.onJsFileLoaded.push_back([](const char* filePath){
-            console::info(std::format("加载脚本: {}{}{}", console::ansi::blue, filePath, console::ansi::reset));
-        });
+        // 运行指标写入共享内存，可以用 metrics 工具读取
+        if(!metrics::open())
+            console::error(std::format("无法创建运行指标的共享内存 {}，可能已有另一个实例在运行", metrics::defaultName));
+
+        if(multiTarget) {
+            // 每个目标有自己的运行时和事件循环，这两个选项只用于单目标模式
+            if(watchScripts)
+                console::error("多目标模式不支持 --watch，修改脚本后需要重启程序");
+            if(virtualClock)
+                console::error("多目标模式不支持 --virtual-clock，使用真实时间");
+
+            resourcesWritten.wait();
+            runTargets(baseDir);
+        }
+        else {
+            qjs::Runtime jsRuntime(baseDir);
+            if(virtualClock)
+                jsRuntime.setClock(std::make_unique<qjs::VirtualClock>());
+            startup::phase("runtimeCreate");
 
-        context.evalFile("./script.js");
+            // 脚本阻塞事件循环时输出看门狗的报告
+            jsRuntime.onStall.push_back(reportStall);
 
-        context.loop();
+            // 热重载时新的上下文也用这个函数注册原生模块和回调
+            bool firstTick = true;
+            auto prepareContext = [&firstTick, &jsRuntime](qjs::Context& context) {
+                addNativeModules(context);
+
+                context.onJsFileLoaded.push_back([](const char* filePath){
+                    console::info(std::format("加载脚本: {}{}{}", console::ansi::blue, filePath, console::ansi::reset));
+                });
+
+                // 每一帧结束时清空截图缓存，并在状态面板中记录这一帧的耗时
+                context.onTickEnd.push_back([&firstTick, &jsRuntime](double tickMs) {
+                    if(firstTick) {
+                        firstTick = false;
+                        startup::phase("firstTick");
+                    }
+
+                    win::invalidateFrameCache();
+                    console::panel::recordTick(tickMs);
+                    eventlog::write(eventlog::Type::Tick, 0, tickMs);
+                    metrics::recordTick(tickMs);
+                    metrics::setMemoryBytes(jsRuntime.memoryBytes());
+                });
+            };
+
+            if(watchScripts) {
+                resourcesWritten.wait();
+                runWithReload(baseDir, jsRuntime, prepareContext);
+            }
+            else {
+                qjs::Context context = jsRuntime.createContext();
+                prepareContext(context);
+                startup::phase("nativeModules");
+
+                resourcesWritten.wait();
+                startup::phase("resourcesWritten");
+
+                context.evalFile("./script.js");
+                startup::phase("evalScript");
+
+                context.loop();
+            }
+        }
     }
     catch(const std::exception& e) {
+        // 错误信息可能有很多行，关闭状态面板后直接输出
+        console::panel::stop();
         console::error(e.what());
     }
 
-    system("pause");
+    console::panel::stop();
+    metrics::close();
+    eventlog::close();
+
+    saveTrace();
+
+    console::pause();
     return 0;
 }
 
 
 
-auto bindGlobalFunctions(qjs::Value& globalObject) -> void { 
-globalObject
-    .func<win::getPid>("_getPid")
-    .func<win::getHwnd>("_getHwnd")
-    .func<win::getWndSize>("_getWndSize")
-    .func<win::captureWindow>("_captureWindow")
-    .func<win::saveBitmapImage>("_saveBitmapImage")
-    .func<console::print>("_print")
-
-    .func<Sleep>("_sleep")
-    .func<GetDC>("_getDC")
-    .func<GetPixel>("_getPixel")
-    .func<PostMessageW>("_postMessageW")
-    .func<ReleaseDC>("_releaseDC")
-    .func<ClipCursor>("_clipCursor")
-    .func<SetForegroundWindow>("_setForegroundWindow")
-    .func<keybd_event>("_keybdEvent")
-    .func<mouse_event>("_mouseEvent")
-    .func<SetCursorPos>("_setCursorPos")
-
-    .func<[]() {
+// 开启了性能追踪时保存到 logs/trace.json，正常退出和控制台的回调中都会调用，只保存一次
+auto saveTrace() -> void {
+    static std::atomic<bool> saved = false;
+    if(!trace::isEnabled() || saved.exchange(true))
+        return;
+
+    auto tracePath = win::getBaseDir() / "logs" / "trace.json";
+    if(trace::exportJson(tracePath))
+        console::info(std::format("性能追踪已保存到 {}", tracePath.string()));
+}
+
+
+
+// 脚本找到的游戏进程和窗口，使用 --watch 热重载时作为全局变量 reloadTarget 传给新的上下文
+std::atomic<DWORD> reloadPid = 0;
+std::atomic<HWND> reloadHwnd = nullptr;
+
+
+// 原生模块的函数表，在编译期生成，脚本中通过 import { getPixel } from "native:win" 使用
+constexpr auto consoleFunctions = std::array {
+    qjs::function<console::print>("print"),
+    qjs::function<console::log>("log"),
+    qjs::function<console::panel::setState>("setState"),
+    qjs::function<console::panel::setCounter>("setCounter"),
+    qjs::function<console::panel::addCounter>("addCounter"),
+
+    qjs::function<[]() {
         static char buffer[256];
         fgets(buffer, sizeof(buffer), stdin);
         return buffer;
-    }>("_input")
+    }>("input"),
+};
 
-    .func<[](const char* dirName) {
-        return std::filesystem::create_directories(dirName);
-    }>("_mkdir")
-    
-    .func<[](int vKey) { 
+constexpr auto winFunctions = std::array {
+    qjs::function<win::getPid>("getPid"),
+    qjs::function<win::getHwnd>("getHwnd"),
+    qjs::function<win::getWndSize>("getWndSize"),
+    qjs::function<win::captureWindow>("captureWindow"),
+    qjs::function<win::saveBitmapImage>("saveBitmapImage"),
+    qjs::function<frame::setCapacity>("setFramePoolCapacity"),
+    qjs::function<frame::stats>("framePoolStats"),
+
+    qjs::function<win::addFrameRegion>("addFrameRegion"),
+    qjs::function<win::clearFrameRegions>("clearFrameRegions"),
+    qjs::function<win::getFramePixel>("getFramePixel"),
+    qjs::function<win::captureFrame>("captureFrame"),
+    qjs::function<win::frameCacheStats>("frameCacheStats"),
+
+    qjs::function<win::trackWindow>("trackWindow"),
+    qjs::function<win::untrackWindow>("untrackWindow"),
+    qjs::function<win::validateWindow>("validateWindow"),
+    // 创建原生资源的函数把编号记录在调用者的上下文中，热重载替换上下文时一起释放
+    qjs::function<[](JSContext* ctx, int baseWidth, int baseHeight) {
+        uint32_t id = geometry::createCalibration(baseWidth, baseHeight);
+        qjs::Context::of(ctx).own(geometry::destroyCalibration, id);
+        return id;
+    }>("createCalibration"),
+
+    qjs::function<[](JSContext* ctx, uint32_t id) {
+        qjs::Context::of(ctx).release(geometry::destroyCalibration, id);
+    }>("destroyCalibration"),
+
+    qjs::function<geometry::addCalibrationPoint>("addCalibrationPoint"),
+    qjs::function<geometry::addCalibrationRect>("addCalibrationRect"),
+    qjs::function<geometry::updateCalibration>("updateCalibration"),
+    qjs::function<geometry::getCalibrationPoint>("getCalibrationPoint"),
+    qjs::function<geometry::getCalibrationRect>("getCalibrationRect"),
+
+    qjs::function<GetDC>("getDC"),
+    qjs::function<GetPixel>("getPixel"),
+    qjs::function<ReleaseDC>("releaseDC"),
+
+    // 前台窗口、鼠标和键盘是所有目标共享的，多目标模式下这些函数通过输入调度串行执行
+    // 其它目标的输入事务进行中时不执行并返回 false，由脚本稍后重试
+    qjs::function<[](const RECT* rect) {
+        auto lock = scheduler::lockInput();
+        return lock && ClipCursor(rect);
+    }>("clipCursor"),
+
+    qjs::function<[](HWND hwnd) {
+        auto lock = scheduler::lockInput();
+        if(!lock)
+            return false;
+        metrics::addInput();
+        return SetForegroundWindow(hwnd) != FALSE;
+    }>("setForegroundWindow"),
+
+    qjs::function<[](int x, int y) {
+        auto lock = scheduler::lockInput();
+        return lock && SetCursorPos(x, y);
+    }>("setCursorPos"),
+
+    // 输入事务，由 api.js 的 win.withInput 使用，其它目标持有事务时 tryBeginInput 返回 false
+    qjs::function<scheduler::tryBeginInput>("tryBeginInput"),
+    qjs::function<scheduler::endInput>("endInput"),
+
+    // 输入相关的函数会写入事件日志
+    // 窗口消息直接进入目标窗口的消息队列，不需要前台窗口，所以不经过输入调度
+    qjs::function<[](HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+        static const uint32_t name = eventlog::intern("postMessageW");
+        eventlog::write(eventlog::Type::Input, name, msg, static_cast<double>(wParam));
+        metrics::addInput();
+        if(msg == WM_KEYDOWN)
+            metrics::addPress();
+        return PostMessageW(hwnd, msg, wParam, lParam);
+    }>("postMessageW"),
+
+    qjs::function<[](BYTE bVk, BYTE bScan, DWORD dwFlags, ULONG_PTR dwExtraInfo) {
+        static const uint32_t name = eventlog::intern("keybdEvent");
+        auto lock = scheduler::lockInput();
+        if(!lock)
+            return false;
+        eventlog::write(eventlog::Type::Input, name, dwFlags, bVk);
+        metrics::addInput();
+        if(!(dwFlags & KEYEVENTF_KEYUP))
+            metrics::addPress();
+        keybd_event(bVk, bScan, dwFlags, dwExtraInfo);
+        return true;
+    }>("keybdEvent"),
+
+    qjs::function<[](DWORD dwFlags, DWORD dx, DWORD dy, DWORD dwData, ULONG_PTR dwExtraInfo) {
+        static const uint32_t name = eventlog::intern("mouseEvent");
+        auto lock = scheduler::lockInput();
+        if(!lock)
+            return false;
+        eventlog::write(eventlog::Type::Input, name, dwFlags, dwData);
+        metrics::addInput();
+        mouse_event(dwFlags, dx, dy, dwData, dwExtraInfo);
+        return true;
+    }>("mouseEvent"),
+
+    qjs::function<[](int vKey) { 
         return (GetAsyncKeyState(vKey) & 0x8000) != 0; 
-    }>("_isKeyDown");
-}
\ No newline at end of file
+    }>("isKeyDown"),
+};
+
+constexpr auto imageFunctions = std::array {
+    qjs::function<image::fingerprint>("fingerprint"),
+    qjs::function<image::compareFingerprints>("compareFingerprints"),
+    qjs::function<image::findBlobs>("findBlobs"),
+    qjs::function<gradient::sobel>("sobel"),
+    qjs::function<[](JSContext* ctx, std::byte* data, int width, int height, int step, int threshold, int maxFeatures) {
+        uint32_t id = gradient::createTemplate(data, width, height, step, threshold, maxFeatures);
+        qjs::Context::of(ctx).own(gradient::destroyTemplate, id);
+        return id;
+    }>("createOutlineTemplate"),
+
+    qjs::function<[](JSContext* ctx, uint32_t id) {
+        qjs::Context::of(ctx).release(gradient::destroyTemplate, id);
+    }>("destroyOutlineTemplate"),
+
+    qjs::function<gradient::matchTemplate>("matchOutline"),
+    qjs::function<[](JSContext* ctx) {
+        uint32_t id = detector::createBank();
+        qjs::Context::of(ctx).own(detector::destroyBank, id);
+        return id;
+    }>("createDetectorBank"),
+
+    qjs::function<[](JSContext* ctx, uint32_t id) {
+        qjs::Context::of(ctx).release(detector::destroyBank, id);
+    }>("destroyDetectorBank"),
+
+    qjs::function<detector::addTemplate>("addDetector"),
+    qjs::function<detector::scanBank>("scanDetectorBank"),
+    qjs::function<detector::bankStats>("detectorBankStats"),
+};
+
+constexpr auto processFunctions = std::array {
+    qjs::function<[](JSContext* ctx, std::vector<std::string> names) {
+        uint32_t id = process::createWatcher(std::move(names));
+        qjs::Context::of(ctx).own(process::destroyWatcher, id);
+        return id;
+    }>("createWatcher"),
+
+    qjs::function<[](JSContext* ctx, uint32_t id) {
+        qjs::Context::of(ctx).release(process::destroyWatcher, id);
+    }>("destroyWatcher"),
+
+    qjs::function<process::scanWatcher>("scanWatcher"),
+};
+
+constexpr auto osFunctions = std::array {
+    qjs::function<[](const char* dirName) {
+        return std::filesystem::create_directories(dirName);
+    }>("mkdir"),
+
+    qjs::function<qjs::allocatorStats>("allocatorStats"),
+
+    // 脚本找到游戏窗口，或者游戏进程退出 (pid 为 0) 时调用
+    qjs::function<[](DWORD pid, HWND hwnd) {
+        reloadPid.store(pid);
+        reloadHwnd.store(hwnd);
+    }>("setReloadTarget"),
+
+    // 与 native:runtime 中的 sleep 相同，保留给从 native:os 导入 sleep 的旧版 api.js
+    qjs::function<qjs::sleep>("sleep"),
+
+    // 脚本进入剧情检测的主循环之前调用，记录启动完成的时间
+    // 脚本在这之前等待游戏进程和窗口，所以单独记录，不计入原生启动阶段
+    qjs::function<[]() {
+        static std::atomic<bool> ready = false;
+        if(ready.exchange(true))
+            return;
+
+        startup::milestone("firstDetectionTick");
+        eventlog::write(eventlog::Type::Message, eventlog::intern("startupReady"), startup::sinceLaunchMs());
+
+        if(startup::isEnabled())
+            console::info(startup::report());
+    }>("startupReady"),
+};
+
+constexpr auto eventlogFunctions = std::array {
+    qjs::function<[](const char* text) {
+        return eventlog::intern(text);
+    }>("intern"),
+
+    // type 不是 eventlog::Type 中的记录类型，或者 message 带有文本标记时不写入，返回 false
+    qjs::function<[](int type, uint32_t message, double value0, double value1) {
+        if(type <= static_cast<int>(eventlog::Type::String) || static_cast<int>(eventlog::Type::Tick) < type || (message & eventlog::inlineText))
+            return false;
+
+        eventlog::write(static_cast<eventlog::Type>(type), message, value0, value1);
+        if(static_cast<eventlog::Type>(type) == eventlog::Type::Detection && value0 != 0)
+            metrics::addDetection();
+        return true;
+    }>("write"),
+
+    // 每次都不同的文本不进入字符串表，跟在记录后面写入
+    qjs::function<[](int type, const char* text, double value0, double value1) {
+        if(type != static_cast<int>(eventlog::Type::Message) && type != static_cast<int>(eventlog::Type::Error))
+            return false;
+
+        eventlog::writeText(static_cast<eventlog::Type>(type), text, value0, value1);
+        return true;
+    }>("writeText"),
+
+    qjs::function<eventlog::stats>("stats"),
+};
+
+constexpr auto traceFunctions = std::array {
+    qjs::function<[]() { trace::enable(); }>("enable"),
+    qjs::function<trace::isEnabled>("isEnabled"),
+
+    qjs::function<[]() {
+        return static_cast<double>(trace::now());
+    }>("now"),
+
+    // 脚本中的名称在调用结束后会被释放，需要先 intern
+    qjs::function<[](const char* name, double start) {
+        trace::complete(trace::intern(name), "js", static_cast<int64_t>(start));
+    }>("complete"),
+
+    qjs::function<[](const char* name) {
+        trace::instant(trace::intern(name), "js");
+    }>("instant"),
+
+    // 相对于程序所在目录的路径
+    qjs::function<[](const char* path) {
+        return trace::exportJson(win::getBaseDir() / path);
+    }>("save"),
+
+    qjs::function<trace::stats>("stats"),
+};
+
+
+auto addNativeModules(qjs::Context& context) -> void {
+    context.addModule<consoleFunctions>("native:console");
+    context.addModule<winFunctions>("native:win");
+    context.addModule<imageFunctions>("native:image");
+    context.addModule<processFunctions>("native:process");
+    context.addModule<osFunctions>("native:os");
+    context.addModule<eventlogFunctions>("native:eventlog");
+    context.addModule<traceFunctions>("native:trace");
+}
+
+
+auto reportStall(const qjs::StallReport& report) -> void {
+    metrics::addStall();
+    std::string where = report.binding.empty() ? "JS 代码" : "原生函数 " + report.binding;
+    console::error(std::format("事件循环卡顿 {:.0f} ms ({}){}{}", report.durationMs, where, 
+        report.aborted ? ", 已中断" : "", report.stack.empty() ? "" : "\n" + report.stack));
+}
+
+
+// 多目标模式中的一个游戏客户端，使用独立的运行时，脚本通过全局变量 target 获取 pid 和 hwnd
+struct Target {
+    DWORD pid;
+    HWND hwnd;
+    qjs::Runtime runtime;
+    qjs::Context context;
+    uint32_t job = 0;
+
+    // 运行时的内存池只能在执行事件循环的线程上读取，每一帧结束时记录，由主线程汇总
+    std::atomic<double> memoryBytes = 0;
+
+    Target(const std::filesystem::path& baseDir, DWORD pid, HWND hwnd)
+        : pid(pid), hwnd(hwnd), runtime(baseDir), context(runtime.createContext()) {
+        runtime.onStall.push_back(reportStall);
+        addNativeModules(context);
+
+        // 每一帧结束时只清空这个目标的窗口的截图缓存
+        context.onTickEnd.push_back([this, hwnd](double tickMs) {
+            win::invalidateFrameCache(hwnd);
+            console::panel::recordTick(tickMs);
+            eventlog::write(eventlog::Type::Tick, 0, tickMs);
+            metrics::recordTick(tickMs);
+            memoryBytes.store(runtime.memoryBytes(), std::memory_order_relaxed);
+        });
+
+        context.getGlobal().setProperty("target", std::make_tuple(
+            std::make_pair("pid", pid),
+            std::make_pair("hwnd", hwnd)
+        ));
+    }
+};
+
+
+// 监视所有游戏进程，每个进程的窗口出现后为它创建运行时并执行 script.js
+// 所有目标的事件循环在同一个线程池中执行，每 30 秒输出一次吞吐量、每个目标的延迟和输入的等待情况
+auto runTargets(const std::filesystem::path& baseDir) -> void {
+    constexpr auto reportInterval = std::chrono::seconds(30);
+
+    // 线程池需要先于目标销毁，确保销毁目标时没有线程还在执行它的事件循环
+    std::unordered_map<DWORD, std::unique_ptr<Target>> targets;
+    scheduler::Pool pool;
+    process::Watcher watcher({ "YuanShen.exe", "GenshinImpact.exe" });
+    std::vector<DWORD> waiting;     // 已经启动但窗口还没有出现的进程
+    auto lastReport = std::chrono::steady_clock::now();
+
+    console::panel::setState(std::format("{}[Waitting]{} 正在等待原神进程", console::ansi::orange, console::ansi::reset).c_str());
+
+    while(true) {
+        for(const process::Event& event: watcher.scan()) {
+            if(event.appeared) {
+                waiting.push_back(event.pid);
+                continue;
+            }
+
+            std::erase(waiting, event.pid);
+            auto it = targets.find(event.pid);
+            if(it != targets.end()) {
+                pool.remove(it->second->job);
+                targets.erase(it);
+                console::info(std::format("目标 {} 的进程已退出", event.pid));
+            }
+        }
+
+        std::erase_if(waiting, [&](DWORD pid) {
+            HWND hwnd = win::getHwnd(pid);
+            if(!hwnd || std::get<0>(win::getWndSize(hwnd)).second <= 400)
+                return false;
+
+            // 脚本同步执行的部分在主线程中执行，之后的事件循环交给线程池
+            try {
+                auto target = std::make_unique<Target>(baseDir, pid, hwnd);
+                target->context.evalFile("./script.js");
+                target->job = pool.add(std::to_string(pid), [context = &target->context]() { return context->runOnce(); });
+                targets.emplace(pid, std::move(target));
+                console::info(std::format("添加目标 {} (hwnd = {})", pid, static_cast<void*>(hwnd)));
+            }
+            catch(const std::exception& e) {
+                console::error(std::format("目标 {} 的脚本执行失败: {}", pid, e.what()));
+            }
+            return true;
+        });
+
+        // 脚本出错或者事件循环结束的目标不再重新创建
+        std::vector<scheduler::TargetStats> stats = pool.stats();
+        std::erase_if(targets, [&](const auto& entry) {
+            auto it = std::find_if(stats.begin(), stats.end(), [&](const auto& s) { return s.id == entry.second->job; });
+            if(it == stats.end() || !it->finished)
+                return false;
+
+            if(it->error.empty())
+                console::info(std::format("目标 {} 的脚本已结束", entry.first));
+            else console::error(std::format("目标 {} 的脚本出错: {}", entry.first, it->error));
+            pool.remove(entry.second->job);
+            return true;
+        });
+
+        console::panel::setCounter("目标", static_cast<double>(targets.size()));
+
+        double memoryBytes = 0;
+        for(const auto& [pid, target]: targets)
+            memoryBytes += target->memoryBytes.load(std::memory_order_relaxed);
+        metrics::setMemoryBytes(memoryBytes);
+
+        if(std::chrono::steady_clock::now() - lastReport >= reportInterval) {
+            lastReport = std::chrono::steady_clock::now();
+
+            scheduler::InputStats input = scheduler::inputStats();
+            std::string report = std::format("{} 个目标, {:.1f} 帧/秒, 输入 {:.0f} 次 (等待 {:.0f} 次, 最长 {:.1f} ms)", 
+                targets.size(), pool.throughput(), input.inputs, input.waits, input.maxWaitMs);
+
+            for(const scheduler::TargetStats& target: pool.stats()) {
+                report += std::format("\n  {}: {:.0f} 帧, 平均延迟 {:.2f} ms, 最大延迟 {:.2f} ms", target.name, target.steps, 
+                    target.steps > 0 ? target.totalLatencyMs / target.steps : 0, target.maxLatencyMs);
+            }
+
+            console::info(report);
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+
+// 监视程序目录下的脚本，修改后在同一个运行时中新建上下文，加载 script.js 的整个模块图，然后替换旧的上下文
+// 截图缓存和窗口跟踪保留；旧的上下文创建的进程监视器、Calibration、模板等随旧的上下文释放；没有修改的模块直接读取缓存的字节码
+// 新的模块图加载失败 (例如语法错误) 时，旧的上下文继续运行；脚本结束或者出错后等待下一次修改
+auto runWithReload(const std::filesystem::path& baseDir, qjs::Runtime& runtime, const std::function<void(qjs::Context&)>& prepare) -> void {
+    constexpr auto pollInterval = std::chrono::milliseconds(50);
+
+    watch::Watcher watcher(baseDir, ".js");
+    if(!watcher.isValid())
+        console::error("无法监视脚本所在的目录，修改脚本后不会重新加载");
+
+    reload::Slot<qjs::Context> context;
+    std::optional<qjs::Clock::time_point> next;     // 下一次执行事件循环的时间，为空表示等待脚本被修改
+
+    auto reload = [&]() {
+        auto start = std::chrono::steady_clock::now();
+        qjs::ModuleCacheStats before = runtime.moduleCacheStats();
+
+        // 模块保存在新的上下文中，需要先于它销毁
+        std::optional<qjs::Value> module;
+        bool running = context.get() && next;
+        std::optional<std::string> error = context.replace([&]() {
+            std::unique_ptr<qjs::Context> fresh = runtime.newContext();
+            prepare(*fresh);
+
+            // 与多目标模式的 target 相同，新的脚本直接使用已经找到的进程和窗口
+            if(DWORD pid = reloadPid.load()) {
+                fresh->getGlobal().setProperty("reloadTarget", std::make_tuple(
+                    std::make_pair("pid", pid),
+                    std::make_pair("hwnd", reloadHwnd.load())
+                ));
+            }
+
+            module.emplace(fresh->loadModule("./script.js"));
+            return fresh;
+        });
+
+        if(error) {
+            console::error(std::format("加载脚本失败{}: {}", running ? ", 继续运行修改前的脚本" : "", *error));
+            return;
+        }
+
+        // 旧的上下文已经和它的计时器、资源一起销毁，此时没有待执行的 Promise 任务
+        next = std::nullopt;
+
+        try {
+            context.get()->evalModule(*module);
+        }
+        catch(const std::exception& e) {
+            console::error(std::format("脚本执行失败，修改脚本后重新加载: {}", e.what()));
+            return;
+        }
+
+        // 立即执行一次事件循环，结束同步执行的这一帧
+        next = runtime.getClock().now();
+
+        qjs::ModuleCacheStats after = runtime.moduleCacheStats();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        console::info(std::format("加载完成，耗时 {:.1f} ms (编译 {} 个模块，使用缓存 {} 个)", ms, 
+            after.compiled - before.compiled, after.cached - before.cached));
+    };
+
+    reload();
+
+    while(true) {
+        std::vector<std::string> changes = watcher.poll();
+        if(!changes.empty()) {
+            std::string files;
+            for(const std::string& file: changes)
+                files += (files.empty() ? "" : ", ") + (file.empty() ? std::string("(未知)") : file);
+            console::info(std::format("脚本已修改: {}{}{}", console::ansi::blue, files, console::ansi::reset));
+            runtime.invalidateResolveCache();
+            reload();
+            continue;
+        }
+
+        if(!next) {
+            std::this_thread::sleep_for(pollInterval);
+            continue;
+        }
+
+        // 等待计时器到期时也要定期检查脚本是否被修改
+        qjs::Clock& clock = runtime.getClock();
+        if(clock.now() < *next) {
+            trace::Span span("sleep", "loop");
+            clock.sleepUntil(std::min(*next, clock.now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(pollInterval)));
+            continue;
+        }
+
+        try {
+            next = context.get()->runOnce();
+            if(!next)
+                console::info("脚本已结束，修改脚本后重新加载");
+        }
+        catch(const std::exception& e) {
+            next = std::nullopt;
+            console::error(std::format("脚本出错，修改脚本后重新加载: {}", e.what()));
+        }
+    }
+}
@@ -0,0 +1,501 @@
+module;
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+export module metrics;
+
+
+// 平台相关的共享内存
+struct SharedMapping {
+    void* view = nullptr;
+    std::string name {};
+#ifdef _WIN32
+    HANDLE handle = nullptr;
+#endif
+
+    // 共享内存已经存在、并且由另一个还在运行的进程写入时返回 false，上一次运行留下的共享内存直接复用
+    auto create(const char* name, size_t size) -> bool;
+    auto openReadOnly(const char* name, size_t size) -> bool;
+    void close(bool remove);
+};
+
+
+// 共享内存中的运行指标，用于在外部监视程序的运行状态，不需要读取控制台的输出
+// 记录指标时只修改进程内的原子变量；后台线程定时计算帧耗时的百分位数，把所有指标写入共享内存
+// 写入时使用 seqlock: sequence 为奇数表示正在写入，读取前后的 sequence 相同且为偶数时读到的数据是完整的
+// Windows 上为命名的文件映射 (Local\名称)，其它系统上为 POSIX 共享内存 (/名称)
+export namespace metrics {
+    constexpr char magic[4] = { 'G', 'A', 'M', 'T' };
+    constexpr uint32_t version = 1;
+    constexpr char defaultName[] = "GenshinAutoV2.metrics";
+
+    // 计算帧耗时百分位数时使用的最近的帧数
+    constexpr size_t recentTicks = 1024;
+
+    // 共享内存中的数据块，布局固定，新增的字段只能加在末尾，并增加 version
+    struct Block {
+        char magic[4];
+        uint32_t version;
+        uint32_t size;                          // sizeof(Block)
+        uint32_t pid;
+        std::atomic<uint64_t> sequence;
+        std::atomic<int64_t> startTimeMs;       // 距离 1970-01-01 的毫秒数
+        std::atomic<int64_t> updateTimeMs;
+
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint64_t> detections;       // 检测状态变为非 0 的次数，例如进入剧情对话
+        std::atomic<uint64_t> presses;          // 发送的按键
+        std::atomic<uint64_t> inputs;           // 所有输入，包括按键、鼠标和切换前台窗口
+        std::atomic<uint64_t> stalls;           // 看门狗检测到的卡顿
+
+        std::atomic<double> lastTickMs;
+        std::atomic<double> p50TickMs;          // 最近 recentTicks 帧的百分位数
+        std::atomic<double> p90TickMs;
+        std::atomic<double> p99TickMs;
+        std::atomic<double> maxTickMs;          // 启动以来最长的一帧
+        std::atomic<double> memoryBytes;        // quickjs 内存池正在使用的字节数，多目标模式中为所有目标的总和
+    };
+
+    // 读取到的一份完整的数据
+    struct Snapshot {
+        uint32_t pid;
+        int64_t startTimeMs;
+        int64_t updateTimeMs;
+        uint64_t ticks;
+        uint64_t detections;
+        uint64_t presses;
+        uint64_t inputs;
+        uint64_t stalls;
+        double lastTickMs;
+        double p50TickMs;
+        double p90TickMs;
+        double p99TickMs;
+        double maxTickMs;
+        double memoryBytes;
+    };
+
+    // 创建共享内存并启动后台线程，每隔 publishIntervalMs 写入一次
+    // 同名的共享内存正在被另一个进程使用时返回 false
+    auto open(const char* name = defaultName, int publishIntervalMs = 500) -> bool;
+
+    // 写入最后一次，然后删除共享内存
+    void close();
+
+    void recordTick(double ms);
+    void addDetection();
+    void addPress();
+    void addInput();
+    void addStall();
+    void setMemoryBytes(double bytes);
+
+    // 读取其它进程写入的数据
+    class Reader {
+    public:
+        Reader() = default;
+        ~Reader();
+
+        // 共享内存不存在、或者数据块的 magic 和 version 不匹配时返回 false
+        auto open(const char* name = defaultName) -> bool;
+
+        // 写入方正在写入时重试，一直没有读到完整的数据时返回 false
+        auto read(Snapshot& snapshot) -> bool;
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+    private:
+        SharedMapping mapping {};
+        const Block* block = nullptr;
+    };
+}
+
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<double>::is_always_lock_free, "共享内存中的原子变量必须是无锁的");
+static_assert(sizeof(metrics::Block) == 128);
+
+
+auto currentPid() -> uint32_t {
+#ifdef _WIN32
+    return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+
+auto isRunning(uint32_t pid) -> bool {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!process)
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    DWORD exitCode = 0;
+    bool running = GetExitCodeProcess(process, &exitCode) && exitCode == STILL_ACTIVE;
+    CloseHandle(process);
+    return running;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+
+// 已经存在的共享内存是否属于另一个还在运行的进程
+// 同名的两个进程写入同一块共享内存时，读取到的指标会交替来自两个进程
+auto ownedByOther(const void* view) -> bool {
+    uint32_t pid = static_cast<const metrics::Block*>(view)->pid;
+    return pid != 0 && pid != currentPid() && isRunning(pid);
+}
+
+
+#ifdef _WIN32
+
+// 共享内存的名称只包含 ASCII 字符
+auto wideName(const std::string& name) -> std::wstring {
+    return std::wstring(name.begin(), name.end());
+}
+
+
+auto SharedMapping::create(const char* _name, size_t size) -> bool {
+    name = std::string("Local\\") + _name;
+    handle = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), wideName(name).c_str());
+    if (!handle)
+        return false;
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+    view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!view || (existed && ownedByOther(view))) {
+        close(false);
+        return false;
+    }
+    return true;
+}
+
+
+auto SharedMapping::openReadOnly(const char* _name, size_t size) -> bool {
+    name = std::string("Local\\") + _name;
+    handle = OpenFileMappingW(FILE_MAP_READ, FALSE, wideName(name).c_str());
+    if (!handle)
+        return false;
+
+    view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, size);
+    if (!view) {
+        CloseHandle(handle);
+        handle = nullptr;
+        return false;
+    }
+    return true;
+}
+
+
+// 最后一个句柄关闭时系统删除文件映射
+void SharedMapping::close(bool) {
+    if (view)
+        UnmapViewOfFile(view);
+    if (handle)
+        CloseHandle(handle);
+    view = nullptr;
+    handle = nullptr;
+}
+
+#else
+
+auto SharedMapping::create(const char* _name, size_t size) -> bool {
+    name = std::string("/") + _name;
+    bool existed = false;
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        existed = true;
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+    }
+    if (fd < 0)
+        return false;
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || (static_cast<size_t>(info.st_size) < size && ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    // 不是自己创建的共享内存不能删除
+    if (existed && ownedByOther(mapped)) {
+        munmap(mapped, size);
+        return false;
+    }
+
+    view = mapped;
+    return true;
+}
+
+
+auto SharedMapping::openReadOnly(const char* _name, size_t size) -> bool {
+    name = std::string("/") + _name;
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < size) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    view = mapped;
+    return true;
+}
+
+
+// 共享内存不会随进程退出而删除，写入方关闭时需要删除
+void SharedMapping::close(bool remove) {
+    if (!view)
+        return;
+
+    munmap(view, sizeof(metrics::Block));
+    if (remove)
+        shm_unlink(name.c_str());
+    view = nullptr;
+}
+
+#endif
+
+
+auto epochMs() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+// 进程内的指标，记录时只做一次原子操作
+struct Metrics {
+    std::atomic<uint64_t> ticks = 0;
+    std::atomic<uint64_t> detections = 0;
+    std::atomic<uint64_t> presses = 0;
+    std::atomic<uint64_t> inputs = 0;
+    std::atomic<uint64_t> stalls = 0;
+    std::atomic<double> lastTickMs = 0;
+    std::atomic<double> maxTickMs = 0;
+    std::atomic<double> memoryBytes = 0;
+    std::atomic<float> recent[metrics::recentTicks] {};
+
+    // 以下只由后台线程和 open、close 访问
+    SharedMapping mapping {};
+    metrics::Block* block = nullptr;
+
+    std::thread publisher;
+    std::mutex publisherMutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+    std::chrono::milliseconds publishInterval {};
+
+    void publish();
+};
+
+Metrics metricsData;
+
+
+void Metrics::publish() {
+    // 最近的帧耗时，写入和复制之间可能有新的帧，百分位数只是近似值
+    uint64_t count = std::min<uint64_t>(ticks.load(std::memory_order_relaxed), metrics::recentTicks);
+    std::vector<float> samples(count);
+    for (size_t i = 0; i < count; i++)
+        samples[i] = recent[i].load(std::memory_order_relaxed);
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&](double p) -> double {
+        return samples.empty() ? 0 : samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+    };
+
+    uint64_t sequence = block->sequence.load(std::memory_order_relaxed);
+    block->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    block->updateTimeMs.store(epochMs(), std::memory_order_relaxed);
+    block->ticks.store(ticks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    block->detections.store(detections.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    block->presses.store(presses.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    block->inputs.store(inputs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    block->stalls.store(stalls.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    block->lastTickMs.store(lastTickMs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    block->p50TickMs.store(percentile(0.5), std::memory_order_relaxed);
+    block->p90TickMs.store(percentile(0.9), std::memory_order_relaxed);
+    block->p99TickMs.store(percentile(0.99), std::memory_order_relaxed);
+    block->maxTickMs.store(maxTickMs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    block->memoryBytes.store(memoryBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    block->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+auto metrics::open(const char* name, int publishIntervalMs) -> bool {
+    if (metricsData.block)
+        return true;
+
+    if (!metricsData.mapping.create(name, sizeof(Block)))
+        return false;
+
+    // 共享内存可能是上一次运行留下的，重新初始化
+    Block* block = static_cast<Block*>(metricsData.mapping.view);
+    std::memset(static_cast<void*>(block), 0, sizeof(Block));
+    block->version = version;
+    block->size = sizeof(Block);
+    block->pid = currentPid();
+    block->startTimeMs.store(epochMs(), std::memory_order_relaxed);
+
+    // 读取方先检查 magic，magic 最后写入
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(block->magic, magic, sizeof(magic));
+
+    metricsData.block = block;
+    metricsData.publishInterval = std::chrono::milliseconds(std::max(publishIntervalMs, 1));
+    metricsData.stopping = false;
+    metricsData.publish();
+
+    metricsData.publisher = std::thread([]() {
+        std::unique_lock lock(metricsData.publisherMutex);
+        while (!metricsData.stopping) {
+            metricsData.wakeup.wait_for(lock, metricsData.publishInterval);
+            metricsData.publish();
+        }
+    });
+
+    return true;
+}
+
+
+void metrics::close() {
+    if (!metricsData.block)
+        return;
+
+    {
+        std::lock_guard lock(metricsData.publisherMutex);
+        metricsData.stopping = true;
+    }
+    metricsData.wakeup.notify_all();
+    metricsData.publisher.join();
+
+    metricsData.publish();
+    metricsData.block = nullptr;
+    metricsData.mapping.close(true);
+}
+
+
+void metrics::recordTick(double ms) {
+    uint64_t index = metricsData.ticks.fetch_add(1, std::memory_order_relaxed);
+    metricsData.recent[index % recentTicks].store(static_cast<float>(ms), std::memory_order_relaxed);
+    metricsData.lastTickMs.store(ms, std::memory_order_relaxed);
+
+    double max = metricsData.maxTickMs.load(std::memory_order_relaxed);
+    while (ms > max && !metricsData.maxTickMs.compare_exchange_weak(max, ms, std::memory_order_relaxed));
+}
+
+
+void metrics::addDetection() {
+    metricsData.detections.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void metrics::addPress() {
+    metricsData.presses.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void metrics::addInput() {
+    metricsData.inputs.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void metrics::addStall() {
+    metricsData.stalls.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void metrics::setMemoryBytes(double bytes) {
+    metricsData.memoryBytes.store(bytes, std::memory_order_relaxed);
+}
+
+
+metrics::Reader::~Reader() {
+    mapping.close(false);
+}
+
+
+auto metrics::Reader::open(const char* name) -> bool {
+    mapping.close(false);
+    block = nullptr;
+
+    if (!mapping.openReadOnly(name, sizeof(Block)))
+        return false;
+
+    const Block* opened = static_cast<const Block*>(mapping.view);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (std::memcmp(opened->magic, magic, sizeof(magic)) != 0 || opened->version != version || opened->size < sizeof(Block)) {
+        mapping.close(false);
+        return false;
+    }
+
+    block = opened;
+    return true;
+}
+
+
+auto metrics::Reader::read(Snapshot& snapshot) -> bool {
+    if (!block)
+        return false;
+
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint64_t before = block->sequence.load(std::memory_order_acquire);
+        if (before % 2 != 0) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        snapshot.pid = block->pid;
+        snapshot.startTimeMs = block->startTimeMs.load(std::memory_order_relaxed);
+        snapshot.updateTimeMs = block->updateTimeMs.load(std::memory_order_relaxed);
+        snapshot.ticks = block->ticks.load(std::memory_order_relaxed);
+        snapshot.detections = block->detections.load(std::memory_order_relaxed);
+        snapshot.presses = block->presses.load(std::memory_order_relaxed);
+        snapshot.inputs = block->inputs.load(std::memory_order_relaxed);
+        snapshot.stalls = block->stalls.load(std::memory_order_relaxed);
+        snapshot.lastTickMs = block->lastTickMs.load(std::memory_order_relaxed);
+        snapshot.p50TickMs = block->p50TickMs.load(std::memory_order_relaxed);
+        snapshot.p90TickMs = block->p90TickMs.load(std::memory_order_relaxed);
+        snapshot.p99TickMs = block->p99TickMs.load(std::memory_order_relaxed);
+        snapshot.maxTickMs = block->maxTickMs.load(std::memory_order_relaxed);
+        snapshot.memoryBytes = block->memoryBytes.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block->sequence.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,32 @@
+module;
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+export module modulepath;
+
+
+// quickjs 模块加载器中的模块名: 相对于脚本目录规范化，使用 / 分隔
+// 规范化需要访问文件系统 (weakly_canonical)，运行时按 key 缓存结果
+export namespace modulepath {
+    // baseName 为导入者的模块名，模块名相对于导入者所在的目录；baseName 为空时相对于 baseDir
+    auto normalize(const std::filesystem::path& baseDir, std::string_view baseName, std::string_view specifier) -> std::string;
+
+    // 规范化的结果只取决于导入者所在的目录和模块名，用它们作为缓存的键
+    auto key(std::string_view baseName, std::string_view specifier) -> std::string;
+}
+
+
+auto modulepath::normalize(const std::filesystem::path& baseDir, std::string_view baseName, std::string_view specifier) -> std::string {
+    auto fullPath = baseDir / std::filesystem::path(baseName).parent_path() / std::filesystem::path(specifier);
+    return std::filesystem::relative(std::filesystem::weakly_canonical(fullPath), baseDir).generic_string();
+}
+
+
+auto modulepath::key(std::string_view baseName, std::string_view specifier) -> std::string {
+    std::string key = std::filesystem::path(baseName).parent_path().generic_string();
+    key += '\n';
+    key += specifier;
+    return key;
+}
@@ -0,0 +1,323 @@
+module;
+
+#include <string>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
+
+export module panel;
+
+
+// 控制台的状态面板和 ANSI 转义序列，只依赖标准库，输出到任意的 FILE* (控制台、管道或文件)
+// 控制台本身的设置 (编码、字体、窗口大小) 在 console 模块中
+export namespace console {
+    // 当前时间，格式为 [hh:mm:ss]
+    auto timestamp() -> std::string;
+}
+
+
+// 原地刷新的状态面板，显示状态、计数器、帧耗时和最近的事件
+// 各个接口只修改面板的数据，由后台线程以固定的频率渲染，每次只重写发生变化的行，一次性写入控制台
+export namespace console::panel {
+    void start(const std::string& title, short cols, short lines, int refreshMs = 100, FILE* output = stdout);
+
+    // 停止后台线程，渲染最后一次，并把光标移动到面板下方
+    void stop();
+
+    bool isRunning();
+
+    void setState(const char* text);
+
+    void setCounter(const char* name, double value);
+
+    void addCounter(const char* name, double delta);
+
+    void recordTick(double ms);
+
+    void event(const std::string& text);
+
+    // 按显示宽度截断一行文本，跳过 ANSI 转义序列，非 ASCII 字符按两个字符宽度计算，换行和制表符替换为空格
+    auto fitWidth(const std::string& text, int cols) -> std::string;
+
+    // 比较新渲染的每一行 back 和已经输出到控制台的 front，返回只重写变化的行的输出 (光标定位 + 行内容 + 清除行尾)，并更新 front
+    auto diff(std::vector<std::string>& front, std::vector<std::string>& back) -> std::string;
+}
+
+
+export namespace console::ansi {
+    constexpr char bold[] = "\x1b[1m";
+    constexpr char reset[] = "\033[0m";
+    constexpr char cleanLine[] = "\r\033[K";
+    
+    #define rgb(R, G, B) "\x1b[38;2;" #R ";" #G ";" #B "m"
+    constexpr char green[] = rgb(96, 200, 135);
+    constexpr char blue[] = rgb(76, 186, 250);
+    constexpr char orange[] = rgb(241, 149, 88);
+    constexpr char red[] = rgb(247, 101, 104);
+    #undef rgb
+}
+
+
+// 当前时间，格式为 [hh:mm:ss]
+auto console::timestamp() -> std::string {
+    std::time_t now = std::time(nullptr);
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "[%02d:%02d:%02d]", local.tm_hour, local.tm_min, local.tm_sec);
+    return buffer;
+}
+
+
+struct Panel {
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread renderer;
+    std::atomic<bool> running = false;
+    bool dirty = true;
+
+    std::string title;
+    short cols = 0;
+    short lines = 0;
+    std::chrono::milliseconds refreshInterval {};
+    FILE* output = nullptr;
+
+    std::string state;
+    std::vector<std::pair<std::string, double>> counters;
+    std::deque<std::string> events;
+
+    size_t tickCount = 0;
+    double lastTickMs = 0;
+    double averageTickMs = 0;
+    double maxTickMs = 0;
+
+    // 上一次渲染到控制台上的内容
+    std::vector<std::string> front;
+};
+
+Panel panelData;
+
+// 面板顶部固定显示的行数: 标题、状态、帧耗时、计数器、分隔线
+constexpr short headerLines = 5;
+
+
+auto console::panel::fitWidth(const std::string& text, int cols) -> std::string {
+    std::string result;
+    int width = 0;
+
+    for(size_t i = 0; i < text.size(); ) {
+        unsigned char c = text[i];
+
+        if(c == '\x1b') {
+            size_t end = text.find_first_of("ABCDHJKmsu", i + 1);
+            end = (end == std::string::npos) ? text.size() : end + 1;
+            result.append(text, i, end - i);
+            i = end;
+            continue;
+        }
+
+        size_t length = c < 0x80 ? 1 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+        int charWidth = c < 0x80 ? 1 : 2;
+        if(width + charWidth > cols)
+            break;
+
+        if(c == '\n' || c == '\r' || c == '\t')
+            result += ' ';
+        else result.append(text, i, length);
+
+        width += charWidth;
+        i += length;
+    }
+
+    return result + console::ansi::reset;
+}
+
+
+std::string formatNumber(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), value == static_cast<long long>(value) ? "%.0f" : "%.2f", value);
+    return buffer;
+}
+
+
+// 将面板数据渲染为每一行的文本，调用时需要持有锁
+std::vector<std::string> renderPanel(const Panel& panel) {
+    using namespace console::ansi;
+    std::vector<std::string> back;
+
+    back.push_back(std::string(bold) + panel.title + reset);
+    back.push_back(std::string(blue) + "状态" + reset + ": " + panel.state);
+    back.push_back(std::string(blue) + "帧耗时" + reset + ": " + formatNumber(panel.lastTickMs) + " ms  " 
+        + blue + "平均" + reset + ": " + formatNumber(panel.averageTickMs) + " ms  " 
+        + blue + "最大" + reset + ": " + formatNumber(panel.maxTickMs) + " ms  " 
+        + blue + "帧数" + reset + ": " + formatNumber(static_cast<double>(panel.tickCount)));
+
+    std::string counters;
+    for(const auto& [name, value]: panel.counters)
+        counters += std::string(blue) + name + reset + ": " + formatNumber(value) + "  ";
+    back.push_back(counters);
+
+    back.push_back(std::string(panel.cols - 1, '-'));
+
+    for(const std::string& event: panel.events)
+        back.push_back(event);
+
+    back.resize(panel.lines - 1);
+    for(std::string& line: back)
+        line = console::panel::fitWidth(line, panel.cols - 1);
+
+    return back;
+}
+
+
+auto console::panel::diff(std::vector<std::string>& front, std::vector<std::string>& back) -> std::string {
+    std::string output;
+    front.resize(back.size());
+
+    for(size_t i = 0; i < back.size(); i++) {
+        if(back[i] == front[i])
+            continue;
+        output += "\x1b[" + std::to_string(i + 1) + ";1H" + back[i] + "\x1b[K";
+        front[i] = std::move(back[i]);
+    }
+
+    return output;
+}
+
+
+// 与上一次渲染的内容比较，只重写发生变化的行，所有输出合并为一次写入
+void flushPanel(Panel& panel) {
+    std::vector<std::string> back;
+    {
+        std::lock_guard lock(panel.mutex);
+        if(!panel.dirty)
+            return;
+        panel.dirty = false;
+        back = renderPanel(panel);
+    }
+
+    std::string output = console::panel::diff(panel.front, back);
+    if(!output.empty()) {
+        fwrite(output.data(), 1, output.size(), panel.output);
+        fflush(panel.output);
+    }
+}
+
+
+void console::panel::start(const std::string& title, short cols, short lines, int refreshMs, FILE* output) {
+    if(panelData.running)
+        return;
+
+    panelData.title = title;
+    panelData.cols = cols;
+    panelData.lines = std::max<short>(lines, headerLines + 2);
+    panelData.refreshInterval = std::chrono::milliseconds(refreshMs);
+    panelData.output = output;
+    panelData.front.clear();
+    panelData.dirty = true;
+
+    // 清空屏幕
+    fputs("\x1b[2J\x1b[3J\x1b[H", output);
+    fflush(output);
+
+    panelData.running = true;
+    panelData.renderer = std::thread([]() {
+        std::unique_lock lock(panelData.mutex);
+        while(panelData.running) {
+            panelData.wakeup.wait_for(lock, panelData.refreshInterval);
+            lock.unlock();
+            flushPanel(panelData);
+            lock.lock();
+        }
+    });
+}
+
+
+void console::panel::stop() {
+    if(!panelData.running)
+        return;
+
+    {
+        std::lock_guard lock(panelData.mutex);
+        panelData.running = false;
+    }
+    panelData.wakeup.notify_all();
+    panelData.renderer.join();
+
+    flushPanel(panelData);
+    fprintf(panelData.output, "\x1b[%d;1H\n", panelData.lines);
+    fflush(panelData.output);
+}
+
+
+bool console::panel::isRunning() {
+    return panelData.running;
+}
+
+
+void console::panel::setState(const char* text) {
+    std::lock_guard lock(panelData.mutex);
+    panelData.state = text;
+    panelData.dirty = true;
+}
+
+
+void console::panel::setCounter(const char* name, double value) {
+    std::lock_guard lock(panelData.mutex);
+    auto it = std::find_if(panelData.counters.begin(), panelData.counters.end(), [&](const auto& counter) { return counter.first == name; });
+    if(it == panelData.counters.end())
+        panelData.counters.emplace_back(name, value);
+    else it->second = value;
+    panelData.dirty = true;
+}
+
+
+void console::panel::addCounter(const char* name, double delta) {
+    std::lock_guard lock(panelData.mutex);
+    auto it = std::find_if(panelData.counters.begin(), panelData.counters.end(), [&](const auto& counter) { return counter.first == name; });
+    if(it == panelData.counters.end())
+        panelData.counters.emplace_back(name, delta);
+    else it->second += delta;
+    panelData.dirty = true;
+}
+
+
+void console::panel::recordTick(double ms) {
+    std::lock_guard lock(panelData.mutex);
+    panelData.tickCount++;
+    panelData.lastTickMs = ms;
+    panelData.maxTickMs = std::max(panelData.maxTickMs, ms);
+    // 指数移动平均
+    panelData.averageTickMs = panelData.tickCount == 1 ? ms : panelData.averageTickMs * 0.95 + ms * 0.05;
+    panelData.dirty = true;
+}
+
+
+// 多行的文本拆分为多个事件，只保留面板能显示的最近的事件
+void console::panel::event(const std::string& text) {
+    std::string line = console::timestamp() + text;
+
+    std::lock_guard lock(panelData.mutex);
+    for(size_t start = 0; start <= line.size(); ) {
+        size_t end = std::min(line.find('\n', start), line.size());
+        panelData.events.push_back(line.substr(start, end - start));
+        start = end + 1;
+    }
+
+    size_t maxEvents = panelData.lines - headerLines - 1;
+    while(panelData.events.size() > maxEvents)
+        panelData.events.pop_front();
+    panelData.dirty = true;
+}
\ No newline at end of file
@@ -0,0 +1,218 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <tlhelp32.h>
+#else
+    #include <filesystem>
+    #include <fstream>
+#endif
+
+export module process;
+
+
+// 进程监视
+// 每次扫描只枚举一次系统中的所有进程，用哈希集合匹配要监视的进程名，与上一次扫描的结果比较，得到启动和退出的进程
+// 进程的枚举方式可以替换: Windows 下使用 Toolhelp 快照，其它系统读取 /proc
+export namespace process {
+#ifdef _WIN32
+    using NativeString = std::wstring;
+#else
+    using NativeString = std::string;
+#endif
+
+    using NativeStringView = std::basic_string_view<NativeString::value_type>;
+
+    // 枚举系统中的所有进程，对每个进程调用 visit(pid, 进程名)
+    using Enumerator = std::function<void(const std::function<void(uint32_t, NativeStringView)>& visit)>;
+
+    auto systemEnumerator() -> Enumerator;
+
+    struct Event {
+        bool appeared;      // true 为进程启动，false 为进程退出
+        uint32_t pid;
+        std::string name;
+    };
+
+    // 支持用 string_view 直接查找，避免为每个进程名构造字符串
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(NativeStringView name) const { return std::hash<NativeStringView>{}(name); }
+    };
+
+    class Watcher {
+    public:
+        Watcher(const std::vector<std::string>& names, Enumerator enumerator = systemEnumerator());
+
+        // 扫描一次，返回与上一次扫描相比启动和退出的进程
+        auto scan() -> std::vector<Event>;
+
+        // 上一次扫描时正在运行的进程，pid -> 进程名
+        auto running() const -> const std::unordered_map<uint32_t, std::string>& { return processes; }
+
+    private:
+        // 进程名的本地编码 -> 监视时传入的 utf-8 进程名
+        std::unordered_map<NativeString, std::string, NameHash, std::equal_to<>> names {};
+        std::unordered_map<uint32_t, std::string> processes {};
+        Enumerator enumerator;
+    };
+
+    // 以下函数供脚本使用，监视器以编号区分
+    auto createWatcher(std::vector<std::string> names) -> uint32_t;
+
+    void destroyWatcher(uint32_t id);
+
+    // 返回 [{ type: "appear" | "exit", pid, name }, ...]
+    auto scanWatcher(uint32_t id);
+}
+
+
+auto toNativeString(const std::string& text) -> process::NativeString {
+#ifdef _WIN32
+    int length = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, nullptr, 0);
+    std::wstring result(length > 0 ? length - 1 : 0, L'\0');
+    if (length > 1)
+        MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, result.data(), length);
+    return result;
+#else
+    return text;
+#endif
+}
+
+
+auto process::systemEnumerator() -> Enumerator {
+#ifdef _WIN32
+    return [](const std::function<void(uint32_t, NativeStringView)>& visit) {
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE)
+            return;
+
+        PROCESSENTRY32W pe;
+        pe.dwSize = sizeof(PROCESSENTRY32W);
+
+        for (BOOL ok = Process32FirstW(snapshot, &pe); ok; ok = Process32NextW(snapshot, &pe))
+            visit(pe.th32ProcessID, pe.szExeFile);
+
+        CloseHandle(snapshot);
+    };
+#else
+    return [](const std::function<void(uint32_t, NativeStringView)>& visit) {
+        std::error_code ec;
+        for (const auto& entry: std::filesystem::directory_iterator("/proc", ec)) {
+            const std::string dirName = entry.path().filename().string();
+            if (dirName.empty() || dirName.find_first_not_of("0123456789") != std::string::npos)
+                continue;
+
+            // comm 中的进程名最多 15 个字符，被截断时从命令行中取可执行文件名
+            std::string name;
+            std::ifstream comm(entry.path() / "comm");
+            if (!std::getline(comm, name))
+                continue;
+
+            if (name.size() >= 15) {
+                std::string argv0;
+                std::ifstream cmdline(entry.path() / "cmdline", std::ios::binary);
+                if (std::getline(cmdline, argv0, '\0') && !argv0.empty())
+                    name = argv0.substr(argv0.find_last_of("/\\") + 1);
+            }
+
+            visit(static_cast<uint32_t>(std::stoul(dirName)), name);
+        }
+    };
+#endif
+}
+
+
+process::Watcher::Watcher(const std::vector<std::string>& names, Enumerator enumerator)
+    : enumerator(std::move(enumerator)) {
+    for (const std::string& name: names)
+        this->names.emplace(toNativeString(name), name);
+}
+
+
+auto process::Watcher::scan() -> std::vector<Event> {
+    std::unordered_map<uint32_t, std::string> current;
+
+    // 只有名字匹配的进程才会被记录，其它进程只做一次哈希查找
+    enumerator([&](uint32_t pid, NativeStringView name) {
+        auto it = names.find(name);
+        if (it != names.end())
+            current.emplace(pid, it->second);
+    });
+
+    std::vector<Event> events;
+
+    for (const auto& [pid, name]: current) {
+        if (!processes.contains(pid))
+            events.push_back({ true, pid, name });
+    }
+
+    for (const auto& [pid, name]: processes) {
+        if (!current.contains(pid))
+            events.push_back({ false, pid, name });
+    }
+
+    processes = std::move(current);
+    return events;
+}
+
+
+// 多目标模式下不同的线程会同时访问
+struct WatcherRegistry {
+    std::mutex mutex;
+    std::unordered_map<uint32_t, std::unique_ptr<process::Watcher>> watchers {};
+    uint32_t nextId = 1;
+};
+
+WatcherRegistry watcherRegistry;
+
+
+auto process::createWatcher(std::vector<std::string> names) -> uint32_t {
+    std::lock_guard lock(watcherRegistry.mutex);
+    uint32_t id = watcherRegistry.nextId++;
+    watcherRegistry.watchers.emplace(id, std::make_unique<Watcher>(names));
+    return id;
+}
+
+
+void process::destroyWatcher(uint32_t id) {
+    std::lock_guard lock(watcherRegistry.mutex);
+    watcherRegistry.watchers.erase(id);
+}
+
+
+auto process::scanWatcher(uint32_t id) {
+    using EventObject = std::tuple<
+        std::pair<const char*, const char*>,
+        std::pair<const char*, uint32_t>,
+        std::pair<const char*, std::string>
+    >;
+
+    std::vector<EventObject> result;
+
+    std::lock_guard lock(watcherRegistry.mutex);
+    auto it = watcherRegistry.watchers.find(id);
+    if (it == watcherRegistry.watchers.end())
+        return result;
+
+    for (Event& event: it->second->scan()) {
+        result.emplace_back(
+            std::make_pair("type", event.appeared ? "appear" : "exit"),
+            std::make_pair("pid", event.pid),
+            std::make_pair("name", std::move(event.name))
+        );
+    }
+
+    return result;
+}
@@ -9,31 +9,101 @@ module;
 #include <queue>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <array>
+#include <memory>
+#include <optional>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
 #include <quickjs/quickjs.h>
 #include <quickjs/quickjs-libc.h>
 #include <windows.h>
 
 export module quickjs;
 
+import allocator;
+import frame;
+import trace;
+import modulepath;
+import watchdog;
+import timer;
+import reload;
+
 export namespace qjs {
     class Runtime;
     class Context;
     class Shared_Value;
     class Value;
+
+    // 在编译期生成 quickjs 的函数表项，用于注册原生模块
+    template <auto Func>
+    constexpr JSCFunctionListEntry function(const char* name);
+
+    // 一帧的执行时间超过看门狗的预算时生成的报告
+    using StallReport = watchdog::StallReport;
+
+    // 加载模块时编译的次数和直接使用缓存的字节码的次数
+    struct ModuleCacheStats {
+        size_t compiled = 0;
+        size_t cached = 0;
+    };
+
+    // 事件循环使用的时钟，计时器、sleep 和 Date.now 都从这里取时间
+    using Clock = timer::Clock;
+    using SystemClock = timer::SystemClock;
+    using VirtualClock = timer::VirtualClock;
+
+    // 同步等待，使用虚拟时钟时只推进时间；native:runtime 和 native:os 中的 sleep
+    void sleep(JSContext* ctx, double ms);
+
+    // 调用者所在运行时的内存池的统计信息；native:os 中的 allocatorStats
+    auto allocatorStats(JSContext* ctx);
 }
 
 struct Utilities { 
-    // 计时器数据类型，用于实现setTimeout
-    struct TimeoutTimer {
-        unsigned int id;
-        std::chrono::steady_clock::time_point timeout;
+    // 计时器的回调，用于实现setTimeout
+    struct TimeoutCallback {
         JSValue func;
-
-        bool operator < (const TimeoutTimer& other) const { return timeout > other.timeout; } 
+        JSContext* ctx;     // 添加计时器的上下文，上下文销毁时一起释放
     };
 
     static JSValue setTimeout(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst *argv);
 
+    // 替换全局的 Date.now，使用运行时的时钟
+    static JSValue dateNow(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+    // GC 耗时的直方图，每个桶的上界单位为毫秒，最后一个桶记录超过 100ms 的 GC
+    struct GCStats {
+        static constexpr std::array<double, 11> bucketsMs = { 0.05, 0.1, 0.25, 0.5, 1, 2, 5, 10, 20, 50, 100 };
+        std::array<double, bucketsMs.size() + 1> counts {};
+        double count = 0;
+        double totalMs = 0;
+        double maxMs = 0;
+
+        void record(double ms);
+    };
+
+    // 事件循环的看门狗，记录的原生函数为 call<Func> 的函数指针
+    using Watchdog = watchdog::Watchdog<JSCFunction*>;
+
+    static int interruptHandler(JSRuntime* rt, void* opaque);
+
+    // 原生模块 native:runtime 中的函数，用于查看和调整 quickjs 的内存和 GC
+    static auto memoryUsage(JSContext* ctx);
+    static void setGCThreshold(JSContext* ctx, double bytes);
+    static void setMemoryLimit(JSContext* ctx, double bytes);
+    static double collectGarbage(JSContext* ctx);
+    static auto gcStats(JSContext* ctx);
+    static void setWatchdog(JSContext* ctx, double budgetMs, bool abortOnStall);
+    static auto watchdogStats(JSContext* ctx);
+
     // 将 JS列表 转换为 std::tuple
     template <typename Tuple, std::size_t... I>
     static Tuple jsList_to_tuple(JSContext* ctx, const JSValue& val, std::index_sequence<I...>);
@@ -54,6 +124,14 @@ struct Utilities {
     template <auto Func, size_t... I>
     static JSValue call_with_js_args(JSContext* ctx, JSValueConst* argv, std::index_sequence<I...>);
 
+    // 将 C/C++ 函数封装为 quickjs 可以调用的 JSCFunction
+    template <auto Func>
+    static JSValue call(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv);
+
+    // 函数表中的函数名，用作追踪中的事件名称；不在函数表中的函数返回 "binding"
+    template <auto Func>
+    static const char* bindingName(JSContext* ctx);
+
 
     // 通过模板获取函数的参数和返回值类型
     template <typename T>
@@ -65,6 +143,10 @@ struct Utilities {
         using args_tuple = std::tuple<Args...>;
         using args_count = std::tuple_size<args_tuple>;
 
+        // 第一个参数为 JSContext* 时，调用时自动传入当前的 JSContext，不占用 JS 参数
+        static constexpr size_t context_count = std::is_same_v<std::tuple_element_t<0, std::tuple<Args..., void>>, JSContext*> ? 1 : 0;
+        using js_args_count = std::integral_constant<size_t, sizeof...(Args) - context_count>;
+
         template <size_t i>
         using arg_type = std::tuple_element_t<i, args_tuple>;
     };
@@ -91,6 +173,12 @@ struct Utilities {
 
     template <typename FirstElement, typename... Rest>
     struct is_key_values_tuple<std::tuple<FirstElement, Rest...>> : is_key_value_pair<FirstElement> {};
+
+    template <typename T>
+    struct is_vector : std::false_type {};
+
+    template <typename T>
+    struct is_vector<std::vector<T>> : std::true_type {};
 };
 
 
@@ -155,21 +243,74 @@ class qjs::Context {
 private:
     JSContext* ctx;
 
+    // 按内容比较的字符串哈希，用 string_view 查找时不需要构造 std::string
+    struct AtomNameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    // 缓存属性名对应的 JSAtom，避免每次构造对象时重新查找属性名
+    // 以属性名的内容为键，内容相同但地址不同的字符串 (不同编译单元中的字面量、运行时拼接的名字) 共用一个 JSAtom
+    std::unordered_map<std::string, JSAtom, AtomNameHash, std::equal_to<>> atoms {};
+
     Context(JSRuntime* rt);
+
+    JSAtom getAtom(const char* name);
+
+    void addRuntimeModule();
+
+    Value compileModule(const std::filesystem::path& fullPath, const std::string& name);
+
+    // 脚本通过原生函数创建的资源，上下文销毁时用对应的释放函数释放
+    reload::Resources resources {};
+
+    // 事件循环的状态，在多次 runOnce 之间保留
+    bool looping = false;
+    bool ticked = false;
+    std::chrono::steady_clock::time_point tickStart {};
 public:
     std::vector<std::function<void(const char*)>> onJsFileLoaded {};
 
+    // 每一帧结束时调用，一帧指一次计时器回调以及它引起的所有 Promise 任务，参数为这一帧的耗时 (ms)
+    std::vector<std::function<void(double)>> onTickEnd {};
+
     Value eval(const std::string& input, const std::string& filename="<eval>", int evalFlags=JS_EVAL_TYPE_GLOBAL);
 
     Value evalFile(std::filesystem::path filePath, int evalFlags=JS_EVAL_TYPE_MODULE);
 
+    // 编译模块并加载它导入的所有模块，不执行任何代码，有语法错误或者找不到模块时抛出异常
+    Value loadModule(std::filesystem::path filePath);
+
+    // 执行 loadModule 返回的模块，返回模块执行完成的 Promise
+    Value evalModule(const Value& module);
+
+    // 执行事件循环直到没有计时器
     void loop();
 
+    // 执行一次事件循环: 所有待执行的 Promise 任务，以及最多一个到期的计时器
+    // 返回下一个计时器的到期时间，没有计时器时返回 std::nullopt，表示事件循环已经结束
+    // 可以在不同的线程上调用，但同一时间只能在一个线程上执行
+    auto runOnce() -> std::optional<Clock::time_point>;
+
+    // 将编译期生成的函数表注册为原生模块，例如 import { getPixel } from "native:win"
+    template <const auto& Functions>
+    void addModule(const char* name);
+
     Value getGlobal() { return Value(ctx, JS_GetGlobalObject(ctx)); }
 
     std::string getException();
 
-    ~Context() { JS_FreeContext(ctx); }
+    // 原生函数中获取调用者所在的上下文
+    static auto of(JSContext* ctx) -> Context& { return *reinterpret_cast<Context*>(JS_GetContextOpaque(ctx)); }
+
+    // 记录脚本创建的原生资源 (进程监视器、Calibration、模板等)，上下文销毁时调用 release(id)
+    // 热重载时旧的上下文被替换，脚本来不及释放的资源不会泄漏
+    void own(reload::Resources::Release release, uint32_t id) { resources.own(release, id); }
+
+    // 脚本主动释放资源时调用，之后上下文销毁时不再释放
+    void release(reload::Resources::Release release, uint32_t id) { resources.release(release, id); }
+
+    ~Context();
     
     Context(const Context&) = delete;
     Context& operator=(const Context&) = delete;
@@ -184,18 +325,73 @@ friend Utilities;
 
 class qjs::Runtime {
 private: 
+    // 这个运行时专用的内存池，不使用内存池时为空；需要在 runtime 之后销毁
+    std::unique_ptr<allocator::Pool> pool;
     JSRuntime* runtime;
     std::filesystem::path baseDir;
-    std::priority_queue<Utilities::TimeoutTimer> timers {};
-    unsigned int nextTimerId = 0;
+    timer::Queue<Utilities::TimeoutCallback> timers {};
+    Utilities::GCStats gcStats {};
+    Utilities::Watchdog watchdog {};
+
+    // 中断回调要求 quickjs 中断当前的任务之后为 true，直到事件循环取出中断产生的异常
+    bool interrupted = false;
+
+    // 使用内存池时关闭 quickjs 在分配内存时触发的自动 GC，改为在每一帧结束时检查内存池的使用量，这样每次 GC 都能计时
+    // 与 quickjs 相同，初始阈值为 256KB，每次自动 GC 之后阈值变为剩余内存的 1.5 倍；SIZE_MAX 表示关闭自动 GC
+    size_t gcThreshold = 256 * 1024;
+
+    // 执行一次 GC 并把耗时记录到 gcStats 中
+    auto runGC() -> double;
+    std::unique_ptr<Clock> clock = std::make_unique<SystemClock>();
+
+    // 正在执行事件循环的 JSContext，中断回调中用它获取调用栈
+    JSContext* activeContext = nullptr;
+
+    // 函数表中的函数 -> 函数名，用于在看门狗的报告中显示正在执行的原生函数
+    std::unordered_map<JSCFunction*, const char*> bindingNames {};
+
+    // 相对路径 -> 编译后的字节码，文件的修改时间和大小都没有变化时直接读取字节码，不需要重新解析
+    reload::Cache<std::vector<uint8_t>> moduleCache {};
+    ModuleCacheStats moduleStats {};
+
+    // (导入者所在的目录, 模块名) -> 规范化的模块名，避免每次导入都访问文件系统
+    std::unordered_map<std::string, std::string> resolveCache {};
+
+    auto resolve(std::string_view baseName, std::string_view specifier) -> const std::string&;
 
 public: 
-    Runtime(std::filesystem::path _baseDir);
+    // 看门狗检测到卡顿时，在这一帧结束后调用
+    std::vector<std::function<void(const StallReport&)>> onStall {};
+
+    // usePoolAllocator 为 false 时使用 quickjs 默认的 malloc
+    Runtime(std::filesystem::path _baseDir, bool usePoolAllocator = true);
 
     Runtime(): Runtime(std::filesystem::current_path()) {};
 
     Context createContext() { return Context(runtime); }
 
+    // 在堆上创建上下文，用于热重载时替换上下文
+    auto newContext() -> std::unique_ptr<Context> { return std::unique_ptr<Context>(new Context(runtime)); }
+
+    auto moduleCacheStats() const -> ModuleCacheStats { return moduleStats; }
+
+    // 脚本目录中的文件被修改时调用，新建或者删除的文件可能改变模块名的解析结果
+    void invalidateResolveCache() { resolveCache.clear(); }
+
+    // 替换事件循环使用的时钟，需要在执行脚本之前调用
+    void setClock(std::unique_ptr<Clock> newClock) { clock = std::move(newClock); }
+
+    auto getClock() -> Clock& { return *clock; }
+
+    // 内存池中正在使用的字节数，不使用内存池时为 0
+    auto memoryBytes() const -> double { return pool ? static_cast<double>(pool->liveBytes()) : 0; }
+
+    // 内存池的统计信息，不使用内存池时返回空的统计信息
+    auto allocatorStats() const {
+        static const allocator::Pool empty;
+        return pool ? pool->stats() : empty.stats();
+    }
+
     ~Runtime() { JS_FreeRuntime(runtime); }
     
     Runtime(const Runtime&) = delete;
@@ -209,18 +405,83 @@ friend Context;
 
 
 
-qjs::Runtime::Runtime(std::filesystem::path _baseDir): runtime(JS_NewRuntime()), baseDir(_baseDir) {
+// 使用内存池为 quickjs 分配内存，同时按照 quickjs 默认实现的方式维护 JSMallocState 中的统计和内存上限
+// JSMallocState 的 opaque 为运行时的内存池
+constexpr size_t mallocOverhead = allocator::headerSize;
+
+auto poolOf(JSMallocState* s) -> allocator::Pool& {
+    return *static_cast<allocator::Pool*>(s->opaque);
+}
+
+constexpr JSMallocFunctions poolMallocFunctions = {
+    [](JSMallocState* s, size_t size) -> void* {
+        if (s->malloc_size + size > s->malloc_limit)
+            return nullptr;
+
+        void* ptr = poolOf(s).allocate(size);
+        if (!ptr)
+            return nullptr;
+
+        s->malloc_count++;
+        s->malloc_size += allocator::usableSize(ptr) + mallocOverhead;
+        return ptr;
+    },
+
+    [](JSMallocState* s, void* ptr) {
+        if (!ptr)
+            return;
+
+        s->malloc_count--;
+        s->malloc_size -= allocator::usableSize(ptr) + mallocOverhead;
+        poolOf(s).deallocate(ptr);
+    },
+
+    [](JSMallocState* s, void* ptr, size_t size) -> void* {
+        if (!ptr)
+            return size == 0 ? nullptr : poolMallocFunctions.js_malloc(s, size);
+
+        size_t oldSize = allocator::usableSize(ptr);
+        if (size == 0) {
+            poolMallocFunctions.js_free(s, ptr);
+            return nullptr;
+        }
+
+        if (s->malloc_size + size - oldSize > s->malloc_limit)
+            return nullptr;
+
+        ptr = poolOf(s).reallocate(ptr, size);
+        if (!ptr)
+            return nullptr;
+
+        s->malloc_size += allocator::usableSize(ptr) - oldSize;
+        return ptr;
+    },
+
+    allocator::usableSize
+};
+
+
+qjs::Runtime::Runtime(std::filesystem::path _baseDir, bool usePoolAllocator): 
+    pool(usePoolAllocator ? std::make_unique<allocator::Pool>() : nullptr),
+    runtime(pool ? JS_NewRuntime2(&poolMallocFunctions, pool.get()) : JS_NewRuntime()), baseDir(_baseDir) {
     if(!runtime) 
         throw std::runtime_error("Failed to create Quickjs Runtime.");
     JS_SetRuntimeOpaque(runtime, this);
+    JS_SetInterruptHandler(runtime, Utilities::interruptHandler, this);
+
+    // 不使用内存池时无法低成本地获取内存使用量，保留 quickjs 的自动 GC (不计时)
+    if(pool)
+        JS_SetGCThreshold(runtime, SIZE_MAX);
 
     JS_SetModuleLoaderFunc2(runtime, 
         [](JSContext* ctx, const char* module_base_name, const char* module_name, void* opaque){
             Runtime* rt = reinterpret_cast<Runtime*>(opaque);
 
-            auto fullPath = rt->baseDir / std::filesystem::path(module_base_name).parent_path() / module_name;
-            auto relativePath = std::filesystem::relative(std::filesystem::weakly_canonical(fullPath), rt->baseDir);
-            auto szRelativePath = relativePath.generic_string();
+            // 原生模块直接使用注册时的名称
+            std::string szRelativePath = module_name;
+
+            if(!std::string_view(module_name).starts_with("native:"))
+                szRelativePath = rt->resolve(module_base_name, module_name);
 
             char* normalizedPath = reinterpret_cast<char*>(js_malloc(ctx,  szRelativePath.size() + 1));
             memcpy(normalizedPath, szRelativePath.c_str(), szRelativePath.size());
@@ -239,11 +500,84 @@ qjs::Runtime::Runtime(std::filesystem::path _baseDir): runtime(JS_NewRuntime()),
 }
 
 
+// 同一个目录中的模块导入同一个模块时结果相同，只有第一次需要规范化路径
+// 预读期间后台线程通常已经规范化过，直接使用它的结果
+auto qjs::Runtime::runGC() -> double {
+    trace::Span span("gc", "loop");
+    auto startTime = std::chrono::steady_clock::now();
+    JS_RunGC(runtime);
+
+    // GC 释放的对象集中在一起，这时把完全空闲的内存页还给系统，长时间运行时常驻内存不会一直停留在峰值
+    if(pool)
+        pool->trim();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    gcStats.record(ms);
+    return ms;
+}
+
+
+auto qjs::Runtime::resolve(std::string_view baseName, std::string_view specifier) -> const std::string& {
+    std::string key = modulepath::key(baseName, specifier);
+
+    auto it = resolveCache.find(key);
+    if(it != resolveCache.end())
+        return it->second;
+
+    std::string name = modulepath::normalize(baseDir, baseName, specifier);
+
+    // 规范化的模块名再次规范化时结果不变，evalFile 中规范化模块名时直接命中
+    resolveCache.try_emplace(modulepath::key("", name), name);
+    return resolveCache.emplace(std::move(key), std::move(name)).first->second;
+}
+
+
 qjs::Context::Context(JSRuntime* rt): ctx(JS_NewContext(rt)) {
     if(!ctx) 
         throw std::runtime_error("Failed to create Quickjs Context.");
     JS_SetContextOpaque(ctx, this);
     getGlobal().setProperty("setTimeout", JS_NewCFunction(ctx, Utilities::setTimeout, "setTimeout", 2));
+
+    // new Date() 仍然使用真实时间，需要当前时间的脚本应该使用 Date.now
+    JSValue date = JS_GetPropertyStr(ctx, getGlobal().value, "Date");
+    JS_SetPropertyStr(ctx, date, "now", JS_NewCFunction(ctx, Utilities::dateNow, "now", 0));
+    JS_FreeValue(ctx, date);
+    addRuntimeModule();
+}
+
+
+qjs::Context::~Context() {
+    JSRuntime* _rt = JS_GetRuntime(ctx);
+    Runtime* rt = reinterpret_cast<Runtime*>(JS_GetRuntimeOpaque(_rt));
+
+    // 运行时在热重载后继续使用，释放这个上下文添加的计时器
+    rt->timers.removeIf([&](const Utilities::TimeoutCallback& callback) {
+        if(callback.ctx != ctx)
+            return false;
+        JS_FreeValue(ctx, callback.func);
+        return true;
+    });
+
+    resources.releaseAll();
+
+    for(const auto& [name, atom]: atoms)
+        JS_FreeAtom(ctx, atom);
+    JS_FreeContext(ctx);
+
+    // 上下文中的对象之间通常有循环引用，立即回收，不等到下一次自动 GC
+    rt->runGC();
+}
+
+
+JSAtom qjs::Context::getAtom(const char* name) {
+    std::string_view key(name);
+    auto it = atoms.find(key);
+    if(it != atoms.end())
+        return it->second;
+
+    JSAtom atom = JS_NewAtomLen(ctx, key.data(), key.size());
+    atoms.emplace(key, atom);
+    return atom;
 }
 
 
@@ -278,13 +612,22 @@ qjs::Value qjs::Context::evalFile(std::filesystem::path filePath, int evalFlags)
     JSRuntime* _rt = JS_GetRuntime(ctx);
     qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(_rt));
 
-    auto fullPath = rt->baseDir / filePath;
-    filePath = std::filesystem::relative(std::filesystem::weakly_canonical(fullPath), rt->baseDir);
-    std::string szFilePath = filePath.generic_string();
+    // 入口模块先加载整个模块图再执行
+    if((evalFlags & JS_EVAL_TYPE_MASK) == JS_EVAL_TYPE_MODULE && !(evalFlags & JS_EVAL_FLAG_COMPILE_ONLY)) {
+        Value module = loadModule(filePath);
+        return evalModule(module);
+    }
+
+    std::string szFilePath = rt->resolve("", filePath.generic_string());
+    auto fullPath = rt->baseDir / szFilePath;
+    trace::Span span(trace::isEnabled() ? trace::intern(szFilePath) : nullptr, "module");
 
     for(const auto& callback: onJsFileLoaded)
         callback(szFilePath.c_str());
 
+    if((evalFlags & JS_EVAL_TYPE_MASK) == JS_EVAL_TYPE_MODULE)
+        return compileModule(fullPath, szFilePath);
+
     std::ifstream file(fullPath, std::ios::binary);
     if(!file.is_open())
         throw std::runtime_error(("Faild to Open file '" + szFilePath + '\''));
@@ -295,38 +638,203 @@ qjs::Value qjs::Context::evalFile(std::filesystem::path filePath, int evalFlags)
 }
 
 
+// 先读取文件的修改时间和大小再读取内容，读取期间文件被修改时，下次加载会因为修改时间不同而重新编译
+qjs::Value qjs::Context::compileModule(const std::filesystem::path& fullPath, const std::string& name) {
+    Runtime* rt = reinterpret_cast<Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+
+    // 无法读取修改时间和大小的文件不缓存
+    std::optional<reload::Stamp> stamp = reload::stamp(fullPath);
+
+    if(const std::vector<uint8_t>* bytecode = stamp ? rt->moduleCache.find(name, *stamp) : nullptr) {
+        Value module(ctx, JS_ReadObject(ctx, bytecode->data(), bytecode->size(), JS_READ_OBJ_BYTECODE));
+        if(!JS_IsException(module.value)) {
+            rt->moduleStats.cached++;
+            return module;
+        }
+
+        // 字节码无法读取时重新编译
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+
+    std::ifstream file(fullPath, std::ios::binary);
+    if(!file.is_open())
+        throw std::runtime_error(("Faild to Open file '" + name + '\''));
+
+    std::string jsCode((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    Value module = eval(jsCode, name, JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_COMPILE_ONLY);
+    rt->moduleStats.compiled++;
+
+    if(stamp) {
+        size_t length = 0;
+        uint8_t* bytecode = JS_WriteObject(ctx, &length, module.value, JS_WRITE_OBJ_BYTECODE);
+        if(bytecode) {
+            rt->moduleCache.store(name, *stamp, std::vector<uint8_t>(bytecode, bytecode + length));
+            js_free(ctx, bytecode);
+        }
+        else JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+
+    return module;
+}
+
+
+qjs::Value qjs::Context::loadModule(std::filesystem::path filePath) {
+    Value module = evalFile(filePath, JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_COMPILE_ONLY);
+    if(JS_ResolveModule(ctx, module.value) < 0)
+        throw std::runtime_error(this->getException());
+    return module;
+}
+
+
+qjs::Value qjs::Context::evalModule(const Value& module) {
+    if(JS_ResolveModule(ctx, module.value) < 0)
+        throw std::runtime_error(this->getException());
+
+    // JS_EvalFunction 会释放传入的值
+    Value result(ctx, JS_EvalFunction(ctx, JS_DupValue(ctx, module.value)));
+    if(JS_IsException(result.value))
+        throw std::runtime_error(this->getException());
+
+    return result;
+}
+
+
 void qjs::Context::loop() {
+    Runtime* rt = reinterpret_cast<Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+
+    while(auto next = runOnce()) {
+        trace::Span span("sleep", "loop");
+        rt->clock->sleepUntil(*next);
+    }
+}
+
+
+auto qjs::Context::runOnce() -> std::optional<Clock::time_point> {
     JSRuntime* _rt = JS_GetRuntime(ctx);
     Runtime* rt = reinterpret_cast<Runtime*>(JS_GetRuntimeOpaque(_rt));
-    
-    while(true) {
+    rt->activeContext = ctx;
+
+    // quickjs 按线程的栈顶检查栈溢出，换到其它线程执行时需要更新
+    JS_UpdateStackTop(_rt);
+
+    // evalFile 中同步执行的部分也算作一帧
+    if(!looping) {
+        looping = true;
+        ticked = true;
+        tickStart = std::chrono::steady_clock::now();
+        rt->watchdog.beginTick();
+    }
+
+    // 被看门狗中断的任务直接丢弃，其它异常结束事件循环
+    // 中断产生的错误不能被脚本捕获，一定是中断之后取出的第一个异常；同一帧中的其它异常不能因为这一帧被中断过而被丢弃
+    auto checkException = [&]() {
+        if(rt->interrupted) {
+            rt->interrupted = false;
+            JS_FreeValue(ctx, JS_GetException(ctx));
+            return;
+        }
+        throw std::runtime_error(this->getException());
+    };
+
+    // 执行所有待执行的任务，然后结束这一帧
+    auto finishTick = [&]() {
+        int64_t jobsStart = trace::isEnabled() ? trace::now() : -1;
+        bool executed = false;
+
         while(true) {
             int err = JS_ExecutePendingJob(_rt, NULL);
             if(err <= 0) {
                 if(err < 0)
-                    throw std::runtime_error(this->getException());
-                break;
+                    checkException();
+                else break;
             }
+            executed = true;
         }
 
-        if(rt->timers.size() == 0)
-            break;
+        // 没有待执行的任务时不记录，避免每次 runOnce 都产生一个空的事件
+        if(executed && jobsStart >= 0)
+            trace::complete("jobs", "loop", jobsStart);
 
-        auto nowTime = std::chrono::steady_clock::now();
-        auto& topTimer = rt->timers.top();
+        if(!ticked)
+            return;
 
-        if(nowTime >= topTimer.timeout) {
-            Value ret(ctx, JS_Call(ctx, topTimer.func, JS_UNDEFINED, 0, NULL));
+        ticked = false;
 
-            if (JS_IsException(ret.value))
-                throw std::runtime_error(this->getException());
-            
-            JS_FreeValue(ctx, topTimer.func);
-            rt->timers.pop();
-        } else {
-            std::this_thread::sleep_for(topTimer.timeout - nowTime);
+        // 代替 quickjs 的自动 GC，GC 的耗时算在这一帧中
+        if(rt->pool && rt->pool->liveBytes() > rt->gcThreshold) {
+            rt->runGC();
+            size_t live = rt->pool->liveBytes();
+            rt->gcThreshold = live + live / 2;
+        }
+
+        double tickMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tickStart).count();
+
+        StallReport report;
+        JSCFunction* binding = rt->watchdog.stalledBinding.load(std::memory_order_relaxed);
+        if(rt->watchdog.endTick(tickMs, report)) {
+            auto it = rt->bindingNames.find(binding);
+            report.binding = binding && it != rt->bindingNames.end() ? it->second : "";
+            rt->watchdog.lastStall = report;
+            for(const auto& callback: rt->onStall)
+                callback(report);
         }
+
+        for(const auto& callback: onTickEnd)
+            callback(tickMs);
+    };
+
+    finishTick();
+
+    // 回调中可能会添加新的计时器，所以先从队列中取出
+    if(auto timer = rt->timers.popDue(rt->clock->now())) {
+        tickStart = std::chrono::steady_clock::now();
+        rt->watchdog.beginTick();
+        rt->interrupted = false;
+
+        int64_t timerStart = trace::isEnabled() ? trace::now() : -1;
+        Value ret(ctx, JS_Call(ctx, timer->value.func, JS_UNDEFINED, 0, NULL));
+        JS_FreeValue(ctx, timer->value.func);
+        if(timerStart >= 0)
+            trace::complete("timer", "loop", timerStart);
+        ticked = true;
+
+        if (JS_IsException(ret.value))
+            checkException();
+
+        finishTick();
     }
+
+    rt->activeContext = nullptr;
+
+    if(rt->timers.empty())
+        return std::nullopt;
+    return rt->timers.nextTimeout();
+}
+
+
+// quickjs 执行 JS 代码时定期调用，返回非 0 值时中断当前的任务
+int Utilities::interruptHandler(JSRuntime* _rt, void* opaque) {
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(opaque);
+    Watchdog& watchdog = rt->watchdog;
+
+    watchdog::Interrupt action = watchdog.interrupt();
+    if(action == watchdog::Interrupt::None)
+        return 0;
+
+    // 新建一个 Error 对象来获取当前的调用栈
+    if(JSContext* ctx = rt->activeContext) {
+        JSValue error = JS_NewError(ctx);
+        JSValue stack = JS_GetPropertyStr(ctx, error, "stack");
+        watchdog.stack = convert_from_js<std::string>(ctx, stack);
+        JS_FreeValue(ctx, stack);
+        JS_FreeValue(ctx, error);
+    }
+
+    if(action != watchdog::Interrupt::Abort)
+        return 0;
+    rt->interrupted = true;
+    return 1;
 }
 
 
@@ -344,45 +852,174 @@ JSValue Utilities::setTimeout(JSContext* ctx, JSValueConst this_val, int argc, J
     if(JS_ToInt32(ctx, &delay, argv[1]))
         return JS_ThrowTypeError(ctx, "Argument2 is not a Number");
 
-    TimeoutTimer timer = {
-        rt->nextTimerId++,
-        std::chrono::steady_clock::now() + std::chrono::milliseconds(delay),
-        JS_DupValue(ctx, argv[0])
-    };
+    uint32_t id = rt->timers.push(rt->clock->now() + std::chrono::milliseconds(delay), { JS_DupValue(ctx, argv[0]), ctx });
+
+    return JS_NewUint32(ctx, id);
+}
+
+
+JSValue Utilities::dateNow(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    return JS_NewFloat64(ctx, std::floor(rt->clock->epochMs()));
+}
+
+
+void Utilities::GCStats::record(double ms) {
+    size_t bucket = std::upper_bound(bucketsMs.begin(), bucketsMs.end(), ms) - bucketsMs.begin();
+    counts[bucket]++;
+    count++;
+    totalMs += ms;
+    maxMs = std::max(maxMs, ms);
+}
+
+
+// 按类别返回 quickjs 的内存使用情况，字段与 JSMemoryUsage 对应
+auto Utilities::memoryUsage(JSContext* ctx) {
+    JSMemoryUsage usage;
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &usage);
+
+    auto field = [](const char* name, int64_t value) { return std::make_pair(name, static_cast<double>(value)); };
+
+    return std::make_tuple(
+        field("mallocSize", usage.malloc_size),
+        field("mallocLimit", usage.malloc_limit),
+        field("mallocCount", usage.malloc_count),
+        field("memoryUsedSize", usage.memory_used_size),
+        field("atomCount", usage.atom_count),
+        field("atomSize", usage.atom_size),
+        field("stringCount", usage.str_count),
+        field("stringSize", usage.str_size),
+        field("objectCount", usage.obj_count),
+        field("objectSize", usage.obj_size),
+        field("propertyCount", usage.prop_count),
+        field("propertySize", usage.prop_size),
+        field("shapeCount", usage.shape_count),
+        field("shapeSize", usage.shape_size),
+        field("functionCount", usage.js_func_count),
+        field("functionSize", usage.js_func_size),
+        field("functionCodeSize", usage.js_func_code_size),
+        field("cFunctionCount", usage.c_func_count),
+        field("arrayCount", usage.array_count),
+        field("fastArrayCount", usage.fast_array_count),
+        field("fastArrayElements", usage.fast_array_elements),
+        field("binaryObjectCount", usage.binary_object_count),
+        field("binaryObjectSize", usage.binary_object_size)
+    );
+}
 
-    rt->timers.push(timer);
 
-    return JS_NewUint32(ctx, timer.id);
+// 内存分配量超过阈值时自动 GC，bytes 小于 0 时关闭自动 GC
+void Utilities::setGCThreshold(JSContext* ctx, double bytes) {
+    JSRuntime* _rt = JS_GetRuntime(ctx);
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(_rt));
+    size_t threshold = bytes < 0 ? SIZE_MAX : static_cast<size_t>(bytes);
+
+    if(rt->pool)
+        rt->gcThreshold = threshold;
+    else JS_SetGCThreshold(_rt, threshold);
+}
+
+
+// bytes 小于等于 0 时不限制内存
+void Utilities::setMemoryLimit(JSContext* ctx, double bytes) {
+    JS_SetMemoryLimit(JS_GetRuntime(ctx), bytes <= 0 ? SIZE_MAX : static_cast<size_t>(bytes));
+}
+
+
+// 立即执行一次 GC，返回耗时 (ms)，并记录到直方图中
+double Utilities::collectGarbage(JSContext* ctx) {
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    return rt->runGC();
+}
+
+
+auto Utilities::gcStats(JSContext* ctx) {
+    JSRuntime* _rt = JS_GetRuntime(ctx);
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(_rt));
+    const GCStats& stats = rt->gcStats;
+
+    return std::make_tuple(
+        std::make_pair("count", stats.count),
+        std::make_pair("totalMs", stats.totalMs),
+        std::make_pair("maxMs", stats.maxMs),
+        std::make_pair("bucketsMs", std::vector<double>(stats.bucketsMs.begin(), stats.bucketsMs.end())),
+        std::make_pair("counts", std::vector<double>(stats.counts.begin(), stats.counts.end()))
+    );
+}
+
+
+// budgetMs 小于等于 0 时关闭看门狗，abortOnStall 为 true 时中断卡顿的那一帧的任务
+void Utilities::setWatchdog(JSContext* ctx, double budgetMs, bool abortOnStall) {
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    rt->watchdog.start(budgetMs, abortOnStall);
+}
+
+
+// 同步等待，使用虚拟时钟时只推进时间
+void qjs::sleep(JSContext* ctx, double ms) {
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    if(ms > 0)
+        rt->getClock().sleepFor(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>(ms)));
+}
+
+
+auto qjs::allocatorStats(JSContext* ctx) {
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    return rt->allocatorStats();
+}
+
+
+auto Utilities::watchdogStats(JSContext* ctx) {
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    const Watchdog& watchdog = rt->watchdog;
+
+    return std::make_tuple(
+        std::make_pair("stalls", watchdog.stalls),
+        std::make_pair("worstTickMs", watchdog.worstTickMs),
+        std::make_pair("lastStallMs", watchdog.lastStall.durationMs),
+        std::make_pair("lastBinding", watchdog.lastStall.binding),
+        std::make_pair("lastStack", watchdog.lastStall.stack)
+    );
 }
 
 
 // quickjs的头文件中大量使用static inline函数，在导出的模板元函数中直接使用这些函数会出问题
 const char* qjs_ToCString(JSContext *ctx, JSValue val1) { return JS_ToCString(ctx, val1); }
 int qjs_ToUint32(JSContext *ctx, uint32_t *pres, JSValue val) { return JS_ToUint32(ctx, pres, val); }
+void qjs_FreeValue(JSContext *ctx, JSValue val) { JS_FreeValue(ctx, val); }
 JSValue qjs_NewBool(JSContext *ctx, int val) { return JS_NewBool(ctx, val); }
 JSValue qjs_NewInt32(JSContext *ctx, int32_t val) { return JS_NewInt32(ctx, val); }
 JSValue qjs_NewUint32(JSContext *ctx, uint32_t val) { return JS_NewUint32(ctx, val); }
+JSValue qjs_NewFloat64(JSContext *ctx, double val) { return JS_NewFloat64(ctx, val); }
 JSValue qjs_NewCFunction(JSContext *ctx, JSCFunction *func, const char *name, int length) {
     return JS_NewCFunction(ctx, func, name, length);
 }
 
 
 // 将 JS列表 转换为 std::tuple
+// 每个元素只读取一次，转换完成后释放，数组是连续存储时 quickjs 内部会直接按下标取值
 template <typename Tuple, std::size_t... I>
 Tuple Utilities::jsList_to_tuple(JSContext* ctx, const JSValue& val, std::index_sequence<I...>) {
-    return std::make_tuple(convert_from_js<std::tuple_element_t<I, Tuple>>(
-        ctx, JS_GetPropertyUint32(ctx, val, I)
-    )...);
+    JSValue items[] = { JS_GetPropertyUint32(ctx, val, I)..., JS_UNDEFINED };
+
+    Tuple result { convert_from_js<std::tuple_element_t<I, Tuple>>(ctx, items[I])... };
+
+    (qjs_FreeValue(ctx, items[I]), ...);
+    return result;
 }
 
 
 // 将 std::tuple 转换为 JSObject
+// 键值对使用缓存的 JSAtom 按固定顺序定义属性，同一种 tuple 生成的对象共享同一个 shape
 template <typename Tuple, std::size_t... I>
 JSValue Utilities::tuple_to_jsObject(JSContext* ctx, const Tuple& val, std::index_sequence<I...>) {
     JSValue obj = JS_NewObject(ctx);
-    if constexpr (is_key_values_tuple<Tuple>::value)
-        (JS_SetPropertyStr(ctx, obj, std::get<I>(val).first, convert_to_js(ctx, std::get<I>(val).second)), ...);
-    else (JS_SetPropertyUint32(ctx, obj, I, convert_to_js(ctx, std::get<I>(val))), ...);
+    if constexpr (is_key_values_tuple<Tuple>::value) {
+        qjs::Context* context = reinterpret_cast<qjs::Context*>(JS_GetContextOpaque(ctx));
+        (JS_DefinePropertyValue(ctx, obj, context->getAtom(std::get<I>(val).first), 
+            convert_to_js(ctx, std::get<I>(val).second), JS_PROP_C_W_E), ...);
+    }
+    else (JS_DefinePropertyValueUint32(ctx, obj, I, convert_to_js(ctx, std::get<I>(val)), JS_PROP_C_W_E), ...);
     return obj;
 }
 
@@ -411,9 +1048,31 @@ Type Utilities::convert_from_js(JSContext* ctx, const JSValue& val) {
     else if constexpr (is_tuple<T>::value)
         return jsList_to_tuple<T>(ctx, val, std::make_index_sequence<std::tuple_size_v<T>>{});
 
+    else if constexpr (is_vector<T>::value) {
+        T result;
+        uint32_t length = 0;
+        JSValue lengthValue = JS_GetPropertyStr(ctx, val, "length");
+        qjs_ToUint32(ctx, &length, lengthValue);
+        qjs_FreeValue(ctx, lengthValue);
+
+        result.reserve(length);
+        for (uint32_t i = 0; i < length; i++) {
+            JSValue item = JS_GetPropertyUint32(ctx, val, i);
+            result.push_back(convert_from_js<typename T::value_type>(ctx, item));
+            qjs_FreeValue(ctx, item);
+        }
+        return result;
+    }
+
     Type value;
 
-    if constexpr (sizeof(T) == 4) {
+    if constexpr (std::is_floating_point_v<T>) {
+        double _value;
+        JS_ToFloat64(ctx, &_value, val);
+        value = static_cast<Type>(_value);
+    }
+
+    else if constexpr (sizeof(T) == 4) {
         if constexpr (std::is_signed_v<T>)
             JS_ToInt32(ctx, reinterpret_cast<int32_t*>(&value), val);
         else qjs_ToUint32(ctx, reinterpret_cast<uint32_t*>(&value), val);
@@ -449,6 +1108,14 @@ JSValue Utilities::convert_to_js(JSContext *ctx, const Type& val) {
     else if constexpr (is_tuple<T>::value)
         return tuple_to_jsObject(ctx, val, std::make_index_sequence<std::tuple_size_v<T>>{});
     
+    // 帧缓冲池中的缓冲区，ArrayBuffer 被释放时归还到池中，opaque 中保存缓冲区的大小
+    else if constexpr (std::is_same_v<T, frame::Buffer>) {
+        return JS_NewArrayBuffer(ctx, reinterpret_cast<uint8_t*>(val.data), val.size, 
+            [](JSRuntime* rt, void* opaque, void* ptr) { 
+                frame::release(reinterpret_cast<std::byte*>(ptr), reinterpret_cast<size_t>(opaque));
+            }, reinterpret_cast<void*>(val.size), 1);
+    }
+
     else if constexpr (std::is_same_v<T, std::pair<std::byte*, size_t>>) {
         return JS_NewArrayBuffer(ctx, reinterpret_cast<uint8_t*>(val.first), val.second, 
             [](JSRuntime* rt, void* opaque, void* ptr) { 
@@ -456,6 +1123,16 @@ JSValue Utilities::convert_to_js(JSContext *ctx, const Type& val) {
             }, nullptr, 1);
     }
 
+    else if constexpr (std::is_floating_point_v<T>)
+        return qjs_NewFloat64(ctx, static_cast<double>(val));
+
+    else if constexpr (is_vector<T>::value) {
+        JSValue array = JS_NewArray(ctx);
+        for (uint32_t i = 0; i < val.size(); i++)
+            JS_DefinePropertyValueUint32(ctx, array, i, convert_to_js(ctx, val[i]), JS_PROP_C_W_E);
+        return array;
+    }
+
     else if constexpr (sizeof(T) <= 4) {
         if constexpr (std::is_signed_v<T>)
             return qjs_NewInt32(ctx, val);
@@ -474,22 +1151,29 @@ JSValue Utilities::convert_to_js(JSContext *ctx, const Type& val) {
 template <auto Func, size_t... I>
 JSValue Utilities::call_with_js_args(JSContext* ctx, JSValueConst* argv, std::index_sequence<I...>) {
     using traits = function_traits<decltype(Func)>;
+    constexpr size_t offset = traits::context_count;
     
-    std::tuple<typename traits::template arg_type<I>...> args_tuple =
-        std::make_tuple(convert_from_js<typename traits::template arg_type<I>>(ctx, argv[I])...);
+    std::tuple<typename traits::template arg_type<I + offset>...> args_tuple =
+        std::make_tuple(convert_from_js<typename traits::template arg_type<I + offset>>(ctx, argv[I])...);
+
+    auto invoke = [&]() -> decltype(auto) {
+        if constexpr (offset == 1)
+            return std::apply([ctx](auto&... args) { return Func(ctx, args...); }, args_tuple);
+        else return std::apply(Func, args_tuple);
+    };
 
     JSValue result;
     
     if constexpr (std::is_same_v<typename traits::return_type, void>) {
-        std::apply(Func, args_tuple);
+        invoke();
         result = JS_UNDEFINED;
     } else {
-        auto _result = std::apply(Func, args_tuple);
+        auto _result = invoke();
         result = convert_to_js(ctx, _result);
     }
 
     ([&]() {
-        if constexpr (std::is_same_v<typename traits::template arg_type<I>, const char*>)
+        if constexpr (std::is_same_v<typename traits::template arg_type<I + offset>, const char*>)
             JS_FreeCString(ctx, std::get<I>(args_tuple));
     }(), ...);
 
@@ -497,23 +1181,106 @@ JSValue Utilities::call_with_js_args(JSContext* ctx, JSValueConst* argv, std::in
 }
 
 
+// 将 C/C++ 函数封装为 quickjs 可以调用的 JSCFunction
+template <auto Func>
+JSValue Utilities::call(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv) {
+    using traits = function_traits<decltype(Func)>;
+
+    if (argc != traits::js_args_count::value)
+        return JS_ThrowSyntaxError(ctx, "Expected %d argument, but received %d", (unsigned)traits::js_args_count::value, argc);
+
+    // 记录正在执行的原生函数，看门狗检测到卡顿时读取
+    Watchdog& watchdog = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)))->watchdog;
+    JSCFunction* caller = watchdog.currentBinding.exchange(call<Func>, std::memory_order_relaxed);
+    trace::Span span(trace::isEnabled() ? bindingName<Func>(ctx) : nullptr, "binding");
+    
+    JSValue result = call_with_js_args<Func>(ctx, argv, std::make_index_sequence<traits::js_args_count::value>{});
+
+    watchdog.currentBinding.store(caller, std::memory_order_relaxed);
+    return result;
+}
+
+
+// 同一个函数在所有运行时的函数表中名称相同，找到后缓存下来
+template <auto Func>
+const char* Utilities::bindingName(JSContext* ctx) {
+    static std::atomic<const char*> cached = nullptr;
+
+    const char* name = cached.load(std::memory_order_relaxed);
+    if (name)
+        return name;
+
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    auto it = rt->bindingNames.find(call<Func>);
+    if (it == rt->bindingNames.end())
+        return "binding";
+
+    cached.store(it->second, std::memory_order_relaxed);
+    return it->second;
+}
+
+
 // 将一个 C/C++ 函数封装为quickjs可用的函数，并且绑定到JS对象上
 template <auto Func>
 qjs::Shared_Value& qjs::Shared_Value::func(const std::string& name) {
     using traits = Utilities::function_traits<decltype(Func)>;
 
-    JS_SetPropertyStr(ctx, value, name.c_str(), qjs_NewCFunction(ctx, 
-        [](JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) -> JSValue {
-            if (argc != traits::args_count::value)
-                return JS_ThrowSyntaxError(ctx, "Expected %d argument, but received %d", (unsigned)traits::args_count::value, argc);
-            
-            return Utilities::call_with_js_args<Func>(ctx, argv, std::make_index_sequence<traits::args_count::value>{});
-    }, name.c_str(), 0));
+    JS_SetPropertyStr(ctx, value, name.c_str(), 
+        qjs_NewCFunction(ctx, Utilities::call<Func>, name.c_str(), traits::js_args_count::value));
 
     return *this;
 }
 
 
+// 生成函数表项，等价于 quickjs.h 中的 JS_CFUNC_DEF，length 为函数的参数个数
+template <auto Func>
+constexpr JSCFunctionListEntry qjs::function(const char* name) {
+    using traits = Utilities::function_traits<decltype(Func)>;
+
+    JSCFunctionListEntry entry {};
+    entry.name = name;
+    entry.prop_flags = JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE;
+    entry.def_type = JS_DEF_CFUNC;
+    entry.u.func.length = traits::js_args_count::value;
+    entry.u.func.cproto = JS_CFUNC_generic;
+    entry.u.func.cfunc.generic = Utilities::call<Func>;
+    return entry;
+}
+
+
+// 注册原生模块，模块的导出项就是函数表中的所有函数
+template <const auto& Functions>
+void qjs::Context::addModule(const char* name) {
+    JSModuleDef* module = JS_NewCModule(ctx, name, [](JSContext* ctx, JSModuleDef* module) {
+        return JS_SetModuleExportList(ctx, module, std::data(Functions), static_cast<int>(std::size(Functions)));
+    });
+
+    if(!module || JS_AddModuleExportList(ctx, module, std::data(Functions), static_cast<int>(std::size(Functions))) < 0)
+        throw std::runtime_error(std::string("Failed to add native module '") + name + '\'');
+
+    qjs::Runtime* rt = reinterpret_cast<qjs::Runtime*>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    for(const JSCFunctionListEntry& entry: Functions)
+        rt->bindingNames[entry.u.func.cfunc.generic] = entry.name;
+}
+
+
+// 原生模块 native:runtime
+constexpr auto runtimeFunctions = std::array {
+    qjs::function<Utilities::memoryUsage>("memoryUsage"),
+    qjs::function<Utilities::setGCThreshold>("setGCThreshold"),
+    qjs::function<Utilities::setMemoryLimit>("setMemoryLimit"),
+    qjs::function<Utilities::collectGarbage>("gc"),
+    qjs::function<Utilities::gcStats>("gcStats"),
+    qjs::function<Utilities::setWatchdog>("setWatchdog"),
+    qjs::function<Utilities::watchdogStats>("watchdogStats"),
+    qjs::function<qjs::sleep>("sleep"),
+};
+
+void qjs::Context::addRuntimeModule() {
+    addModule<runtimeFunctions>("native:runtime");
+}
+
+
 void test() {
     qjs::Runtime jsRuntime;
     qjs::Context context = jsRuntime.createContext();
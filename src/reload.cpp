@@ -0,0 +1,131 @@
+module;
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <filesystem>
+#include <system_error>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+export module reload;
+
+
+// 脚本热重载中不依赖 quickjs 的部分: 按修改时间和大小判断是否有效的编译缓存、上下文拥有的原生资源、替换上下文的顺序
+// 可以单独用模拟的上下文测试
+export namespace reload {
+    // 文件的修改时间和大小，两者都没有变化时认为文件没有被修改
+    struct Stamp {
+        std::filesystem::file_time_type writeTime;
+        uintmax_t size;
+
+        bool operator == (const Stamp& other) const = default;
+    };
+
+    // 读取失败时返回 nullopt，这样的文件不缓存
+    auto stamp(const std::filesystem::path& path) -> std::optional<Stamp>;
+
+    // 模块名 -> 编译结果，同一个运行时中新建的上下文加载没有修改的模块时使用
+    template <typename T>
+    class Cache {
+    public:
+        // 缓存中的文件已经被修改时返回 nullptr
+        auto find(const std::string& name, const Stamp& stamp) const -> const T* {
+            auto it = entries.find(name);
+            return it != entries.end() && it->second.first == stamp ? &it->second.second : nullptr;
+        }
+
+        void store(const std::string& name, const Stamp& stamp, T value) {
+            entries.insert_or_assign(name, std::make_pair(stamp, std::move(value)));
+        }
+
+        auto size() const -> size_t { return entries.size(); }
+
+    private:
+        std::unordered_map<std::string, std::pair<Stamp, T>> entries {};
+    };
+
+    // 脚本通过原生函数创建的资源 (进程监视器、Calibration、模板等)，销毁时按创建的相反顺序释放
+    // 热重载时旧的上下文被替换，脚本来不及释放的资源随它一起释放
+    class Resources {
+    public:
+        using Release = void(*)(uint32_t);
+
+        Resources() = default;
+
+        void own(Release release, uint32_t id) { owned.emplace_back(release, id); }
+
+        // 脚本主动释放资源时调用，之后不再重复释放
+        void release(Release release, uint32_t id);
+
+        void releaseAll();
+
+        auto size() const -> size_t { return owned.size(); }
+
+        ~Resources() { releaseAll(); }
+
+        Resources(const Resources&) = delete;
+        Resources& operator=(const Resources&) = delete;
+
+    private:
+        std::vector<std::pair<Release, uint32_t>> owned {};
+    };
+
+    // 当前运行的上下文，新的上下文完整加载之后才替换，加载失败 (例如语法错误) 时保留旧的上下文
+    template <typename Context>
+    class Slot {
+    public:
+        auto get() const -> Context* { return current.get(); }
+
+        // load 创建并加载新的上下文，抛出异常时返回错误信息，旧的上下文不受影响
+        // 成功时先把新的上下文放入 slot 再销毁旧的上下文，旧的上下文的析构函数中 get 已经返回新的上下文
+        template <typename Load>
+        auto replace(Load load) -> std::optional<std::string> {
+            std::unique_ptr<Context> fresh;
+            try {
+                fresh = load();
+            }
+            catch(const std::exception& e) {
+                return e.what();
+            }
+
+            std::swap(current, fresh);
+            fresh.reset();
+            return std::nullopt;
+        }
+
+    private:
+        std::unique_ptr<Context> current {};
+    };
+}
+
+
+auto reload::stamp(const std::filesystem::path& path) -> std::optional<Stamp> {
+    std::error_code ec;
+    auto writeTime = std::filesystem::last_write_time(path, ec);
+    if(ec)
+        return std::nullopt;
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    if(ec)
+        return std::nullopt;
+    return Stamp { writeTime, size };
+}
+
+
+void reload::Resources::release(Release release, uint32_t id) {
+    std::erase(owned, std::make_pair(release, id));
+    release(id);
+}
+
+
+void reload::Resources::releaseAll() {
+    while(!owned.empty()) {
+        auto [release, id] = owned.back();
+        owned.pop_back();
+        release(id);
+    }
+}
@@ -0,0 +1,385 @@
+module;
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <unordered_map>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+export module scheduler;
+
+import trace;
+
+
+// 多目标模式的调度
+// 每个目标 (一个游戏客户端) 是一个任务，任务的 step 执行到期的工作并返回下一次需要执行的时间
+// 线程池中的线程按到期时间取出任务执行，同一个任务同一时间只在一个线程上执行
+// 不依赖具体的平台，可以用模拟的目标测量吞吐量和延迟
+export namespace scheduler {
+    using Clock = std::chrono::steady_clock;
+
+    // 返回 std::nullopt 表示任务已经结束
+    using Step = std::function<std::optional<Clock::time_point>()>;
+
+    struct TargetStats {
+        uint32_t id = 0;
+        std::string name {};
+        double steps = 0;
+        double busyMs = 0;          // step 的总耗时
+        double totalLatencyMs = 0;  // 从到期到开始执行的延迟，反映线程池是否忙不过来
+        double maxLatencyMs = 0;
+        bool finished = false;
+        std::string error {};       // step 抛出异常时的错误信息，任务随之结束
+    };
+
+    class Pool {
+    public:
+        Pool(unsigned threadCount = std::max(std::thread::hardware_concurrency(), 1u));
+
+        // 等待正在执行的 step 结束，不再执行新的 step
+        ~Pool();
+
+        // 添加的任务立即到期
+        auto add(std::string name, Step step) -> uint32_t;
+
+        // 删除任务，任务正在执行时等待这次 step 结束，返回之后 step 不会再被调用
+        void remove(uint32_t id);
+
+        // 等待所有任务结束
+        void wait();
+
+        auto stats() -> std::vector<TargetStats>;
+
+        // 从线程池创建到现在，平均每秒执行的 step 数
+        auto throughput() -> double;
+
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+    private:
+        struct Job {
+            Step step;
+            const char* traceName;      // 追踪中每次 step 的事件名称，为任务的名称
+            TargetStats stats;
+            bool running = false;
+            bool removed = false;
+        };
+
+        using QueueEntry = std::pair<Clock::time_point, uint32_t>;
+
+        void work();
+
+        // 持有锁时调用，到期时间早于队首时唤醒等待中的线程
+        void schedule(Clock::time_point due, uint32_t id);
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::unordered_map<uint32_t, Job> jobs {};
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> queue {};
+        std::vector<std::thread> threads {};
+        Clock::time_point startTime = Clock::now();
+        double totalSteps = 0;
+        uint32_t nextId = 1;
+        bool stopping = false;
+    };
+
+    // 当前线程正在执行的任务编号，不在线程池中执行时为 0
+    auto currentJob() -> uint32_t;
+
+    // 全局的输入调度
+    // 前台窗口、键盘和鼠标是整个系统共享的，所有目标的输入都要串行执行，返回的锁在作用域结束时释放
+    // 其它任务的输入事务进行中时不等待，返回不持有锁的 unique_lock，由调用者稍后重试:
+    // 持有者要在之后的 step 中才能结束事务，线程池的线程在这里等待会让持有者没有线程可用
+    auto lockInput() -> std::unique_lock<std::mutex>;
+
+    // 输入事务，用于一组连续的输入 (例如切换到前台后按下、等待、松开按键)，期间其它任务的输入都会失败，需要稍后重试
+    // 事务中的脚本会等待计时器，会在多次 step 中、不同的线程上继续，所以按任务编号记录持有者；同一个任务可以嵌套
+    // 不阻塞: 其它任务持有事务时返回 false，由调用者稍后重试
+    auto tryBeginInput() -> bool;
+
+    void endInput();
+
+    // 持有者超过这个时间没有输入时事务自动结束，避免脚本出错或者上下文被替换后其它任务一直无法输入
+    constexpr auto inputLease = std::chrono::seconds(2);
+
+    struct InputStats {
+        double inputs = 0;
+        double waits = 0;           // 需要等待其它目标的输入结束的次数
+        double totalWaitMs = 0;
+        double maxWaitMs = 0;
+        double transactions = 0;
+        double busy = 0;            // lockInput 或者 tryBeginInput 因为其它任务持有事务而失败的次数
+    };
+
+    auto inputStats() -> InputStats;
+}
+
+
+thread_local uint32_t runningJob = 0;
+
+void releaseInput(uint32_t job);
+
+
+auto scheduler::currentJob() -> uint32_t {
+    return runningJob;
+}
+
+
+scheduler::Pool::Pool(unsigned threadCount) {
+    for (unsigned i = 0; i < std::max(threadCount, 1u); i++) {
+        threads.emplace_back([this, i]() {
+            trace::setThreadName("worker " + std::to_string(i));
+            work();
+        });
+    }
+}
+
+
+scheduler::Pool::~Pool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+
+    for (std::thread& thread: threads)
+        thread.join();
+}
+
+
+void scheduler::Pool::schedule(Clock::time_point due, uint32_t id) {
+    bool earliest = queue.empty() || due < queue.top().first;
+    queue.emplace(due, id);
+    if (earliest)
+        changed.notify_all();
+}
+
+
+auto scheduler::Pool::add(std::string name, Step step) -> uint32_t {
+    std::lock_guard lock(mutex);
+
+    uint32_t id = nextId++;
+    Job& job = jobs[id];
+    job.step = std::move(step);
+    job.traceName = trace::intern(name);
+    job.stats.id = id;
+    job.stats.name = std::move(name);
+
+    schedule(Clock::now(), id);
+    return id;
+}
+
+
+void scheduler::Pool::remove(uint32_t id) {
+    std::unique_lock lock(mutex);
+
+    auto it = jobs.find(id);
+    if (it == jobs.end())
+        return;
+
+    // 正在执行的任务由执行它的线程在 step 结束后删除
+    if (it->second.running) {
+        it->second.removed = true;
+        changed.wait(lock, [&]() { return !jobs.contains(id); });
+    }
+    else jobs.erase(it);
+}
+
+
+void scheduler::Pool::wait() {
+    std::unique_lock lock(mutex);
+    changed.wait(lock, [&]() {
+        return std::all_of(jobs.begin(), jobs.end(), [](const auto& entry) { return entry.second.stats.finished; });
+    });
+}
+
+
+void scheduler::Pool::work() {
+    std::unique_lock lock(mutex);
+
+    while (!stopping) {
+        if (queue.empty()) {
+            changed.wait(lock);
+            continue;
+        }
+
+        auto [due, id] = queue.top();
+        if (due > Clock::now()) {
+            changed.wait_until(lock, due);
+            continue;
+        }
+        queue.pop();
+
+        // 队列中可能还留有已经删除的任务
+        auto it = jobs.find(id);
+        if (it == jobs.end() || it->second.stats.finished)
+            continue;
+
+        Job& job = it->second;
+        job.running = true;
+        lock.unlock();
+        runningJob = id;
+
+        auto start = Clock::now();
+        std::optional<Clock::time_point> next;
+        std::string error;
+
+        try {
+            trace::Span span(job.traceName, "target");
+            next = job.step();
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        auto end = Clock::now();
+        runningJob = 0;
+
+        // 结束或者被删除的任务不会再结束它的输入事务
+        if (job.removed || !error.empty() || !next)
+            releaseInput(id);
+
+        lock.lock();
+
+        job.running = false;
+        totalSteps++;
+
+        TargetStats& stats = job.stats;
+        double latencyMs = std::chrono::duration<double, std::milli>(start - due).count();
+        stats.steps++;
+        stats.busyMs += std::chrono::duration<double, std::milli>(end - start).count();
+        stats.totalLatencyMs += latencyMs;
+        stats.maxLatencyMs = std::max(stats.maxLatencyMs, latencyMs);
+
+        if (job.removed) {
+            jobs.erase(it);
+            changed.notify_all();
+        }
+        else if (!error.empty() || !next) {
+            stats.error = std::move(error);
+            stats.finished = true;
+            changed.notify_all();
+        }
+        else schedule(*next, id);
+    }
+}
+
+
+auto scheduler::Pool::stats() -> std::vector<TargetStats> {
+    std::lock_guard lock(mutex);
+
+    std::vector<TargetStats> result;
+    for (const auto& [id, job]: jobs)
+        result.push_back(job.stats);
+
+    std::sort(result.begin(), result.end(), [](const TargetStats& a, const TargetStats& b) { return a.id < b.id; });
+    return result;
+}
+
+
+auto scheduler::Pool::throughput() -> double {
+    std::lock_guard lock(mutex);
+    double seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+    return seconds > 0 ? totalSteps / seconds : 0;
+}
+
+
+struct InputScheduler {
+    std::mutex mutex;
+    scheduler::InputStats stats {};
+
+    // 输入事务的持有者，depth 为 0 时没有事务
+    uint32_t owner = 0;
+    uint32_t depth = 0;
+    scheduler::Clock::time_point expires {};
+
+    // 持有锁时调用
+    bool blockedBy(uint32_t job) {
+        if (depth == 0 || owner == job)
+            return false;
+        if (scheduler::Clock::now() < expires)
+            return true;
+        depth = 0;
+        return false;
+    }
+};
+
+InputScheduler inputScheduler;
+
+
+auto scheduler::lockInput() -> std::unique_lock<std::mutex> {
+    std::unique_lock lock(inputScheduler.mutex, std::try_to_lock);
+    uint32_t job = currentJob();
+
+    // 其它目标的输入只占用锁很短的时间，直接等待；统计数据只在持有锁时修改
+    double waitMs = 0;
+    if (!lock.owns_lock()) {
+        auto start = Clock::now();
+        trace::Span span("inputWait", "input");
+        lock.lock();
+        waitMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        inputScheduler.stats.waits++;
+    }
+
+    if (inputScheduler.blockedBy(job)) {
+        inputScheduler.stats.busy++;
+        lock.unlock();
+        return lock;
+    }
+
+    // 持有者的每次输入都延长事务
+    if (inputScheduler.depth > 0 && inputScheduler.owner == job)
+        inputScheduler.expires = Clock::now() + inputLease;
+
+    InputStats& stats = inputScheduler.stats;
+    stats.inputs++;
+    stats.totalWaitMs += waitMs;
+    stats.maxWaitMs = std::max(stats.maxWaitMs, waitMs);
+    return lock;
+}
+
+
+auto scheduler::tryBeginInput() -> bool {
+    std::lock_guard lock(inputScheduler.mutex);
+    uint32_t job = currentJob();
+
+    if (inputScheduler.blockedBy(job)) {
+        inputScheduler.stats.busy++;
+        return false;
+    }
+
+    if (inputScheduler.depth++ == 0) {
+        inputScheduler.owner = job;
+        inputScheduler.stats.transactions++;
+    }
+    inputScheduler.expires = Clock::now() + inputLease;
+    return true;
+}
+
+
+void scheduler::endInput() {
+    std::lock_guard lock(inputScheduler.mutex);
+    if (inputScheduler.depth > 0 && inputScheduler.owner == currentJob())
+        inputScheduler.depth--;
+}
+
+
+void releaseInput(uint32_t job) {
+    std::lock_guard lock(inputScheduler.mutex);
+    if (inputScheduler.depth > 0 && inputScheduler.owner == job)
+        inputScheduler.depth = 0;
+}
+
+
+auto scheduler::inputStats() -> InputStats {
+    std::lock_guard lock(inputScheduler.mutex);
+    return inputScheduler.stats;
+}
@@ -1,103 +1,314 @@
-import { console, win, keyboard, ansi, os, sleep } from "./api.js"
+import { console, status, eventlog, trace, win, processes, Calibration, image, keyboard, ansi, os, runtime, sleep } from "./api.js"
 
 try {
 // 如果是国服，进程名为 "YuanShen.exe"，国际服为 "GenshinImpact.exe"
 const processNames = ["YuanShen.exe", "GenshinImpact.exe"]
 
-// 1920 x 1080 分辨率下的像素点坐标和颜色
+// 使用 --multi 参数启动时，程序为每个原神客户端执行一次这个脚本，并提供 target = { pid, hwnd }
+// 多个客户端共用状态面板和日志，状态和日志前加上 pid 区分
+const target = globalThis.target
+const tag = target ? `[${target.pid}] ` : ""
+const setState = (text) => status.setState(tag + text)
+
+// 1920 x 1080 分辨率下的像素点坐标和颜色，坐标会根据实际的游戏窗口大小换算，窗口大小变化时自动更新
+const calibration = new Calibration(1920, 1080)
+
 const points = [
-    { pos: [280, 35], color: win.rgb(236, 229, 216) },  // 隐藏对话按钮的白色部分
-    { pos: [271, 49], color: win.rgb(59, 67, 84) },   // 隐藏对话按钮的黑色部分
+    { pos: calibration.point([280, 35]), color: win.rgb(236, 229, 216) },  // 隐藏对话按钮的白色部分
+    { pos: calibration.point([271, 49]), color: win.rgb(59, 67, 84) },   // 隐藏对话按钮的黑色部分
 ]
 
-// 根据实际的游戏窗口大小调整上面的像素点坐标
-function initPoints(width, height) {
-    const scale = width * 9 > height * 16 ? height / 1080.0 : width / 1920.0;
+// 1920 x 1080 分辨率下对话文本框的区域 [left, top, right, bottom]，以窗口底部中央为基准
+const textBox = calibration.rect([460, 870, 1460, 1010], Calibration.bottomCenter)
 
-    for(const { pos } of points) {
-        pos[0] = Math.round(pos[0] * scale);
-        pos[1] = Math.round(pos[1] * scale);
-    }
+// 根据窗口大小换算坐标，并重新注册截图区域：隐藏对话按钮附近和对话文本框
+// 每一帧只截取这两块区域，这一帧中的所有读取都使用这两次截图
+function calibrate(hwnd, width, height) {
+    calibration.update(width, height)
+
+    const xs = points.map(({ pos }) => pos[0]), ys = points.map(({ pos }) => pos[1])
+    win.clearFrameRegions(hwnd)
+    win.addFrameRegion(hwnd, [Math.min(...xs), Math.min(...ys), Math.max(...xs) + 1, Math.max(...ys) + 1])
+    win.addFrameRegion(hwnd, textBox)
 }
 
-let pid, hwnd, wndSize, hdc
 
-// 等待原神进程，并获取进程的pid
-console.print(`${ansi.orange("[Waitting]")} 正在等待原神进程 ${ansi.blue(processNames[0])} / ${ansi.blue(processNames[1])}`)
+// 对话推进的反馈控制：每次按键前后对比对话文本框的指纹，判断这次按键是
+//   advanced: 切换到了下一句对话
+//   typing:   对话文字还在逐字显示，按键只是让这句话立即显示完整
+//   ignored:  按键没有任何效果 (例如正在播放动画，或者出现了选项)
+// 然后根据结果决定下一次按键的时机
+// 背景的变化会让文字边缘的格子在亮度阈值附近跳变，只有一个格子变化时当作噪声 (见 tools/fingerprint.cpp)
+const noiseCells = 1
+
+class DialogueAdvancer {
+    fingerprint = null      // 上一帧文本框的指纹
+    stableTicks = 0         // 文本框连续没有变化的帧数
+    requiredStableTicks = 1 // 文本框需要保持不变多少帧才按键
+    backoff = 0             // 按键无效时，下一次按键的额外等待时间(ms)
+    nextPressTime = 0
+    pending = null          // 等待确认结果的按键 { fingerprint }
+
+    stats = { presses: 0, advanced: 0, typing: 0, ignored: 0, dialogues: 0, dialogueTime: 0 }
+    dialogueStart = 0
+
+    // 截取文本框区域并计算指纹，截图失败时返回 null
+    sample(hwnd) {
+        const frame = win.captureFrame(hwnd, textBox)
+        if(frame.data.byteLength == 0)
+            return null
+        return image.fingerprint(frame.data, frame.width, frame.height, frame.step, 200)
+    }
+
+    // 根据最新的指纹更新状态，返回现在是否应该按键
+    update(fingerprint, now) {
+        // 无法截图时无法判断按键的效果，丢弃旧的指纹，退化为按键间隔逐渐变长的盲按
+        if(fingerprint === null) {
+            this.fingerprint = this.pending = null
+            this.stableTicks = 0
+            if(now < this.nextPressTime)
+                return false
+            this.backoff = Math.min(Math.max(this.backoff * 2, 250), 2000)
+            this.nextPressTime = now + this.backoff
+            return true
+        }
+
+        const last = this.fingerprint ?? fingerprint
+        const { added, removed } = image.compareFingerprints(last, fingerprint)
+        this.stableTicks = (added > noiseCells || removed > noiseCells) ? 0 : this.stableTicks + 1
+        this.fingerprint = fingerprint
+
+        if(this.pending) {
+            const diff = image.compareFingerprints(this.pending.fingerprint, fingerprint)
+            const result = diff.removed > noiseCells ? "advanced" : diff.added > noiseCells ? "typing" : "ignored"
+            eventlog.detection(result, 1)
+            this.stats[result]++
+            this.pending = null
+            status.add({ advanced: "推进对话", typing: "补全文字", ignored: "无效按键" }[result])
+
+            if(result == "advanced") {
+                this.backoff = 0
+                this.nextPressTime = now
+            } else if(result == "typing") {
+                // 按早了，以后等文字稳定更久再按
+                this.requiredStableTicks = Math.min(this.requiredStableTicks + 1, 4)
+            } else {
+                this.backoff = Math.min(Math.max(this.backoff * 2, 250), 2000)
+                this.nextPressTime = now + this.backoff
+            }
+        }
 
-while(!((pid=win.getPid(processNames[0])) || (pid=win.getPid(processNames[1]))))
-    await sleep(200)
+        return now >= this.nextPressTime && this.stableTicks >= this.requiredStableTicks
+    }
 
-console.print(ansi.cleanLine)
+    // 记录一次按键，在下一帧确认它的效果
+    pressed() {
+        this.stats.presses++
+        status.add("按键")
+        if(this.fingerprint !== null)
+            this.pending = { fingerprint: this.fingerprint }
+    }
 
-console.info(`${ansi.blue("Pid")} = ${pid}`)
+    enter(now) {
+        this.dialogueStart = now
+        this.stats.dialogues++
+        status.add("剧情")
+        this.fingerprint = this.pending = null
+        this.stableTicks = this.backoff = this.nextPressTime = 0
+    }
 
+    leave(now) {
+        this.stats.dialogueTime += now - this.dialogueStart
+        this.pending = null
+    }
 
-// 等待原神窗口，并获取窗口的 hwnd 以及窗口大小 wndSize
-console.print(`${ansi.orange("[Waitting]")} 正在等待原神窗口`)
+    // 每分钟推进的对话数，以及平均每段剧情中无效的按键数
+    // 让逐字显示的文字立即显示完整 (typing) 的按键也是有效的，只有 ignored 算作无效
+    report() {
+        const { advanced, ignored, dialogues, dialogueTime } = this.stats
+        const perMinute = dialogueTime > 0 ? advanced * 60000 / dialogueTime : 0
+        const wasted = dialogues > 0 ? ignored / dialogues : 0
+        return `推进 ${advanced} 句对话, ${perMinute.toFixed(1)} 句/分钟, 平均每段剧情无效按键 ${wasted.toFixed(1)} 次`
+    }
+}
+
+let pid = 0, hwnd = 0, wndSize
 
-while (true) {
-    hwnd = win.getHwnd(pid)
+// 使用 --watch 启动时，修改脚本后在新的上下文中重新执行这个脚本，reloadTarget 为修改前找到的 { pid, hwnd }
+// 窗口仍然有效时直接使用，不需要重新等待进程和窗口
+const reloadTarget = target ? null : globalThis.reloadTarget
+if(reloadTarget && win.getWndSize(reloadTarget.hwnd).width > 400) {
+    pid = reloadTarget.pid
+    hwnd = reloadTarget.hwnd
     wndSize = win.getWndSize(hwnd)
+}
 
-    if(wndSize.width > 400)
-        break
+// 正在运行的原神进程，pid -> 进程名；当前的进程退出后改为控制其中的另一个
+const running = new Map()
 
-    await sleep(200)
+// 等待原神进程的 Promise，找到进程时 resolve
+let resolvePid = null
+const waitForPid = () => pid ? Promise.resolve(pid) : new Promise(resolve => resolvePid = resolve)
+
+const setPid = (newPid) => {
+    pid = newPid
+    if(pid && resolvePid) {
+        resolvePid(pid)
+        resolvePid = null
+    }
 }
 
-console.print(ansi.cleanLine)
-console.info(`${ansi.blue("Hwnd")} = 0x${hwnd.toString(16)}`)
-console.info(`${ansi.blue("窗口大小")}: ${wndSize.width} ${ansi.blue("X")} ${wndSize.height}`)
+// 监视原神进程的启动和退出；找到进程之后只需要发现进程退出，扫描的间隔变长
+if(target)
+    pid = target.pid
+else processes.watch(processNames, ({ type, pid: eventPid, name }) => {
+    eventlog.detection(name, type == "appear" ? 1 : 0)
+
+    if(type == "appear") {
+        running.set(eventPid, name)
+        if(!pid)
+            setPid(eventPid)
+    }
+    else {
+        running.delete(eventPid)
+        if(eventPid != pid)
+            return
+
+        console.info(`原神进程 ${ansi.blue(name)} 已退出`)
+        setPid(running.keys().next().value ?? 0)
+        hwnd = 0
+        os.setReloadTarget(0, 0)
+    }
+})
+
+let stopWatchWindow = null
+
+// 等待原神进程和窗口，获取窗口的 hwnd 以及窗口大小 wndSize，并开始跟踪窗口的大小
+// 等待窗口时进程退出了就重新等待进程
+async function attach() {
+    stopWatchWindow?.()
+    stopWatchWindow = null
+
+    while(!hwnd) {
+        setState(`${ansi.orange("[Waitting]")} 正在等待原神进程 ${ansi.blue(processNames[0])} / ${ansi.blue(processNames[1])}`)
+        const attachingPid = await waitForPid()
+        console.info(`${ansi.blue("Pid")} = ${pid}`)
+
+        setState(`${ansi.orange("[Waitting]")} 正在等待原神窗口`)
+        while(pid == attachingPid) {
+            const candidate = target?.hwnd ?? win.getHwnd(pid)
+            wndSize = win.getWndSize(candidate)
+
+            if(wndSize.width > 400) {
+                hwnd = candidate
+                break
+            }
+
+            await sleep(200)
+        }
+    }
+
+    console.info(`${ansi.blue("Hwnd")} = 0x${hwnd.toString(16)}`)
+    if(!target)
+        os.setReloadTarget(pid, hwnd)
+    console.info(`${ansi.blue("窗口大小")}: ${wndSize.width} ${ansi.blue("X")} ${wndSize.height}`)
+
+    calibrate(hwnd, wndSize.width, wndSize.height)
+
+    // 窗口大小或者 DPI 变化时重新换算坐标，不需要重启程序
+    stopWatchWindow = win.watchWindow(hwnd, ({ width, height, dpi }) => {
+        if(width <= 400)
+            return
+        wndSize = { width, height }
+        calibrate(hwnd, width, height)
+        console.info(`${ansi.blue("窗口大小")}变为: ${width} ${ansi.blue("X")} ${height} (DPI ${dpi})`)
+        eventlog.message(`resize ${width}x${height}@${dpi}`)
+    })
+}
+
+await attach()
 
 console.info("开始自动点击剧情中(当检测到进入剧情时会自动点击)...")
 console.info(`按 ${ansi.blue("Alt + P")} 键暂停`)
 console.info(`按 ${ansi.blue("Alt + K")} 键截图 (仅供测试)`)
 
-initPoints(wndSize.width, wndSize.height)
-hdc = win.getDC(hwnd)
+// 剧情对话中产生的垃圾很少，调高自动 GC 的阈值，避免在对话中触发；每段剧情结束后主动 GC 一次
+runtime.setGCThreshold(64 * 1024 * 1024)
+
+// 每一帧正常只需要几毫秒，超过 1 秒说明脚本卡住了
+runtime.setWatchdog(1000, false)
 
 let isActivate = true
+setState(ansi.green("等待剧情对话"))
+
+const advancer = new DialogueAdvancer()
 
 // afterDialog：值为0表示正在剧情对话中，值为1表示不在剧情对话中，大于1表示剧情对话刚刚结束（会在几秒内递减到1）
 let afterDialog = 1
 
+// 记录进入剧情检测的时间，使用 --trace-startup 启动时输出启动报告
+os.startupReady()
+
 while(true) {
+    // 原神进程退出后回到等待状态，重新找到进程和窗口之后继续
+    if(!hwnd) {
+        if(afterDialog == 0)
+            advancer.leave(Date.now())
+        afterDialog = 1
+        await attach()
+        setState(isActivate ? ansi.green("等待剧情对话") : ansi.orange("暂停"))
+    }
+
     if(keyboard.isKeysDown('Alt', 'P')) {
         isActivate = !isActivate
+        eventlog.detection("active", isActivate ? 1 : 0)
         console.info(`程序${isActivate? ansi.green("继续执行"): ansi.orange("暂停")}中`)
+        setState(isActivate ? ansi.green("等待剧情对话") : ansi.orange("暂停"))
         await sleep(400)
     }
 
     if(keyboard.isKeysDown('Alt', 'K')) {
-        let image = win.captureWindow(hwnd, [0, 0, wndSize.width, wndSize.height])
-        if(image.data.byteLength > 0) {
+        let screenshot = win.captureWindow(hwnd, [0, 0, wndSize.width, wndSize.height])
+        if(screenshot.data.byteLength > 0) {
             os.mkdir("screenshots")
             const savePath = `screenshots/${Date.now()}.bmp`
-            if(win.saveBitmapImage(savePath, image.data, image.width, image.height, image.step))
+            if(win.saveBitmapImage(savePath, screenshot.data, screenshot.width, screenshot.height, screenshot.step))
                 console.info(`截图文件已保存至 "${ansi.blue(savePath)}"`)
         } else console.error("截屏失败")
-        image = null
+        screenshot = null
         await sleep(400)
     }
 
     if (isActivate) {
         // 判断左上角的隐藏对话按钮
-        if (win.getPixel(hdc, ...points[0].pos) == points[0].color && win.getPixel(hdc, ...points[1].pos) == points[1].color) {
+        if (win.getFramePixel(hwnd, ...points[0].pos) == points[0].color && win.getFramePixel(hwnd, ...points[1].pos) == points[1].color) {
             if(afterDialog > 0) {
                 afterDialog = 0
-                console.info("检测到进入剧情对话")
+                advancer.enter(Date.now())
+                console.info(`${tag}检测到进入剧情对话`)
+                eventlog.detection("dialogue", 1)
+                trace.instant("dialogueEnter")
+                setState(ansi.blue("剧情对话中"))
+            }
+
+            if(trace.span("advance", () => advancer.update(advancer.sample(hwnd), Date.now()))) {
+                // 发送点击 F 键的消息，按下到松开期间窗口保持在前台
+                await win.withInput(hwnd, async () => {
+                    keyboard.sendKeyDown(hwnd, 'F')
+                    await sleep(75);
+                    keyboard.sendKeyUp(hwnd, 'F')
+                })
+                advancer.pressed()
             }
-            win.setForegroundWindow(hwnd)
-            // 发送点击 F 键的消息
-            keyboard.sendKeyDown(hwnd, 'F')
-            await sleep(75);
-            keyboard.sendKeyUp(hwnd, 'F')
         }
 
         else if(afterDialog == 0) {
             afterDialog = 24
-            console.info("剧情对话结束")
+            advancer.leave(Date.now())
+            console.info(`${tag}剧情对话结束 (${advancer.report()})`)
+            eventlog.detection("dialogue", 0)
+            trace.instant("dialogueLeave")
+            setState(ansi.green("等待剧情对话"))
         }
     }
 
@@ -105,6 +316,10 @@ while(true) {
     if(afterDialog > 1) {
         afterDialog--
         win.releaseCursorClip()
+
+        // 剧情对话完全结束后回收这段剧情产生的垃圾，耗时记录在 runtime.gcStats() 中
+        if(afterDialog == 1)
+            runtime.gc()
     }
 
     await sleep(125)
@@ -0,0 +1,101 @@
+module;
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+export module startup;
+
+
+// 启动阶段计时
+// 每个阶段结束时调用 phase 记录，阶段的耗时为距离上一个阶段结束的时间
+// 计时从程序的静态初始化开始，不包含系统创建进程和加载 dll 的时间
+export namespace startup {
+    void enable();
+
+    // 是否通过 --trace-startup 开启了启动报告
+    bool isEnabled();
+
+    void phase(const char* name);
+
+    // 记录一个不属于原生启动阶段的时间点，例如脚本开始检测剧情，它包括了等待游戏进程和窗口的时间
+    // 单独输出距离启动和距离最后一个阶段的时间，不影响阶段的耗时
+    void milestone(const char* name);
+
+    // 距离程序启动的时间 (ms)
+    auto sinceLaunchMs() -> double;
+
+    // 每个阶段的耗时和距离启动的时间，每个阶段一行；时间点在最后，耗时为距离最后一个阶段的时间
+    auto report() -> std::string;
+}
+
+
+struct Phase {
+    const char* name;
+    std::chrono::steady_clock::time_point end;
+};
+
+struct StartupTrace {
+    std::chrono::steady_clock::time_point launchTime = std::chrono::steady_clock::now();
+    std::vector<Phase> phases {};
+    std::vector<Phase> milestones {};
+    bool enabled = false;
+};
+
+StartupTrace startupTrace;
+
+
+void startup::enable() {
+    startupTrace.enabled = true;
+}
+
+
+bool startup::isEnabled() {
+    return startupTrace.enabled;
+}
+
+
+void startup::phase(const char* name) {
+    startupTrace.phases.push_back({ name, std::chrono::steady_clock::now() });
+}
+
+
+void startup::milestone(const char* name) {
+    startupTrace.milestones.push_back({ name, std::chrono::steady_clock::now() });
+}
+
+
+auto startup::sinceLaunchMs() -> double {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTrace.launchTime).count();
+}
+
+
+auto startup::report() -> std::string {
+    std::string result = "启动耗时:";
+    auto last = startupTrace.launchTime;
+
+    for (const Phase& phase: startupTrace.phases) {
+        double duration = std::chrono::duration<double, std::milli>(phase.end - last).count();
+        double total = std::chrono::duration<double, std::milli>(phase.end - startupTrace.launchTime).count();
+        last = phase.end;
+
+        char line[128];
+        snprintf(line, sizeof(line), "\n  %-20s %9.2f ms  (%9.2f ms)", phase.name, duration, total);
+        result += line;
+    }
+
+    if (!startupTrace.milestones.empty())
+        result += "\n脚本 (包括等待游戏的时间):";
+
+    for (const Phase& milestone: startupTrace.milestones) {
+        double sinceLastPhase = std::chrono::duration<double, std::milli>(milestone.end - last).count();
+        double total = std::chrono::duration<double, std::milli>(milestone.end - startupTrace.launchTime).count();
+
+        char line[128];
+        snprintf(line, sizeof(line), "\n  %-20s %9.2f ms  (%9.2f ms)", milestone.name, sinceLastPhase, total);
+        result += line;
+    }
+
+    return result;
+}
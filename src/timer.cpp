@@ -0,0 +1,142 @@
+module;
+
+#include <chrono>
+#include <queue>
+#include <vector>
+#include <optional>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+
+export module timer;
+
+
+// 事件循环的时钟和计时器队列，不依赖 quickjs，可以单独用模拟的事件循环测试计时器的执行顺序
+export namespace timer {
+    // 事件循环使用的时钟，计时器、sleep 和 Date.now 都从这里取时间
+    // 一帧的耗时和看门狗始终使用真实时间
+    class Clock {
+    public:
+        using time_point = std::chrono::steady_clock::time_point;
+
+        virtual ~Clock() = default;
+
+        virtual auto now() -> time_point = 0;
+
+        // 距离 1970-01-01 00:00:00 UTC 的毫秒数，用于 Date.now
+        virtual auto epochMs() -> double = 0;
+
+        virtual void sleepUntil(time_point time) = 0;
+
+        void sleepFor(std::chrono::nanoseconds duration) { sleepUntil(now() + duration); }
+    };
+
+    // 真实时间，sleep 时阻塞当前线程
+    class SystemClock : public Clock {
+    public:
+        auto now() -> time_point override;
+        auto epochMs() -> double override;
+        void sleepUntil(time_point time) override;
+    };
+
+    // 虚拟时间，从 startEpochMs 开始，sleep 时不等待，直接把时间推进到目标时间
+    // 事件循环空闲时直接跳到下一个计时器的到期时间，脚本的运行结果与机器的快慢无关
+    class VirtualClock : public Clock {
+    public:
+        VirtualClock(double startEpochMs = 0);
+
+        auto now() -> time_point override { return current; }
+        auto epochMs() -> double override;
+        void sleepUntil(time_point time) override;
+
+    private:
+        time_point current {};
+        double startEpochMs;
+    };
+
+    // 计时器队列，value 为计时器的回调
+    // 到期时间相同的计时器按添加的顺序执行
+    template <typename T>
+    class Queue {
+    public:
+        struct Timer {
+            uint32_t id;
+            Clock::time_point timeout;
+            T value;
+
+            bool operator < (const Timer& other) const {
+                return timeout != other.timeout ? timeout > other.timeout : id > other.id;
+            }
+        };
+
+        // 返回计时器的编号
+        auto push(Clock::time_point timeout, T value) -> uint32_t {
+            uint32_t id = nextId++;
+            timers.push({ id, timeout, std::move(value) });
+            return id;
+        }
+
+        bool empty() const { return timers.empty(); }
+
+        auto size() const -> size_t { return timers.size(); }
+
+        // 最早的到期时间，队列为空时不能调用
+        auto nextTimeout() const -> Clock::time_point { return timers.top().timeout; }
+
+        // 取出一个在 now 之前到期的计时器，回调中可能会添加新的计时器，所以先从队列中取出再执行
+        auto popDue(Clock::time_point now) -> std::optional<Timer> {
+            if(timers.empty() || now < timers.top().timeout)
+                return std::nullopt;
+            Timer timer = timers.top();
+            timers.pop();
+            return timer;
+        }
+
+        // 删除 remove(value) 返回 true 的计时器，其它计时器的顺序不变
+        template <typename Predicate>
+        void removeIf(Predicate remove) {
+            std::vector<Timer> kept;
+            while(!timers.empty()) {
+                Timer timer = timers.top();
+                timers.pop();
+                if(!remove(timer.value))
+                    kept.push_back(std::move(timer));
+            }
+            for(Timer& timer: kept)
+                timers.push(std::move(timer));
+        }
+
+    private:
+        std::priority_queue<Timer> timers {};
+        uint32_t nextId = 0;
+    };
+}
+
+
+auto timer::SystemClock::now() -> time_point {
+    return std::chrono::steady_clock::now();
+}
+
+
+auto timer::SystemClock::epochMs() -> double {
+    return std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+void timer::SystemClock::sleepUntil(time_point time) {
+    std::this_thread::sleep_until(time);
+}
+
+
+timer::VirtualClock::VirtualClock(double startEpochMs) : startEpochMs(startEpochMs) {}
+
+
+auto timer::VirtualClock::epochMs() -> double {
+    return startEpochMs + std::chrono::duration<double, std::milli>(current.time_since_epoch()).count();
+}
+
+
+// 时间只会向前推进
+void timer::VirtualClock::sleepUntil(time_point time) {
+    current = std::max(current, time);
+}
@@ -0,0 +1,283 @@
+module;
+
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+export module trace;
+
+
+// 性能追踪，导出为 Chrome Trace Event 格式的 JSON，可以在 chrome://tracing 或 https://ui.perfetto.dev 中打开
+// 每个线程把事件写入自己的环形缓冲区，写入时只读取时间和复制指针，不做格式化；缓冲区写满后覆盖最旧的事件
+// 事件的名称和类别只保存指针，必须是字符串字面量或者 intern 返回的字符串
+export namespace trace {
+    // 每个线程的缓冲区在这个线程第一次记录事件时分配，已经分配的缓冲区大小不变
+    void enable(size_t eventsPerThread = 65536);
+
+    void disable();
+
+    bool isEnabled();
+
+    // 距离开始计时的纳秒数
+    auto now() -> int64_t;
+
+    // 从 start 到现在的范围事件
+    void complete(const char* name, const char* category, int64_t start);
+
+    void instant(const char* name, const char* category);
+
+    // 当前线程在追踪中显示的名称
+    void setThreadName(std::string_view name);
+
+    // 返回的字符串直到程序退出都有效
+    auto intern(std::string_view text) -> const char*;
+
+    // 写入所有线程缓冲区中的事件，不清空缓冲区，可以多次导出
+    auto exportJson(const std::filesystem::path& path) -> bool;
+
+    // 记录的事件数、被覆盖的事件数、线程数
+    auto stats();
+
+    // 作用域内的范围事件，name 为 nullptr 或者没有开启追踪时不记录
+    class Span {
+    public:
+        Span(const char* name, const char* category = "native"): name(name), category(category), start(name && isEnabled() ? now() : -1) {}
+
+        ~Span() {
+            if (start >= 0)
+                complete(name, category, start);
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* name;
+        const char* category;
+        int64_t start;
+    };
+}
+
+
+struct Event {
+    const char* name;
+    const char* category;
+    int64_t start;
+    int64_t duration;
+    char phase;         // 'X' 范围事件，'i' 瞬时事件
+};
+
+// 只有所属的线程写入，导出时由导出的线程读取，两者用自旋锁互斥；写入时几乎不会竞争
+struct ThreadBuffer {
+    std::atomic_flag busy {};
+    std::vector<Event> events {};
+    size_t written = 0;
+    uint32_t id = 0;
+    std::string name {};
+
+    void lock() { while (busy.test_and_set(std::memory_order_acquire)); }
+    void unlock() { busy.clear(std::memory_order_release); }
+};
+
+struct TraceState {
+    std::atomic<bool> enabled = false;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    // 线程退出后缓冲区仍然保留，用于导出
+    std::mutex mutex;
+    size_t eventsPerThread = 65536;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers {};
+    std::unordered_set<std::string> strings {};
+};
+
+TraceState traceState;
+
+
+auto currentBuffer() -> ThreadBuffer& {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+        std::lock_guard lock(traceState.mutex);
+
+        auto created = std::make_shared<ThreadBuffer>();
+        created->id = static_cast<uint32_t>(traceState.buffers.size() + 1);
+        created->name = "thread " + std::to_string(created->id);
+        traceState.buffers.push_back(created);
+        return created;
+    }();
+
+    return *buffer;
+}
+
+
+void record(const Event& event) {
+    ThreadBuffer& buffer = currentBuffer();
+
+    // 只设置过线程名称的缓冲区还没有分配
+    if (buffer.events.empty()) {
+        size_t eventsPerThread;
+        {
+            std::lock_guard lock(traceState.mutex);
+            eventsPerThread = std::max<size_t>(traceState.eventsPerThread, 1);
+        }
+        buffer.lock();
+        buffer.events.resize(eventsPerThread);
+        buffer.unlock();
+    }
+
+    buffer.lock();
+    buffer.events[buffer.written % buffer.events.size()] = event;
+    buffer.written++;
+    buffer.unlock();
+}
+
+
+void trace::enable(size_t eventsPerThread) {
+    {
+        std::lock_guard lock(traceState.mutex);
+        traceState.eventsPerThread = eventsPerThread;
+    }
+    traceState.enabled.store(true, std::memory_order_relaxed);
+}
+
+
+void trace::disable() {
+    traceState.enabled.store(false, std::memory_order_relaxed);
+}
+
+
+bool trace::isEnabled() {
+    return traceState.enabled.load(std::memory_order_relaxed);
+}
+
+
+auto trace::now() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceState.epoch).count();
+}
+
+
+void trace::complete(const char* name, const char* category, int64_t start) {
+    if (!isEnabled())
+        return;
+    record({ name, category, start, now() - start, 'X' });
+}
+
+
+void trace::instant(const char* name, const char* category) {
+    if (!isEnabled())
+        return;
+    record({ name, category, now(), 0, 'i' });
+}
+
+
+void trace::setThreadName(std::string_view name) {
+    ThreadBuffer& buffer = currentBuffer();
+    buffer.lock();
+    buffer.name = name;
+    buffer.unlock();
+}
+
+
+auto trace::intern(std::string_view text) -> const char* {
+    std::lock_guard lock(traceState.mutex);
+    return traceState.strings.emplace(text).first->c_str();
+}
+
+
+// JSON 字符串，包括两边的引号
+void writeString(FILE* file, std::string_view text) {
+    fputc('"', file);
+    for (char c: text) {
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (static_cast<unsigned char>(c) < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+
+auto trace::exportJson(const std::filesystem::path& path) -> bool {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard lock(traceState.mutex);
+        buffers = traceState.buffers;
+    }
+
+    std::error_code ec;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+    FILE* file = fopen(path.string().c_str(), "wb");
+    if (!file)
+        return false;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GenshinAutoV2\"}}", file);
+
+    std::vector<Event> events;
+    for (const std::shared_ptr<ThreadBuffer>& buffer: buffers) {
+        // 按写入的顺序复制出来，持有自旋锁的时间尽量短
+        buffer->lock();
+        size_t capacity = buffer->events.size();
+        size_t count = std::min(buffer->written, capacity);
+        size_t first = buffer->written - count;
+        events.resize(count);
+        for (size_t i = 0; i < count; i++)
+            events[i] = buffer->events[(first + i) % capacity];
+        std::string name = buffer->name;
+        buffer->unlock();
+
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", buffer->id);
+        writeString(file, name);
+        fputs("}}", file);
+
+        for (const Event& event: events) {
+            fputs(",\n{\"name\":", file);
+            writeString(file, event.name);
+            fputs(",\"cat\":", file);
+            writeString(file, event.category);
+            fprintf(file, ",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", event.phase, buffer->id, event.start / 1000.0);
+            if (event.phase == 'X')
+                fprintf(file, ",\"dur\":%.3f}", event.duration / 1000.0);
+            else fputs(",\"s\":\"t\"}", file);
+        }
+    }
+
+    fputs("\n]}\n", file);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+
+auto trace::stats() {
+    double events = 0, overwritten = 0, threads = 0;
+    {
+        std::lock_guard lock(traceState.mutex);
+        for (const std::shared_ptr<ThreadBuffer>& buffer: traceState.buffers) {
+            buffer->lock();
+            events += static_cast<double>(buffer->written);
+            overwritten += static_cast<double>(buffer->written - std::min(buffer->written, buffer->events.size()));
+            buffer->unlock();
+        }
+        threads = static_cast<double>(traceState.buffers.size());
+    }
+
+    return std::make_tuple(
+        std::make_pair("events", events),
+        std::make_pair("overwritten", overwritten),
+        std::make_pair("threads", threads)
+    );
+}
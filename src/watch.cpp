@@ -0,0 +1,249 @@
+module;
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+export module watch;
+
+
+// 监视目录中文件的修改，用于修改脚本后重新加载
+// Windows 上使用 ReadDirectoryChangesW (重叠 I/O)，其它系统上使用 inotify，两者都在 poll 中非阻塞地读取事件
+export namespace watch {
+    class Watcher {
+    public:
+        // 监视 dir 及其子目录中扩展名为 extension 的文件，extension 为空时监视所有文件
+        Watcher(const std::filesystem::path& dir, std::string extension = "", int quietMs = 50);
+
+        ~Watcher();
+
+        auto isValid() const -> bool { return valid; }
+
+        // 返回上次返回之后被修改、新建或者重命名得到的文件，路径相对于 dir，使用 / 分隔，同一个文件只返回一次
+        // 最后一次修改后 quietMs 内没有新的修改时才返回，编辑器保存一次产生的多个事件合并为一次
+        // 系统的事件缓冲区溢出时返回的列表中包含一个空字符串，表示不确定哪些文件被修改
+        auto poll() -> std::vector<std::string>;
+
+        Watcher(const Watcher&) = delete;
+        Watcher& operator=(const Watcher&) = delete;
+
+    private:
+        std::filesystem::path dir;
+        std::string extension;
+        std::chrono::milliseconds quiet;
+        bool valid = false;
+
+        std::set<std::string> pending {};
+        std::chrono::steady_clock::time_point lastChange {};
+
+        void addChange(const std::string& path);
+
+        // 读取系统中已经产生的所有事件，放入 pending
+        void readEvents();
+
+#ifdef _WIN32
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped {};
+        alignas(DWORD) char buffer[64 * 1024];
+
+        auto issue() -> bool;
+#else
+        int fd = -1;
+        std::unordered_map<int, std::string> directories {};    // inotify 的 watch descriptor -> 相对于 dir 的目录
+
+        void addDirectory(const std::string& relative);
+#endif
+    };
+}
+
+
+void watch::Watcher::addChange(const std::string& path) {
+    if(!path.empty() && !extension.empty() && !path.ends_with(extension))
+        return;
+
+    pending.insert(path);
+    lastChange = std::chrono::steady_clock::now();
+}
+
+
+auto watch::Watcher::poll() -> std::vector<std::string> {
+    if(valid)
+        readEvents();
+
+    if(pending.empty() || std::chrono::steady_clock::now() - lastChange < quiet)
+        return {};
+
+    std::vector<std::string> changes(pending.begin(), pending.end());
+    pending.clear();
+    return changes;
+}
+
+
+#ifdef _WIN32
+
+watch::Watcher::Watcher(const std::filesystem::path& dir, std::string extension, int quietMs)
+    : dir(dir), extension(std::move(extension)), quiet(quietMs) {
+    handle = CreateFileW(dir.wstring().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if(handle == INVALID_HANDLE_VALUE)
+        return;
+
+    overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    valid = overlapped.hEvent && issue();
+}
+
+
+watch::Watcher::~Watcher() {
+    if(handle == INVALID_HANDLE_VALUE)
+        return;
+
+    // 取消还没有完成的读取，并等待取消完成，之后才能释放 buffer
+    if(valid) {
+        DWORD bytes = 0;
+        CancelIoEx(handle, &overlapped);
+        GetOverlappedResult(handle, &overlapped, &bytes, TRUE);
+    }
+
+    if(overlapped.hEvent)
+        CloseHandle(overlapped.hEvent);
+    CloseHandle(handle);
+}
+
+
+auto watch::Watcher::issue() -> bool {
+    return ReadDirectoryChangesW(handle, buffer, sizeof(buffer), TRUE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &overlapped, nullptr);
+}
+
+
+void watch::Watcher::readEvents() {
+    DWORD bytes = 0;
+    while(GetOverlappedResult(handle, &overlapped, &bytes, FALSE)) {
+        // 读取到 0 字节表示缓冲区溢出，事件已经丢失
+        if(bytes == 0)
+            addChange("");
+
+        for(DWORD offset = 0; bytes > 0;) {
+            auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer + offset);
+            if(info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+                std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                addChange(std::filesystem::path(name).generic_string());
+            }
+
+            if(info->NextEntryOffset == 0)
+                break;
+            offset += info->NextEntryOffset;
+        }
+
+        if(!issue()) {
+            valid = false;
+            return;
+        }
+    }
+
+    if(GetLastError() != ERROR_IO_INCOMPLETE)
+        valid = false;
+}
+
+#else
+
+watch::Watcher::Watcher(const std::filesystem::path& dir, std::string extension, int quietMs)
+    : dir(dir), extension(std::move(extension)), quiet(quietMs) {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0)
+        return;
+
+    addDirectory("");
+    valid = !directories.empty();
+}
+
+
+watch::Watcher::~Watcher() {
+    if(fd >= 0)
+        close(fd);
+}
+
+
+// inotify 不能递归监视，每个子目录单独添加，之后新建的子目录在 readEvents 中添加
+void watch::Watcher::addDirectory(const std::string& relative) {
+    std::filesystem::path path = relative.empty() ? dir : dir / relative;
+    int wd = inotify_add_watch(fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if(wd < 0)
+        return;
+    directories[wd] = relative;
+
+    std::error_code ec;
+    for(const auto& entry: std::filesystem::directory_iterator(path, std::filesystem::directory_options::skip_permission_denied, ec)) {
+        if(entry.is_directory(ec) && !entry.is_symlink(ec))
+            addDirectory((std::filesystem::path(relative) / entry.path().filename()).generic_string());
+    }
+}
+
+
+void watch::Watcher::readEvents() {
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    while(true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if(length <= 0) {
+            if(length < 0 && errno != EAGAIN && errno != EINTR)
+                valid = false;
+            return;
+        }
+
+        for(ssize_t offset = 0; offset < length;) {
+            auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW) {
+                addChange("");
+                continue;
+            }
+
+            // 目录被删除或者移走后 watch descriptor 自动失效
+            if(event->mask & IN_IGNORED) {
+                directories.erase(event->wd);
+                continue;
+            }
+
+            auto it = directories.find(event->wd);
+            if(it == directories.end() || event->len == 0)
+                continue;
+
+            std::string path = (std::filesystem::path(it->second) / event->name).generic_string();
+
+            // 新建或者移入的子目录中可能已经有文件
+            if(event->mask & IN_ISDIR) {
+                if(event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addDirectory(path);
+                    std::error_code ec;
+                    for(const auto& entry: std::filesystem::recursive_directory_iterator(dir / path, std::filesystem::directory_options::skip_permission_denied, ec)) {
+                        if(entry.is_regular_file(ec))
+                            addChange(std::filesystem::relative(entry.path(), dir, ec).generic_string());
+                    }
+                }
+                continue;
+            }
+
+            // 只有 IN_CREATE 时文件还没有写完，等待之后的 IN_CLOSE_WRITE
+            if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                addChange(path);
+        }
+    }
+}
+
+#endif
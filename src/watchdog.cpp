@@ -0,0 +1,172 @@
+module;
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+export module watchdog;
+
+
+// 事件循环的看门狗
+// 后台线程定期检查当前这一帧已经执行的时间，超过预算时标记为卡顿，并记录正在执行的原生函数
+// 脚本引擎执行 JS 代码时定期调用 interrupt，检查卡顿标记，由调用者记录 JS 的调用栈，并且可以中断这一帧的任务
+// 不依赖 quickjs，原生函数的类型由模板参数 Binding 指定，可以单独用模拟的事件循环测试
+export namespace watchdog {
+    // 一帧的执行时间超过看门狗的预算时生成的报告
+    struct StallReport {
+        double durationMs;      // 这一帧的总耗时
+        std::string binding;    // 检测到卡顿时正在执行的原生函数，为空表示正在执行 JS 代码
+        std::string stack;      // 检测到卡顿后第一次回到 JS 代码时的调用栈
+        bool aborted;           // 这一帧的任务是否被中断
+    };
+
+    // interrupt 的结果
+    enum class Interrupt {
+        None,           // 没有卡顿，或者这一帧已经处理过
+        CaptureStack,   // 刚刚检测到卡顿，记录调用栈后继续执行
+        Abort,          // 刚刚检测到卡顿，记录调用栈后中断这一帧的任务
+    };
+
+    template <typename Binding>
+    struct Watchdog {
+        // 还没有卡顿过的帧序号，与任何一帧都不相等
+        static constexpr uint64_t noTick = std::numeric_limits<uint64_t>::max();
+
+        // 以下由 JS 线程写入，后台线程读取
+        std::atomic<uint64_t> tick = 0;
+        std::atomic<int64_t> tickStart = 0;     // 这一帧开始的时间 (steady_clock 纳秒)，0 表示空闲
+        std::atomic<Binding> currentBinding = nullptr;
+
+        // 由后台线程写入，值为卡顿的那一帧的序号
+        std::atomic<uint64_t> stalledTick = noTick;
+        std::atomic<Binding> stalledBinding = nullptr;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        bool stopping = false;
+        std::chrono::nanoseconds budget {};
+        bool abortOnStall = false;
+
+        // 以下只由 JS 线程访问
+        bool stackCaptured = false;
+        bool aborted = false;
+        std::string stack {};
+        double stalls = 0;
+        double worstTickMs = 0;
+        StallReport lastStall {};
+
+        // budgetMs 小于等于 0 时关闭看门狗
+        void start(double budgetMs, bool abort);
+        void stop();
+
+        void beginTick();
+
+        // 一帧结束时调用，这一帧卡顿时返回 true 并填写 report 中除 binding 以外的部分
+        bool endTick(double tickMs, StallReport& report);
+
+        // 只有正在执行的帧才可能卡顿，空闲时和第一帧开始之前都不算
+        bool isStalled() const {
+            return tickStart.load(std::memory_order_acquire) != 0
+                && stalledTick.load(std::memory_order_acquire) == tick.load(std::memory_order_relaxed);
+        }
+
+        // 在 JS 线程的中断回调中调用，每个卡顿的帧只返回一次 CaptureStack 或 Abort
+        auto interrupt() -> Interrupt;
+
+        ~Watchdog() { stop(); }
+    };
+}
+
+
+template <typename Binding>
+void watchdog::Watchdog<Binding>::start(double budgetMs, bool abort) {
+    stop();
+    if(budgetMs <= 0)
+        return;
+
+    budget = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>(budgetMs));
+    abortOnStall = abort;
+    stopping = false;
+
+    thread = std::thread([this]() {
+        std::unique_lock lock(mutex);
+
+        while(!stopping) {
+            wakeup.wait_for(lock, budget / 4);
+
+            // 前后两次读取的帧序号不同时，说明读取 tickStart 期间切换到了下一帧，跳过这次检查
+            uint64_t currentTick = tick.load(std::memory_order_acquire);
+            int64_t start = tickStart.load(std::memory_order_acquire);
+            if(start == 0 || currentTick != tick.load(std::memory_order_acquire) || stalledTick.load(std::memory_order_relaxed) == currentTick)
+                continue;
+
+            auto now = std::chrono::steady_clock::now().time_since_epoch();
+            if(now - std::chrono::nanoseconds(start) > budget) {
+                stalledBinding.store(currentBinding.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                stalledTick.store(currentTick, std::memory_order_release);
+            }
+        }
+    });
+}
+
+
+template <typename Binding>
+void watchdog::Watchdog<Binding>::stop() {
+    if(!thread.joinable())
+        return;
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    thread.join();
+}
+
+
+template <typename Binding>
+void watchdog::Watchdog<Binding>::beginTick() {
+    tick.fetch_add(1, std::memory_order_release);
+    tickStart.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+    stackCaptured = false;
+    aborted = false;
+    stack.clear();
+}
+
+
+template <typename Binding>
+bool watchdog::Watchdog<Binding>::endTick(double tickMs, StallReport& report) {
+    bool stalled = isStalled();
+    tickStart.store(0, std::memory_order_release);
+    worstTickMs = std::max(worstTickMs, tickMs);
+
+    if(!stalled)
+        return false;
+
+    stalls++;
+    report.durationMs = tickMs;
+    report.stack = stack;
+    report.aborted = aborted;
+    return true;
+}
+
+
+template <typename Binding>
+auto watchdog::Watchdog<Binding>::interrupt() -> Interrupt {
+    if(stackCaptured || !isStalled())
+        return Interrupt::None;
+    stackCaptured = true;
+
+    if(!abortOnStall)
+        return Interrupt::CaptureStack;
+
+    aborted = true;
+    return Interrupt::Abort;
+}
@@ -4,31 +4,60 @@ module;
 #define NOMINMAX
 
 #include <filesystem>
+#include <fstream>
 #include <tuple>
 #include <utility>
 #include <algorithm>
 #include <cstddef>
 #include <cmath>
 #include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <mutex>
+#include <atomic>
 #include <Windows.h>
 #include <tlhelp32.h>
 
 export module win;
 
+import frame;
+import eventlog;
+import geometry;
+
 
 export namespace win {
-    auto loadResourceToFile(WORD resourceId, std::filesystem::path filepath) -> bool;
+    auto loadResourceToFile(WORD resourceId, std::filesystem::path filepath, bool overwrite = false) -> bool;
     auto getPid(const char* processName) -> DWORD;
     auto getHwnd(DWORD pid) -> HWND;
     auto getBaseDir() -> std::filesystem::path;
     auto getWndSize(HWND hwnd);
     auto captureWindow(HWND hwnd, std::tuple<int, int, int, int> area);
     auto saveBitmapImage(const char* savepath, std::byte* data, int width, int height, int step) -> bool;
+
+    // 每一帧 (tick) 的截图缓存：同一帧内对同一区域的多次读取只截图一次
+    // 每个窗口的缓存是独立的，多目标模式下不同的线程可以同时读取各自窗口的缓存
+    void addFrameRegion(HWND hwnd, std::tuple<int, int, int, int> area);
+    void clearFrameRegions(HWND hwnd);
+    auto getFramePixel(HWND hwnd, int x, int y) -> COLORREF;
+    auto captureFrame(HWND hwnd, std::tuple<int, int, int, int> area);
+    void invalidateFrameCache();
+    void invalidateFrameCache(HWND hwnd);
+    auto frameCacheStats();
+
+    // 跟踪窗口的大小和 DPI，被跟踪的窗口截图时使用缓存的大小，不再每次查询
+    void trackWindow(HWND hwnd);
+    void untrackWindow(HWND hwnd);
+
+    // 检查被跟踪的窗口大小和 DPI 是否变化，返回 { changed, width, height, dpi }
+    // 变化时清除这个窗口在本帧中的截图缓存
+    auto validateWindow(HWND hwnd);
 }
 
 
 // 从程序资源中加载数据，并且写入文件
-bool win::loadResourceToFile(WORD resourceId, std::filesystem::path filepath) {
+// overwrite 为 false 时不覆盖已经存在的文件；为 true 时文件的内容与资源不同才覆盖，原来的文件改名为 .bak 保留
+bool win::loadResourceToFile(WORD resourceId, std::filesystem::path filepath, bool overwrite) {
     HRSRC hResource = FindResource(NULL, MAKEINTRESOURCE(resourceId), RT_RCDATA); 
     if(!hResource)
         return false;
@@ -39,7 +68,21 @@ bool win::loadResourceToFile(WORD resourceId, std::filesystem::path filepath) {
 
     UnlockResource(hGlobal);
 
-    HANDLE hFile = CreateFileW(filepath.wstring().c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    std::error_code ec;
+    if(overwrite && std::filesystem::exists(filepath, ec)) {
+        if(std::filesystem::file_size(filepath, ec) == dwSize) {
+            std::ifstream file(filepath, std::ios::binary);
+            std::vector<std::byte> content(dwSize);
+            if(file.read(reinterpret_cast<char*>(content.data()), dwSize) && memcmp(content.data(), data, dwSize) == 0)
+                return true;
+        }
+
+        std::filesystem::path backup = filepath;
+        backup += ".bak";
+        std::filesystem::rename(filepath, backup, ec);
+    }
+
+    HANDLE hFile = CreateFileW(filepath.wstring().c_str(), GENERIC_WRITE, 0, NULL, overwrite ? CREATE_ALWAYS : CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
     if(hFile == INVALID_HANDLE_VALUE)
         return false;
     
@@ -128,88 +171,368 @@ auto win::getBaseDir() -> std::filesystem::path {
 }
 
 
-auto win::captureWindow(HWND hwnd, std::tuple<int, int, int, int> area) {
+// 截图用的内存DC和位图，只在需要更大的位图时重新创建，在多次截图之间复用
+struct CaptureSurface {
+    HDC hdc_mem = nullptr;
+    HBITMAP hbmp = nullptr;
+    HGDIOBJ hbmp_old = nullptr;
+    void* pixels_data = nullptr;
+    int width = 0;
+    int height = 0;
+
+    void release() {
+        if (hdc_mem) {
+            SelectObject(hdc_mem, hbmp_old);
+            DeleteObject(hbmp);
+            DeleteDC(hdc_mem);
+        }
+        *this = CaptureSurface();
+    }
+
+    // 确保位图至少为 width x height，失败时返回 false
+    bool prepare(HDC hdc_window, int _width, int _height) {
+        if (hdc_mem && width >= _width && height >= _height)
+            return true;
+
+        _width = std::max(_width, width);
+        _height = std::max(_height, height);
+        release();
+
+        // 创建一个与窗口DC兼容的内存DC
+        hdc_mem = CreateCompatibleDC(hdc_window);
+        if (!hdc_mem)
+            return false;
+
+        // 创建一个兼容的位图 (DIB Section) 以便直接访问像素数据
+        BITMAPINFO bi;
+        ZeroMemory(&bi, sizeof(BITMAPINFO));
+        bi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bi.bmiHeader.biWidth = _width;
+        bi.bmiHeader.biHeight = -_height; // 负值表示顶-底DIB，数据从左上角开始，与OpenCV布局一致
+        bi.bmiHeader.biPlanes = 1;
+        bi.bmiHeader.biBitCount = 32; // 32位，BGRA
+        bi.bmiHeader.biCompression = BI_RGB;
+
+        hbmp = CreateDIBSection(hdc_mem, &bi, DIB_RGB_COLORS, &pixels_data, NULL, 0);
+        if (!hbmp || !pixels_data) {
+            DeleteDC(hdc_mem);
+            *this = CaptureSurface();
+            return false;
+        }
+
+        // 将位图选入内存DC，并保存旧的位图
+        hbmp_old = SelectObject(hdc_mem, hbmp);
+        width = _width;
+        height = _height;
+        return true;
+    }
+
+    ~CaptureSurface() { release(); }
+};
+
+thread_local CaptureSurface captureSurface;
+
+
+// 窗口客户区中实际截取的区域
+struct CaptureRect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool contains(int left, int top, int right, int bottom) const {
+        return left >= x && top >= y && right <= x + width && bottom <= y + height;
+    }
+};
+
+
+// 被跟踪的窗口
+struct WindowTrackers {
+    std::mutex mutex;
+    std::unordered_map<HWND, geometry::Tracker> trackers {};
+};
+
+WindowTrackers windowTrackers;
+
+
+// 窗口客户区的大小，被跟踪的窗口直接使用缓存
+std::pair<int, int> windowSize(HWND hwnd) {
+    {
+        std::lock_guard lock(windowTrackers.mutex);
+        auto it = windowTrackers.trackers.find(hwnd);
+        if (it != windowTrackers.trackers.end())
+            return { it->second.current().width, it->second.current().height };
+    }
+
+    auto wndSize = win::getWndSize(hwnd);
+    return { std::get<0>(wndSize).second, std::get<1>(wndSize).second };
+}
+
+
+// 将 [left, top, right, bottom) 限制在窗口客户区内
+CaptureRect clampCaptureRect(HWND hwnd, const std::tuple<int, int, int, int>& area) {
+    auto& [left, top, right, bottom] = area;
+    auto [wndWidth, wndHeight] = windowSize(hwnd);
+
+    CaptureRect rect;
+    rect.x = std::max(left, 0);
+    rect.y = std::max(top, 0);
+    rect.width = std::max(std::min(right, wndWidth) - rect.x, 0);
+    rect.height = std::max(std::min(bottom, wndHeight) - rect.y, 0);
+    return rect;
+}
+
+
+// 截取窗口客户区中的 rect 区域，BGRA 像素数据逐行写入 dst，每行 rect.width * 4 字节
+bool captureRect(HWND hwnd, const CaptureRect& rect, std::byte* dst) {
+    if (rect.width <= 0 || rect.height <= 0)
+        return false;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    HDC hdc_window = GetDC(hwnd);
+    if (!hdc_window)
+        return false;
+
+    if (!captureSurface.prepare(hdc_window, rect.width, rect.height)) {
+        ReleaseDC(hwnd, hdc_window);
+        return false;
+    }
+
+    // 使用 BitBlt 将窗口内容复制到内存DC（进而复制到位图）
+    // 从窗口客户区的 (rect.x, rect.y) 开始，复制 rect.width x rect.height 的内容到内存DC的 (0, 0) 位置
+    BitBlt(captureSurface.hdc_mem, 0, 0, rect.width, rect.height, hdc_window, rect.x, rect.y, SRCCOPY);
+    ReleaseDC(hwnd, hdc_window);
+
+    // 位图可能比截取的区域大，需要逐行复制
+    const std::byte* src = reinterpret_cast<const std::byte*>(captureSurface.pixels_data);
+    size_t srcStep = static_cast<size_t>(captureSurface.width) * 4;
+    size_t dstStep = static_cast<size_t>(rect.width) * 4;
+    for (int y = 0; y < rect.height; y++)
+        memcpy(dst + y * dstStep, src + y * srcStep, dstStep);
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    eventlog::write(eventlog::Type::Capture, 0, elapsedMs, static_cast<double>(rect.width) * rect.height);
+    return true;
+}
+
+
+// 将 BGRA 数据中 [x, y, width, height] 的部分复制到帧缓冲池的缓冲区中，转换为 JS 的图像对象
+auto makeImage(const std::byte* src, int srcStep, int x, int y, int width, int height) {
     auto image = std::make_tuple(
         std::make_pair("width", 0),
         std::make_pair("height", 0),
         std::make_pair("channels", 0),
         std::make_pair("step", 0),
-        std::make_pair("data", std::pair<std::byte*, size_t>(nullptr, 0))
+        std::make_pair("data", frame::Buffer { nullptr, 0 })
     );
 
+    if (!src || width <= 0 || height <= 0)
+        return image;
+
+    size_t step = static_cast<size_t>(width) * 4;
+    frame::Buffer buffer = frame::acquire(step * height);
+    for (int row = 0; row < height; row++)
+        memcpy(buffer.data + row * step, src + static_cast<size_t>(y + row) * srcStep + x * 4, step);
+
+    std::get<0>(image).second = width;
+    std::get<1>(image).second = height;
+    std::get<2>(image).second = 4; // BGRA
+    std::get<3>(image).second = static_cast<int>(step);
+    std::get<4>(image).second = buffer;
+    return image;
+}
+
+
+auto win::captureWindow(HWND hwnd, std::tuple<int, int, int, int> area) {
     auto& [left, top, right, bottom] = area;
-    int width = right - left;
-    int height = bottom - top;
+    CaptureRect rect;
 
-    if (!IsWindow(hwnd) || width <= 0 || height <= 0)
-        return image;
+    if (IsWindow(hwnd) && right > left && bottom > top)
+        rect = clampCaptureRect(hwnd, area);
 
-    HDC hdc_window = GetDC(hwnd);
-    if (!hdc_window)
-        return image;
+    if (rect.width <= 0 || rect.height <= 0)
+        return makeImage(nullptr, 0, 0, 0, 0, 0);
 
-    auto wndSize = win::getWndSize(hwnd);
-    auto& wndWidth = std::get<0>(wndSize).second;
-    auto& wndHeight = std::get<1>(wndSize).second;
+    // 像素数据直接截取到帧缓冲池中的缓冲区，ArrayBuffer 被释放时缓冲区会归还到池中
+    auto image = makeImage(nullptr, 0, 0, 0, 0, 0);
+    size_t step = static_cast<size_t>(rect.width) * 4;
+    frame::Buffer buffer = frame::acquire(step * rect.height);
 
-    int capture_x = std::max(left, 0);
-    int capture_y = std::max(top, 0);
-    int capture_width = (left + width > wndWidth) ? (wndWidth - capture_x) : width;
-    int capture_height = (top + height > wndHeight) ? (wndHeight - capture_y) : height;
-    
-    if (capture_width <= 0 || capture_height <= 0) {
-        ReleaseDC(hwnd, hdc_window);
+    if (!captureRect(hwnd, rect, buffer.data)) {
+        frame::release(buffer.data, buffer.size);
         return image;
     }
-    
-    // 创建一个与窗口DC兼容的内存DC
-    HDC hdc_mem = CreateCompatibleDC(hdc_window);
-    if (!hdc_mem) {
-        ReleaseDC(hwnd, hdc_window);
-        return image;
+
+    std::get<0>(image).second = rect.width;
+    std::get<1>(image).second = rect.height;
+    std::get<2>(image).second = 4; // BGRA
+    std::get<3>(image).second = static_cast<int>(step);
+    std::get<4>(image).second = buffer;
+    return image;
+}
+
+
+// 截图缓存中的一块区域，tick 与当前帧序号不同时说明需要重新截图
+struct CachedRegion {
+    std::tuple<int, int, int, int> area;
+    bool persistent;
+    CaptureRect rect {};
+    std::vector<std::byte> pixels {};
+    unsigned tick = 0;
+};
+
+// 一个窗口的截图缓存，只由使用这个窗口的目标访问
+struct WindowFrames {
+    std::vector<CachedRegion> regions {};
+    unsigned tick = 1;
+};
+
+// mutex 只保护 windows 本身，unordered_map 中的元素地址不会因为插入其它窗口而改变
+struct FrameCache {
+    std::mutex mutex;
+    std::unordered_map<HWND, WindowFrames> windows {};
+    std::atomic<uint64_t> reads = 0;
+    std::atomic<uint64_t> hits = 0;
+    std::atomic<uint64_t> captures = 0;
+};
+
+FrameCache frameCache;
+
+
+WindowFrames& windowFrames(HWND hwnd) {
+    std::lock_guard lock(frameCache.mutex);
+    return frameCache.windows[hwnd];
+}
+
+
+// 找到包含 [left, top, right, bottom) 的缓存区域，并确保它在本帧中已经截图
+// 没有注册的区域包含这次读取时，使用截取整个客户区的临时区域，每个窗口最多一个，在一帧中没有被使用时删除
+// 读取的位置超出客户区时 (例如窗口缩小后还没有重新换算坐标) 也使用临时区域，由调用者裁剪；完全在客户区之外时不截图，返回 nullptr
+CachedRegion* findFrameRegion(HWND hwnd, int left, int top, int right, int bottom) {
+    frameCache.reads.fetch_add(1, std::memory_order_relaxed);
+    WindowFrames& frames = windowFrames(hwnd);
+    auto& regions = frames.regions;
+
+    auto it = std::find_if(regions.begin(), regions.end(), [&](const CachedRegion& region) {
+        auto& [l, t, r, b] = region.area;
+        return left >= l && top >= t && right <= r && bottom <= b;
+    });
+
+    if (it == regions.end()) {
+        auto [wndWidth, wndHeight] = windowSize(hwnd);
+        if (left >= right || top >= bottom || right <= 0 || bottom <= 0 || left >= wndWidth || top >= wndHeight)
+            return nullptr;
+
+        std::tuple<int, int, int, int> client { 0, 0, wndWidth, wndHeight };
+        it = std::find_if(regions.begin(), regions.end(), [](const CachedRegion& region) { return !region.persistent; });
+        if (it == regions.end()) {
+            regions.push_back({ client, false });
+            it = regions.end() - 1;
+        }
+
+        // 窗口大小变化后临时区域不再是整个客户区，需要重新截图
+        else if (it->area != client) {
+            it->area = client;
+            it->tick = 0;
+        }
     }
 
-    // 创建一个兼容的位图 (DIB Section) 以便直接访问像素数据
-    BITMAPINFO bi;
-    ZeroMemory(&bi, sizeof(BITMAPINFO));
-    bi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bi.bmiHeader.biWidth = capture_width;
-    bi.bmiHeader.biHeight = -capture_height; // 负值表示顶-底DIB，数据从左上角开始，与OpenCV布局一致
-    bi.bmiHeader.biPlanes = 1;
-    bi.bmiHeader.biBitCount = 32; // 32位，BGRA
-    bi.bmiHeader.biCompression = BI_RGB;
-
-    void* pixels_data = NULL;
-    HBITMAP hbmp = CreateDIBSection(hdc_mem, &bi, DIB_RGB_COLORS, &pixels_data, NULL, 0);
-    if (!hbmp || !pixels_data) {
-        DeleteDC(hdc_mem);
-        ReleaseDC(hwnd, hdc_window);
-        return image;
+    CachedRegion& region = *it;
+
+    if (region.tick == frames.tick) {
+        frameCache.hits.fetch_add(1, std::memory_order_relaxed);
+        return &region;
     }
 
-    // 将位图选入内存DC，并保存旧的位图
-    HGDIOBJ hbmp_old = SelectObject(hdc_mem, hbmp);
+    frameCache.captures.fetch_add(1, std::memory_order_relaxed);
+    region.tick = frames.tick;
+    region.rect = clampCaptureRect(hwnd, region.area);
+    region.pixels.resize(static_cast<size_t>(region.rect.width) * region.rect.height * 4);
 
-    // 使用 BitBlt 将窗口内容复制到内存DC（进而复制到位图）
-    // 从窗口客户区的 (capture_x, capture_y) 开始，复制 capture_width x capture_height 的内容到内存DC的 (0, 0) 位置
-    BitBlt(hdc_mem, 0, 0, capture_width, capture_height, hdc_window, capture_x, capture_y, SRCCOPY);
+    if (!captureRect(hwnd, region.rect, region.pixels.data()))
+        region.rect = CaptureRect();
 
-    std::get<0>(image).second = capture_width;
-    std::get<1>(image).second = capture_height;
-    std::get<2>(image).second = 4; // BGRA
-    std::get<3>(image).second = capture_width * 4;
-    std::get<4>(image).second.first = new std::byte[capture_width * capture_height * 4];
-    std::get<4>(image).second.second = capture_width * capture_height * 4;
+    return &region;
+}
 
-    memcpy(std::get<4>(image).second.first, pixels_data, capture_width * capture_height * 4);
 
-    // 清理GDI资源
-    SelectObject(hdc_mem, hbmp_old);
-    DeleteObject(hbmp);
-    DeleteDC(hdc_mem);
-    ReleaseDC(hwnd, hdc_window);
+void win::addFrameRegion(HWND hwnd, std::tuple<int, int, int, int> area) {
+    windowFrames(hwnd).regions.push_back({ area, true });
+}
 
-    return image;
+
+void win::clearFrameRegions(HWND hwnd) {
+    std::lock_guard lock(frameCache.mutex);
+    frameCache.windows.erase(hwnd);
+}
+
+
+// 从本帧的截图中读取像素，返回值与 GetPixel 相同 (0x00BBGGRR)，超出窗口范围时返回 CLR_INVALID
+auto win::getFramePixel(HWND hwnd, int x, int y) -> COLORREF {
+    CachedRegion* region = findFrameRegion(hwnd, x, y, x + 1, y + 1);
+    if (!region || !region->rect.contains(x, y, x + 1, y + 1))
+        return 0xFFFFFFFF;
+
+    const CaptureRect& rect = region->rect;
+
+    const uint8_t* pixel = reinterpret_cast<const uint8_t*>(region->pixels.data()) + ((y - rect.y) * rect.width + (x - rect.x)) * 4;
+    return pixel[2] | (pixel[1] << 8) | (pixel[0] << 16);
+}
+
+
+// 与 captureWindow 相同，但是在同一帧内从缓存中取图像
+auto win::captureFrame(HWND hwnd, std::tuple<int, int, int, int> area) {
+    auto& [left, top, right, bottom] = area;
+    CachedRegion* region = findFrameRegion(hwnd, left, top, right, bottom);
+    if (!region)
+        return makeImage(nullptr, 0, 0, 0, 0, 0);
+
+    const CaptureRect& rect = region->rect;
+    int x = std::max(left, rect.x);
+    int y = std::max(top, rect.y);
+    int width = std::min(right, rect.x + rect.width) - x;
+    int height = std::min(bottom, rect.y + rect.height) - y;
+
+    return makeImage(region->pixels.data(), rect.width * 4, x - rect.x, y - rect.y, width, height);
+}
+
+
+void invalidateWindowFrames(WindowFrames& frames) {
+    std::erase_if(frames.regions, [&](const CachedRegion& region) {
+        return !region.persistent && region.tick != frames.tick;
+    });
+    frames.tick++;
+}
+
+
+// 一帧结束时调用，下一次读取时重新截图
+void win::invalidateFrameCache() {
+    std::lock_guard lock(frameCache.mutex);
+    for (auto& [hwnd, frames]: frameCache.windows)
+        invalidateWindowFrames(frames);
+}
+
+
+// 多目标模式下每个目标的一帧结束时只清除自己窗口的缓存
+void win::invalidateFrameCache(HWND hwnd) {
+    std::unique_lock lock(frameCache.mutex);
+    auto it = frameCache.windows.find(hwnd);
+    if (it == frameCache.windows.end())
+        return;
+    lock.unlock();
+
+    invalidateWindowFrames(it->second);
+}
+
+
+// reads: 读取次数，hits: 直接从缓存中读取的次数 (即节省的截图次数)，captures: 实际截图的次数
+auto win::frameCacheStats() {
+    return std::make_tuple(
+        std::make_pair("reads", static_cast<double>(frameCache.reads.load(std::memory_order_relaxed))),
+        std::make_pair("hits", static_cast<double>(frameCache.hits.load(std::memory_order_relaxed))),
+        std::make_pair("captures", static_cast<double>(frameCache.captures.load(std::memory_order_relaxed)))
+    );
 }
 
 
@@ -249,4 +572,56 @@ bool win::saveBitmapImage(const char* savepath, std::byte* data, int width, int
 
     CloseHandle(hFile);
     return true;
+}
+
+
+void win::trackWindow(HWND hwnd) {
+    std::lock_guard lock(windowTrackers.mutex);
+    windowTrackers.trackers.try_emplace(hwnd, [hwnd](geometry::WindowGeometry& geometry) {
+        if (!IsWindow(hwnd))
+            return false;
+
+        RECT rect;
+        if (!GetClientRect(hwnd, &rect))
+            return false;
+
+        // 与 getWndSize 的换算方式相同
+        geometry.dpi = GetDpiForWindow(hwnd);
+        geometry.width = std::lround((rect.right - rect.left) * (geometry.dpi / 96.0));
+        geometry.height = std::lround((rect.bottom - rect.top) * (geometry.dpi / 96.0));
+        return true;
+    });
+}
+
+
+void win::untrackWindow(HWND hwnd) {
+    std::lock_guard lock(windowTrackers.mutex);
+    windowTrackers.trackers.erase(hwnd);
+}
+
+
+auto win::validateWindow(HWND hwnd) {
+    bool changed = false;
+    geometry::WindowGeometry current;
+
+    {
+        std::lock_guard lock(windowTrackers.mutex);
+        auto it = windowTrackers.trackers.find(hwnd);
+        if (it != windowTrackers.trackers.end()) {
+            changed = it->second.validate();
+            current = it->second.current();
+        }
+    }
+
+    if (changed) {
+        for (CachedRegion& region: windowFrames(hwnd).regions)
+            region.tick = 0;
+    }
+
+    return std::make_tuple(
+        std::make_pair("changed", changed),
+        std::make_pair("width", current.width),
+        std::make_pair("height", current.height),
+        std::make_pair("dpi", current.dpi)
+    );
 }
\ No newline at end of file
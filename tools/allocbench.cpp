@@ -0,0 +1,254 @@
+// quickjs 内存池的性能测试工具，与 malloc 对比吞吐量和常驻内存
+//   allocbench [operations] [liveObjects] [seed]
+// 模拟 quickjs 运行时的分配模式: 同时存活 liveObjects 个对象 (默认 200000)，每次操作释放一个随机的对象再分配一个新的，
+// 大小大多在 16 ~ 128 字节 (对象、shape、字符串)，少量到 512 字节，2% 为更大的数组和缓冲区，其中一部分通过 realloc 增长
+// 先用内存池再用 malloc 执行相同的 operations 次操作 (默认 10000000)，输出每次操作的耗时，
+// 以及存活对象最多时进程常驻内存 (RSS) 的增长和全部释放后剩余的增长 (内存池在全部释放后 trim，与 GC 之后相同)；
+// 最后检查 trim 后内存页全部归还，以及在不同线程上使用同一个内存池时统计数据是否正确
+// 两种分配器在各自的子进程中运行，RSS 互不影响；Windows 上在同一个进程中依次运行，malloc 可能复用内存池释放的大内存块
+
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+import allocator;
+
+
+// 当前进程的常驻内存 (字节)
+auto residentBytes() -> size_t {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters {};
+    K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.WorkingSetSize;
+#else
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    int read = fscanf(file, "%lu %lu", &size, &resident);
+    fclose(file);
+    return read == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+
+// 一次操作: 释放 slot 中的对象 (grow 为 true 时改为 realloc 到 size)，或者分配 size 字节
+struct Operation {
+    uint32_t slot;
+    uint32_t size;
+    bool grow;
+};
+
+auto randomSize(std::mt19937& random) -> uint32_t {
+    int bucket = std::uniform_int_distribution<int>(0, 99)(random);
+    if (bucket < 70)
+        return std::uniform_int_distribution<uint32_t>(16, 128)(random);
+    if (bucket < 90)
+        return std::uniform_int_distribution<uint32_t>(129, 256)(random);
+    if (bucket < 98)
+        return std::uniform_int_distribution<uint32_t>(257, 512)(random);
+    return std::uniform_int_distribution<uint32_t>(513, 8192)(random);
+}
+
+
+struct Result {
+    double nsPerOperation;
+    size_t peakRss;
+    size_t remainingRss;
+    double pageBytes;       // 内存池向系统申请的内存页
+    double peakBytes;       // 内存池中同时使用的最大字节数
+    bool leaked;
+};
+
+// 全部释放后调用 trim，再测量剩余的常驻内存
+auto run(const std::vector<Operation>& operations, size_t liveObjects,
+    const std::function<void*(size_t)>& allocate, const std::function<void(void*)>& deallocate,
+    const std::function<void*(void*, size_t)>& reallocate, const std::function<void()>& trim) -> Result {
+    std::vector<void*> slots(liveObjects, nullptr);
+    size_t baseline = residentBytes();
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Operation& operation: operations) {
+        void*& slot = slots[operation.slot];
+        if (operation.grow && slot)
+            slot = reallocate(slot, operation.size);
+        else {
+            deallocate(slot);
+            slot = allocate(operation.size);
+        }
+        // 与 quickjs 一样写入对象的头部
+        if (slot)
+            memset(slot, 0xAB, 16);
+    }
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    size_t peak = residentBytes();
+    for (void*& slot: slots) {
+        deallocate(slot);
+        slot = nullptr;
+    }
+    trim();
+    size_t remaining = residentBytes();
+
+    return {
+        .nsPerOperation = elapsedNs / operations.size(),
+        .peakRss = peak - baseline,
+        .remainingRss = remaining > baseline ? remaining - baseline : 0,
+        .pageBytes = 0,
+        .peakBytes = 0,
+        .leaked = false,
+    };
+}
+
+
+auto runPool(const std::vector<Operation>& operations, size_t liveObjects) -> Result {
+    allocator::Pool pool;
+    Result result = run(operations, liveObjects, 
+        [&](size_t size) { return pool.allocate(size); }, 
+        [&](void* ptr) { pool.deallocate(ptr); }, 
+        [&](void* ptr, size_t size) { return pool.reallocate(ptr, size); },
+        [&]() { pool.trim(); });
+    auto [liveBytes, peakBytes, reservedBytes, fragmentation] = pool.stats();
+    // 全部释放后大内存块已经还给 malloc，trim 之后内存页也应该全部归还
+    result.pageBytes = reservedBytes.second;
+    result.peakBytes = peakBytes.second;
+    result.leaked = liveBytes.second != 0 || reservedBytes.second != 0;
+    return result;
+}
+
+
+auto runMalloc(const std::vector<Operation>& operations, size_t liveObjects) -> Result {
+    return run(operations, liveObjects, malloc, free, realloc, []() {});
+}
+
+
+// 与多目标模式中的运行时一样，在一个线程上分配、在另一个线程上释放，统计数据应该回到 0
+auto crossThread() -> bool {
+    allocator::Pool pool;
+    std::vector<void*> blocks;
+    std::thread([&]() {
+        for (size_t size = 16; size <= 4096; size += 16)
+            blocks.push_back(pool.allocate(size));
+    }).join();
+    std::thread([&]() {
+        for (void* block: blocks)
+            pool.deallocate(block);
+    }).join();
+    return pool.liveBytes() == 0;
+}
+
+
+// 释放先分配的一半内存块后 trim: 应该释放空闲的内存页，剩下的内存块内容不变，之后还能继续分配
+auto partialTrim() -> bool {
+    allocator::Pool pool;
+    std::vector<void*> blocks;
+    for (int i = 0; i < 20000; i++) {
+        blocks.push_back(pool.allocate(32));
+        memset(blocks.back(), i & 0xFF, 32);
+    }
+    for (int i = 0; i < 10000; i++)
+        pool.deallocate(blocks[i]);
+
+    size_t released = pool.trim();
+    bool intact = true;
+    for (int i = 10000; i < 20000; i++)
+        intact = intact && static_cast<unsigned char*>(blocks[i])[31] == (i & 0xFF);
+
+    void* block = pool.allocate(32);
+    bool reused = block != nullptr && pool.liveBytes() == 10001 * 32;
+    pool.deallocate(block);
+    for (int i = 10000; i < 20000; i++)
+        pool.deallocate(blocks[i]);
+
+    auto [liveBytes, peakBytes, reservedBytes, fragmentation] = pool.stats();
+    bool empty = pool.trim() > 0 && reservedBytes.second > 0 && std::get<2>(pool.stats()).second == 0;
+    printf("  释放一半后 trim 归还 %.1f KiB: %s\n", released / 1024.0, released > 0 && intact && reused && empty ? "通过" : "失败");
+    return released > 0 && intact && reused && empty;
+}
+
+
+// 在子进程中运行，通过管道取回结果
+auto isolated(const std::function<Result()>& func) -> Result {
+#ifdef _WIN32
+    return func();
+#else
+    int fds[2];
+    if (pipe(fds) != 0)
+        return func();
+
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        Result result = func();
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    Result result {};
+    ssize_t received = child > 0 ? read(fds[0], &result, sizeof(result)) : 0;
+    close(fds[0]);
+    if (child > 0)
+        waitpid(child, nullptr, 0);
+    return received == sizeof(result) ? result : func();
+#endif
+}
+
+
+int main(int argc, char* argv[]) {
+    long long count = argc >= 2 ? atoll(argv[1]) : 10000000;
+    long long live = argc >= 3 ? atoll(argv[2]) : 200000;
+    uint32_t seed = argc >= 4 ? static_cast<uint32_t>(atoi(argv[3])) : 42;
+
+    if (count <= 0 || live <= 0) {
+        fprintf(stderr, "用法:\n  allocbench [operations] [liveObjects] [seed]\n");
+        return 1;
+    }
+
+    // 先生成操作序列，两种分配器执行完全相同的操作
+    std::mt19937 random(seed);
+    std::vector<Operation> operations(static_cast<size_t>(count));
+    std::uniform_int_distribution<uint32_t> slotDistribution(0, static_cast<uint32_t>(live - 1));
+    for (Operation& operation: operations) {
+        operation.slot = slotDistribution(random);
+        operation.grow = std::uniform_int_distribution<int>(0, 19)(random) == 0;
+        operation.size = randomSize(random);
+    }
+
+    auto mib = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+
+    size_t liveObjects = static_cast<size_t>(live);
+    Result pool = isolated([&]() { return runPool(operations, liveObjects); });
+    Result system = isolated([&]() { return runMalloc(operations, liveObjects); });
+
+    printf("%lld 次操作, 同时存活 %lld 个对象\n", count, live);
+    printf("  内存池: %6.1f ns/次, 峰值 RSS 增长 %7.1f MiB, 全部释放并 trim 后 %7.1f MiB (峰值使用 %.1f MiB, 剩余内存页 %.1f MiB)\n",
+        pool.nsPerOperation, mib(pool.peakRss), mib(pool.remainingRss), mib(static_cast<size_t>(pool.peakBytes)), mib(static_cast<size_t>(pool.pageBytes)));
+    printf("  malloc: %6.1f ns/次, 峰值 RSS 增长 %7.1f MiB, 全部释放后 %7.1f MiB\n",
+        system.nsPerOperation, mib(system.peakRss), mib(system.remainingRss));
+    printf("  内存池的耗时为 malloc 的 %.2f 倍, 峰值 RSS 为 malloc 的 %.2f 倍\n",
+        pool.nsPerOperation / system.nsPerOperation, static_cast<double>(pool.peakRss) / std::max<size_t>(system.peakRss, 1));
+
+    bool trimmed = partialTrim();
+
+    bool consistent = crossThread();
+    printf("  跨线程分配和释放后正在使用的字节数%s\n", consistent ? "为 0" : "不为 0");
+
+    return pool.leaked || !trimmed || !consistent ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+// 连通区域检测的测试工具，使用合成的图像
+//   blobs [width] [height] [iterations]
+// 在带噪声的灰色背景上画出网格排列的彩色圆形 (以及颜色接近但超出容差的干扰圆形)，
+// 检查找到的区域数量和重心是否正确，并输出每次检测的平均耗时
+
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+import image;
+
+
+struct Circle {
+    int x, y, radius;
+    bool target;
+};
+
+
+int main(int argc, char* argv[]) {
+    int width = argc >= 2 ? atoi(argv[1]) : 1920;
+    int height = argc >= 3 ? atoi(argv[2]) : 1080;
+    int iterations = argc >= 4 ? atoi(argv[3]) : 50;
+
+    if (width < 64 || height < 64 || iterations <= 0) {
+        fprintf(stderr, "用法:\n  blobs [width] [height] [iterations]\n");
+        return 1;
+    }
+
+    constexpr uint32_t color = 236 | (229 << 8) | (216 << 16);
+    constexpr int tolerance = 12;
+
+    int step = width * 4;
+    std::vector<std::byte> pixels(static_cast<size_t>(step) * height);
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> noise(60, 120);
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        uint8_t gray = static_cast<uint8_t>(noise(random));
+        pixels[i] = pixels[i + 1] = pixels[i + 2] = std::byte { gray };
+        pixels[i + 3] = std::byte { 255 };
+    }
+
+    // 每个格子中画一个圆，交替使用目标颜色和超出容差的颜色
+    std::vector<Circle> circles;
+    for (int y = 32; y + 32 <= height; y += 64) {
+        for (int x = 32; x + 32 <= width; x += 64)
+            circles.push_back({ x, y, 8 + static_cast<int>(circles.size() % 16), circles.size() % 3 != 2 });
+    }
+
+    for (const Circle& circle: circles) {
+        int b = (color >> 16) & 0xFF, g = (color >> 8) & 0xFF, r = color & 0xFF;
+        int shift = circle.target ? 0 : tolerance + 8;
+
+        for (int dy = -circle.radius; dy <= circle.radius; dy++) {
+            for (int dx = -circle.radius; dx <= circle.radius; dx++) {
+                if (dx * dx + dy * dy > circle.radius * circle.radius)
+                    continue;
+                std::byte* pixel = pixels.data() + static_cast<size_t>(circle.y + dy) * step + (circle.x + dx) * 4;
+                pixel[0] = std::byte(static_cast<uint8_t>(b - shift));
+                pixel[1] = std::byte(static_cast<uint8_t>(g));
+                pixel[2] = std::byte(static_cast<uint8_t>(r));
+            }
+        }
+    }
+
+    image::ColorPredicate predicate(color, tolerance);
+    std::vector<image::Blob> blobs = image::labelBlobs(pixels.data(), width, height, step, predicate, 16);
+
+    // 每个目标圆形都应该有一个包含圆心的区域，重心与圆心重合
+    size_t expected = 0;
+    double maxError = 0;
+    for (const Circle& circle: circles) {
+        if (!circle.target)
+            continue;
+        expected++;
+
+        auto it = std::find_if(blobs.begin(), blobs.end(), [&](const image::Blob& blob) {
+            return circle.x >= blob.left && circle.x < blob.right && circle.y >= blob.top && circle.y < blob.bottom;
+        });
+        maxError = it == blobs.end() ? INFINITY : std::max({ maxError, std::abs(it->centerX - circle.x), std::abs(it->centerY - circle.y) });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        blobs = image::labelBlobs(pixels.data(), width, height, step, predicate, 16);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%d x %d: 找到 %zu 个区域 (应为 %zu 个), 重心最大误差 %.3f 像素\n", width, height, blobs.size(), expected, maxError);
+    printf("平均 %.3f ms/次, %.2f 像素/ns\n", elapsedMs / iterations, static_cast<double>(width) * height * iterations / (elapsedMs * 1e6));
+    return blobs.size() == expected && maxError < 0.5 ? 0 : 1;
+}
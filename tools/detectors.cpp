@@ -0,0 +1,204 @@
+// 多模板检测的测试工具，使用合成的图像
+//   detectors [width] [height] [iterations]
+// 生成 64 个带纹理的模板，其中一半画在由随机颜色方块组成、带噪声的背景上，
+// 分别用 1, 2, 4, ... 64 个模板的模板组扫描同一张图像，检查画上去的模板是否都在正确的位置找到，
+// 并与逐个模板完整匹配的耗时对比，模板组每个模板分摊的耗时应随模板数量下降
+// 依次测试两组模板: 只有两种大小，以及 64 个模板的大小各不相同；最后输出 64 个模板与 1 个模板的耗时之比
+
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+import detector;
+
+
+struct Image {
+    int width, height;
+    std::vector<std::byte> pixels;
+
+    int step() const { return width * 4; }
+    uint8_t* at(int x, int y) { return reinterpret_cast<uint8_t*>(pixels.data()) + (static_cast<size_t>(y) * width + x) * 4; }
+};
+
+
+// 纯色底上随机排列的 4 x 4 色块，色块比底色亮或暗 48，每个模板的底色和色块都不同
+Image makeTemplate(int width, int height, std::mt19937& random) {
+    Image image { width, height, std::vector<std::byte>(static_cast<size_t>(width) * height * 4) };
+    std::uniform_int_distribution<int> channel(48, 207);
+    int base[3] = { channel(random), channel(random), channel(random) };
+    uint64_t patches = static_cast<uint64_t>(random()) << 32 | random();
+    int shift = random() % 2 ? 48 : -48;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* pixel = image.at(x, y);
+            bool patch = patches >> (y / 4 * (width / 4) + x / 4) % 64 & 1;
+            for (int c = 0; c < 3; c++)
+                pixel[c] = static_cast<uint8_t>(patch ? base[c] + shift : base[c]);
+            pixel[3] = 255;
+        }
+    }
+    return image;
+}
+
+
+// 逐个模板、逐个位置完整匹配，差值超过上限时提前结束
+size_t naiveScan(Image& frame, std::vector<Image>& templates, size_t count, double minScore) {
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+        Image& tmpl = templates[i];
+        int64_t budget = static_cast<int64_t>((1 - minScore) * 255 * 3 * tmpl.width * tmpl.height);
+
+        for (int y = 0; y + tmpl.height <= frame.height; y++) {
+            for (int x = 0; x + tmpl.width <= frame.width; x++) {
+                int64_t difference = 0;
+                for (int row = 0; row < tmpl.height && difference <= budget; row++) {
+                    const uint8_t* pixel = frame.at(x, y + row);
+                    const uint8_t* expected = tmpl.at(0, row);
+                    for (int col = 0; col < tmpl.width; col++, pixel += 4, expected += 4)
+                        difference += std::abs(pixel[0] - expected[0]) + std::abs(pixel[1] - expected[1]) + std::abs(pixel[2] - expected[2]);
+                }
+                hits += difference <= budget;
+            }
+        }
+    }
+    return hits;
+}
+
+
+struct Placement { size_t index; int x, y; };
+
+
+// 背景: 16 x 16 的随机颜色方块，加上噪声；偶数编号的模板按 40 x 40 的格子画在图像中，奇数编号的模板不出现
+auto makeFrame(int width, int height, std::vector<Image>& templates, std::mt19937& random, std::vector<Placement>& placements) -> Image {
+    Image frame { width, height, std::vector<std::byte>(static_cast<size_t>(width) * height * 4) };
+    std::uniform_int_distribution<int> channel(0, 255), noise(-12, 12);
+    std::vector<int> blocks(static_cast<size_t>((width + 15) / 16) * ((height + 15) / 16) * 3);
+    for (int& value: blocks)
+        value = channel(random);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* pixel = frame.at(x, y);
+            const int* block = blocks.data() + (static_cast<size_t>(y / 16) * ((width + 15) / 16) + x / 16) * 3;
+            for (int c = 0; c < 3; c++)
+                pixel[c] = static_cast<uint8_t>(std::clamp(block[c] + noise(random), 0, 255));
+            pixel[3] = 255;
+        }
+    }
+
+    int columns = (width - 8) / 40;
+    for (size_t i = 0; i < templates.size(); i += 2) {
+        int cell = static_cast<int>(placements.size());
+        if ((cell / columns + 1) * 40 + 8 > height)
+            break;
+
+        Placement placement { i, 8 + cell % columns * 40, 8 + cell / columns * 40 };
+        for (int y = 0; y < templates[i].height; y++)
+            std::copy_n(templates[i].at(0, y), templates[i].width * 4, frame.at(placement.x, placement.y + y));
+        placements.push_back(placement);
+    }
+    return frame;
+}
+
+
+// 用 1, 2, 4, ... 个模板的模板组扫描，检查结果并输出耗时，返回 64 个模板与 1 个模板的耗时之比
+auto benchmark(int width, int height, int iterations, std::vector<Image>& templates, std::mt19937& random, bool& ok) -> double {
+    constexpr double minScore = 0.95;
+
+    std::vector<Placement> placements;
+    Image frame = makeFrame(width, height, templates, random, placements);
+
+    auto measure = [&](const std::function<void()>& run) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            run();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    printf("%d x %d, 放置 %zu 个模板\n", width, height, placements.size());
+    printf("  模板数   模板组 ms  每个模板 ms   逐个匹配 ms  每个模板 ms   候选/位置  平均颜色通过  采样点通过\n");
+
+    double firstMs = 0, lastMs = 0;
+    for (size_t count = 1; count <= templates.size(); count *= 2) {
+        detector::Bank bank;
+        for (size_t i = 0; i < count; i++)
+            bank.add(templates[i].pixels.data(), templates[i].width, templates[i].height, templates[i].step());
+
+        detector::Options options;
+        options.minScore = minScore;
+
+        std::vector<std::vector<detector::Hit>> hits = bank.scan(frame.pixels.data(), width, height, frame.step(), options);
+
+        // 放置的模板在正确的位置找到，且只找到一次；未放置的模板没有结果
+        for (size_t i = 0; i < count; i++) {
+            auto placement = std::find_if(placements.begin(), placements.end(), [&](const Placement& p) { return p.index == i; });
+            bool found = placement == placements.end()
+                ? hits[i].empty()
+                : hits[i].size() == 1 && hits[i][0].x == placement->x && hits[i][0].y == placement->y;
+            if (!found) {
+                printf("  模板 %zu 的结果错误: %zu 个结果\n", i, hits[i].size());
+                ok = false;
+            }
+        }
+
+        const detector::ScanStats& stats = bank.lastStats();
+        double bankMs = measure([&]() { bank.scan(frame.pixels.data(), width, height, frame.step(), options); });
+
+        // 逐个匹配的耗时与模板数量成正比，只执行一次
+        auto start = std::chrono::steady_clock::now();
+        size_t naiveHits = naiveScan(frame, templates, count, minScore);
+        double naiveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // 逐个匹配不去除重叠的位置，结果不少于放置的模板数
+        ok = ok && naiveHits >= static_cast<size_t>(std::count_if(placements.begin(), placements.end(), [&](const Placement& p) { return p.index < count; }));
+
+        printf("  %6zu  %10.3f  %11.4f  %12.3f  %11.4f  %10.4f  %12.0f  %10.0f\n", count, bankMs, bankMs / count, naiveMs, naiveMs / count,
+            stats.meanChecks / stats.positions, stats.meanPassed, stats.samplePassed);
+
+        if (count == 1)
+            firstMs = bankMs;
+        lastMs = bankMs;
+    }
+
+    return lastMs / firstMs;
+}
+
+
+int main(int argc, char* argv[]) {
+    int width = argc >= 2 ? atoi(argv[1]) : 640;
+    int height = argc >= 3 ? atoi(argv[2]) : 360;
+    int iterations = argc >= 4 ? atoi(argv[3]) : 10;
+
+    if (width < 320 || height < 160 || iterations <= 0) {
+        fprintf(stderr, "用法:\n  detectors [width] [height] [iterations]\n");
+        return 1;
+    }
+
+    constexpr size_t templateCount = 64;
+    bool ok = true;
+
+    std::mt19937 random(42);
+    std::vector<Image> twoSizes, distinctSizes;
+    for (size_t i = 0; i < templateCount; i++)
+        twoSizes.push_back(i % 2 == 0 ? makeTemplate(24, 24, random) : makeTemplate(32, 16, random));
+
+    // 宽 16 ~ 30、高 12 ~ 26，每个模板的大小都不同
+    for (size_t i = 0; i < templateCount; i++)
+        distinctSizes.push_back(makeTemplate(16 + static_cast<int>(i % 8) * 2, 12 + static_cast<int>(i / 8) * 2, random));
+
+    printf("两种大小的模板\n");
+    double twoSizesRatio = benchmark(width, height, iterations, twoSizes, random, ok);
+
+    printf("\n大小各不相同的模板\n");
+    double distinctRatio = benchmark(width, height, iterations, distinctSizes, random, ok);
+
+    printf("\n%zu 个模板的耗时为 1 个模板的: 两种大小 %.2f 倍, 大小各不相同 %.2f 倍\n", templateCount, twoSizesRatio, distinctRatio);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+// 事件日志工具
+//   eventlog text  <events.bin>                 以文本格式输出日志
+//   eventlog csv   <events.bin>                 以 CSV 格式输出日志
+//   eventlog bench [threads] [eventsPerThread]  测量每条记录的写入开销，并读回日志检查带有文本的记录是否完整
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+import eventlog;
+
+
+// CSV 字段中的引号需要转义
+std::string csvQuote(const std::string& text) {
+    std::string result = "\"";
+    for (char c: text) {
+        if (c == '"')
+            result += '"';
+        result += c;
+    }
+    return result + '"';
+}
+
+
+// 依次读取日志中的记录，字符串定义和记录后面的文本已经还原为 message
+bool readLog(const char* path, const std::function<void(const eventlog::FileHeader&, const eventlog::Record&, const std::string&)>& callback) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        fprintf(stderr, "无法打开文件 '%s'\n", path);
+        return false;
+    }
+
+    eventlog::FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.magic, eventlog::magic, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "'%s' 不是事件日志文件\n", path);
+        return false;
+    }
+
+    // 版本 1 的记录后面没有文本，其他格式相同
+    if (header.version == 0 || header.version > eventlog::version || header.recordSize != sizeof(eventlog::Record)) {
+        fprintf(stderr, "不支持的日志版本 %u\n", header.version);
+        return false;
+    }
+
+    auto readText = [&](size_t length) {
+        std::string text(eventlog::textRecords(length) * sizeof(eventlog::Record), '\0');
+        file.read(text.data(), text.size());
+        text.resize(length);
+        return text;
+    };
+
+    std::unordered_map<uint32_t, std::string> strings;
+
+    for (eventlog::Record record; file.read(reinterpret_cast<char*>(&record), sizeof(record)); ) {
+        if (record.type == eventlog::Type::String) {
+            strings[record.message] = readText(static_cast<size_t>(record.values[0]));
+            continue;
+        }
+
+        if (record.message & eventlog::inlineText)
+            callback(header, record, readText(record.message & ~eventlog::inlineText));
+        else callback(header, record, record.message ? strings[record.message] : "");
+    }
+
+    return true;
+}
+
+
+int decode(const char* path, bool csv) {
+    if (csv)
+        printf("time,thread,type,message,value0,value1\n");
+
+    bool ok = readLog(path, [&](const eventlog::FileHeader& header, const eventlog::Record& record, const std::string& message) {
+        // 记录的时间 = 文件头中的开始时间 + 偏移
+        int64_t time = header.startTime + record.time;
+        std::time_t seconds = time / 1000000000;
+        std::tm local = *std::localtime(&seconds);
+
+        char timeText[32];
+        size_t length = strftime(timeText, sizeof(timeText), "%Y-%m-%d %H:%M:%S", &local);
+        snprintf(timeText + length, sizeof(timeText) - length, ".%06lld", static_cast<long long>(time % 1000000000 / 1000));
+
+        if (csv)
+            printf("%s,%u,%s,%s,%g,%g\n", timeText, record.thread, eventlog::typeName(record.type), csvQuote(message).c_str(), record.values[0], record.values[1]);
+        else printf("[%s] #%u %-9s %s %g %g\n", timeText, record.thread, eventlog::typeName(record.type), message.c_str(), record.values[0], record.values[1]);
+    });
+
+    return ok ? 0 : 1;
+}
+
+
+// 多个线程同时写入记录，统计每条记录的平均耗时
+// 每个线程分批写入，批次之间等待后台线程清空队列，等待的时间不计入耗时；队列满时丢弃的记录数会在结果中输出
+// 每一批的最后写入一条带有文本的记录，文本的长度各不相同，最后读回日志检查这些文本没有和其他记录交错
+int bench(int threads, int eventsPerThread) {
+    constexpr int batchSize = 512;
+
+    auto textFor = [](int thread, int n) {
+        return "thread " + std::to_string(thread) + " event " + std::to_string(n) + " " + std::string(static_cast<size_t>(n / batchSize % 97), '.');
+    };
+
+    auto dir = std::filesystem::temp_directory_path() / "eventlog-bench";
+    if (!eventlog::open(dir, 64 * 1024 * 1024, 1, 1)) {
+        fprintf(stderr, "无法创建日志文件\n");
+        return 1;
+    }
+
+    uint32_t message = eventlog::intern("bench");
+
+    std::vector<std::thread> workers;
+    std::vector<double> results(threads);
+
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&, i]() {
+            std::chrono::steady_clock::duration elapsed {};
+
+            for (int n = 0; n < eventsPerThread; ) {
+                auto start = std::chrono::steady_clock::now();
+                for (int end = std::min(n + batchSize, eventsPerThread); n < end; n++)
+                    eventlog::write(eventlog::Type::Message, message, n, i);
+                elapsed += std::chrono::steady_clock::now() - start;
+
+                eventlog::writeText(eventlog::Type::Message, textFor(i, n), n, i);
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+
+            results[i] = std::chrono::duration<double, std::nano>(elapsed).count() / eventsPerThread;
+        });
+    }
+
+    for (auto& worker: workers)
+        worker.join();
+
+    eventlog::close();
+
+    auto [written, dropped, flushedBytes] = eventlog::stats();
+    for (int i = 0; i < threads; i++)
+        printf("线程 %d: %.1f ns/条\n", i, results[i]);
+    printf("写入 %.0f 条，丢弃 %.0f 条，文件 %.0f 字节\n", written.second, dropped.second, flushedBytes.second);
+
+    int texts = 0, corrupted = 0, records = 0;
+    bool ok = readLog((dir / "events.bin").string().c_str(), [&](const eventlog::FileHeader&, const eventlog::Record& record, const std::string& message) {
+        records++;
+        if (!(record.message & eventlog::inlineText)) {
+            corrupted += record.type != eventlog::Type::Message || message != "bench";
+            return;
+        }
+        texts++;
+        corrupted += message != textFor(static_cast<int>(record.values[1]), static_cast<int>(record.values[0]));
+    });
+    printf("读回 %d 条记录，其中 %d 条带有文本，%d 条不完整\n", records, texts, corrupted);
+
+    std::filesystem::remove_all(dir);
+    return ok && corrupted == 0 ? 0 : 1;
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "text") == 0)
+        return decode(argv[2], false);
+
+    if (argc >= 3 && strcmp(argv[1], "csv") == 0)
+        return decode(argv[2], true);
+
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+        return bench(argc >= 3 ? atoi(argv[2]) : 4, argc >= 4 ? atoi(argv[3]) : 200000);
+
+    fprintf(stderr, "用法:\n  eventlog text <events.bin>\n  eventlog csv <events.bin>\n  eventlog bench [threads] [eventsPerThread]\n");
+    return 1;
+}
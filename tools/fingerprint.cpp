@@ -0,0 +1,225 @@
+// 对话按键判定的测试工具，回放合成的对话文本框帧序列
+//   fingerprint [frames] [seed]
+// 模拟 frames 帧 (默认 4000) 的剧情对话：文字逐字显示、显示完整后停留、切换到下一句、播放动画时按键无效，
+// 背景带有噪声和零星的亮点，每一帧重新生成噪声。在随机的帧按键，下一帧用 image::fingerprint 和
+// image::compareFingerprints 按 script.js 中 DialogueAdvancer 的规则判定这次按键是 advanced、typing 还是 ignored，
+// 与模拟器实际发生的结果对比，并检查没有按键时文本框不变的帧不会被当作变化。最后输出每次计算指纹的平均耗时
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <tuple>
+#include <optional>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+import image;
+
+
+// 与 script.js 相同: 1920 x 1080 下的对话文本框大小，亮度阈值 200
+constexpr int boxWidth = 1000;
+constexpr int boxHeight = 140;
+constexpr int threshold = 200;
+
+constexpr int glyphWidth = 26;
+constexpr int lineLeft = 40;
+constexpr int lineTops[] = { 30, 80 };
+constexpr int maxGlyphsPerLine = (boxWidth - 2 * lineLeft) / glyphWidth;
+
+
+// 一句对话: 每个字的字形用随机数种子表示
+struct Line {
+    std::vector<uint32_t> glyphs {};
+};
+
+enum class Result { advanced, typing, ignored };
+
+const char* resultNames[] = { "advanced", "typing", "ignored" };
+
+
+class Dialogue {
+public:
+    explicit Dialogue(uint32_t seed): random(seed) { next(); }
+
+    // 按键的效果: 动画中无效，文字没有显示完整时立即显示完整，否则切换到下一句
+    auto press() -> Result {
+        if(animating > 0)
+            return Result::ignored;
+        if(shown < line.glyphs.size()) {
+            shown = line.glyphs.size();
+            return Result::typing;
+        }
+        next();
+        return Result::advanced;
+    }
+
+    // 推进一帧: 每帧显示 1~3 个字，偶尔进入一段不响应按键的动画
+    void tick() {
+        if(animating > 0) {
+            animating--;
+            return;
+        }
+        shown = std::min(line.glyphs.size(), shown + std::uniform_int_distribution<size_t>(1, 3)(random));
+        if(shown == line.glyphs.size() && std::uniform_int_distribution<int>(0, 39)(random) == 0)
+            animating = std::uniform_int_distribution<int>(3, 10)(random);
+    }
+
+    // 绘制文本框: 半透明的深色背景加噪声和零星亮点，文字为浅色的笔画
+    void render(std::vector<std::byte>& pixels, std::minstd_rand& noise) const {
+        for(size_t i = 0; i < pixels.size(); i += 4) {
+            uint32_t value = noise();
+            uint8_t gray = static_cast<uint8_t>(value % 500 == 0 ? 240 : 30 + (value >> 8) % 81);
+            pixels[i] = std::byte { static_cast<uint8_t>(gray + 10) };
+            pixels[i + 1] = pixels[i + 2] = std::byte { gray };
+            pixels[i + 3] = std::byte { 255 };
+        }
+
+        for(size_t i = 0; i < shown; i++) {
+            int row = static_cast<int>(i) / maxGlyphsPerLine;
+            int left = lineLeft + static_cast<int>(i) % maxGlyphsPerLine * glyphWidth;
+            drawGlyph(pixels, line.glyphs[i], left + 2, lineTops[row] + 2);
+        }
+    }
+
+private:
+    std::mt19937 random;
+    Line line {};
+    size_t shown = 0;
+    int animating = 0;
+
+    void next() {
+        // 大多数对话一行显示完，长对话占两行
+        size_t length = std::uniform_int_distribution<size_t>(6, 2 * maxGlyphsPerLine - 4)(random);
+        line.glyphs.resize(length);
+        for(uint32_t& glyph: line.glyphs)
+            glyph = random();
+        shown = 0;
+    }
+
+    // 字形为几条随机的横竖笔画
+    static void drawGlyph(std::vector<std::byte>& pixels, uint32_t seed, int left, int top) {
+        std::mt19937 strokes(seed);
+        std::uniform_int_distribution<int> offset(0, glyphWidth - 6), length(8, glyphWidth - 4);
+
+        for(int s = 0; s < 5; s++) {
+            bool horizontal = s % 2 == 0;
+            int x0 = left + (horizontal ? 0 : offset(strokes)), y0 = top + (horizontal ? offset(strokes) : 0);
+            int len = length(strokes);
+            for(int t = 0; t < len; t++) {
+                for(int w = 0; w < 3; w++) {
+                    int x = horizontal ? x0 + t : x0 + w, y = horizontal ? y0 + w : y0 + t;
+                    if(x >= boxWidth || y >= boxHeight)
+                        continue;
+                    std::byte* pixel = pixels.data() + (static_cast<size_t>(y) * boxWidth + x) * 4;
+                    pixel[0] = pixel[1] = pixel[2] = std::byte { 245 };
+                }
+            }
+        }
+    }
+};
+
+
+// 与 DialogueAdvancer 相同: 只有一个格子变化时当作噪声
+constexpr int noiseCells = 1;
+
+auto changed(uint64_t before, uint64_t after) -> bool {
+    auto [added, removed] = image::compareFingerprints(before, after);
+    return added.second > noiseCells || removed.second > noiseCells;
+}
+
+// 与 DialogueAdvancer.update 相同的判定规则
+auto classify(uint64_t before, uint64_t after) -> Result {
+    auto [added, removed] = image::compareFingerprints(before, after);
+    return removed.second > noiseCells ? Result::advanced : added.second > noiseCells ? Result::typing : Result::ignored;
+}
+
+
+int main(int argc, char* argv[]) {
+    int frames = argc >= 2 ? atoi(argv[1]) : 4000;
+    uint32_t seed = argc >= 3 ? static_cast<uint32_t>(atoi(argv[2])) : 42;
+
+    if(frames <= 0) {
+        fprintf(stderr, "用法:\n  fingerprint [frames] [seed]\n");
+        return 1;
+    }
+
+    Dialogue dialogue(seed);
+    std::minstd_rand noise(seed + 1);
+    std::mt19937 presses(seed + 2);
+    std::vector<std::byte> pixels(static_cast<size_t>(boxWidth) * boxHeight * 4);
+
+    // confusion[实际][判定]
+    int confusion[3][3] {};
+    int stableFrames = 0, falseChanges = 0, flickers = 0;
+    double fingerprintNs = 0;
+    int fingerprints = 0;
+
+    auto sample = [&]() {
+        dialogue.render(pixels, noise);
+        auto start = std::chrono::steady_clock::now();
+        uint64_t result = image::fingerprint(pixels.data(), boxWidth, boxHeight, boxWidth * 4, threshold);
+        fingerprintNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        fingerprints++;
+        return result;
+    };
+
+    uint64_t last = sample();
+    for(int frame = 0; frame < frames; frame++) {
+        bool press = std::uniform_int_distribution<int>(0, 2)(presses) == 0;
+        std::optional<Result> actual;
+        if(press)
+            actual = dialogue.press();
+        else dialogue.tick();
+
+        uint64_t current = sample();
+        if(actual)
+            confusion[static_cast<int>(*actual)][static_cast<int>(classify(last, current))]++;
+        else if(!changed(last, current))
+            stableFrames++;
+
+        // 不按键的帧再渲染一次，两次只有噪声不同，检查噪声不会被当作文本框的变化
+        if(!actual) {
+            uint64_t again = sample();
+            flickers += again != current;
+            falseChanges += changed(current, again);
+            current = again;
+        }
+
+        last = current;
+    }
+
+    int total = 0, correct = 0;
+    printf("按键判定 (行: 实际结果, 列: 判定结果)\n  %-10s", "");
+    for(const char* name: resultNames)
+        printf("%10s", name);
+    printf("\n");
+    for(int actual = 0; actual < 3; actual++) {
+        printf("  %-10s", resultNames[actual]);
+        for(int judged = 0; judged < 3; judged++) {
+            printf("%10d", confusion[actual][judged]);
+            total += confusion[actual][judged];
+            correct += actual == judged ? confusion[actual][judged] : 0;
+        }
+        printf("\n");
+    }
+
+    auto rate = [&](int actual) {
+        int count = confusion[actual][0] + confusion[actual][1] + confusion[actual][2];
+        return count > 0 ? 100.0 * confusion[actual][actual] / count : 100.0;
+    };
+
+    int noiseFrames = frames - total;
+    printf("%d 次按键, 判定正确 %.2f%%; %d 个只有噪声不同的帧中指纹变化 %d 次, 超过噪声容限 %d 次; %d 帧中 %d 帧文本框没有变化\n",
+        total, total > 0 ? 100.0 * correct / total : 0, noiseFrames, flickers, falseChanges, frames, stableFrames);
+    printf("指纹平均 %.1f us/帧 (%d x %d)\n", fingerprintNs / fingerprints / 1000, boxWidth, boxHeight);
+
+    // advanced 决定是否立即继续按键，必须几乎全部判定正确；ignored 误判为 advanced 只会少退避一次，
+    // typing 可能恰好补全在已经有文字的格子中而被判定为 ignored，只会多等待一次；噪声超过容限只会让按键推迟一帧
+    bool ok = rate(0) >= 99 && rate(1) >= 95 && rate(2) >= 90 && falseChanges * 20 <= noiseFrames;
+    printf(ok ? "通过\n" : "失败\n");
+    return ok ? 0 : 1;
+}
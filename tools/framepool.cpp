@@ -0,0 +1,136 @@
+// 截图帧缓冲池的测试工具，检查稳定状态下截图不再分配内存
+//   framepool [frames] [lag]
+// 模拟脚本每一帧截取两块区域 (隐藏对话按钮附近和对话文本框) 以及偶尔截取整个窗口，
+// 缓冲区在 lag 帧 (默认 3) 之后才归还，模拟 quickjs 在 GC 时才调用 ArrayBuffer 的释放回调
+// 预热之后统计 frames 帧 (默认 100000) 中 operator new 的调用次数，应该为 0；
+// 然后把池的上限调到比一帧需要的缓冲区还小，检查这时每次截图都会分配，说明计数本身是有效的
+
+#include <new>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+
+import frame;
+
+
+// 替换全局的 operator new，统计整个程序 (包括 frame 模块) 的堆分配次数
+std::atomic<size_t> allocations = 0;
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+
+// 1920 x 1080 窗口中每一帧截取的区域 (BGRA)
+constexpr size_t buttonBytes = 10 * 15 * 4;
+constexpr size_t textBoxBytes = 1000 * 140 * 4;
+constexpr size_t windowBytes = 1920 * 1080 * 4;
+
+
+struct Capture {
+    int releaseFrame;
+    frame::Buffer buffer;
+};
+
+// 等待归还的截图，固定大小的环形队列，本身不分配内存
+struct PendingCaptures {
+    std::vector<Capture> ring;
+    size_t head = 0;
+    size_t count = 0;
+
+    explicit PendingCaptures(size_t capacity): ring(capacity) {}
+
+    void push(const Capture& capture) { ring[(head + count++) % ring.size()] = capture; }
+
+    auto front() -> Capture& { return ring[head]; }
+
+    void pop() {
+        head = (head + 1) % ring.size();
+        count--;
+    }
+
+    void releaseUntil(int index) {
+        while (count > 0 && front().releaseFrame <= index) {
+            frame::release(front().buffer.data, front().buffer.size);
+            pop();
+        }
+    }
+};
+
+// 截取一帧，并归还 lag 帧之前的截图
+void simulateFrame(int index, int lag, PendingCaptures& pending) {
+    auto capture = [&](size_t size) {
+        frame::Buffer buffer = frame::acquire(size);
+        memset(buffer.data, index & 0xFF, 64);
+        pending.push({ index + lag, buffer });
+    };
+
+    capture(buttonBytes);
+    capture(textBoxBytes);
+    if (index % 50 == 0)
+        capture(windowBytes);
+
+    pending.releaseUntil(index);
+}
+
+
+int main(int argc, char* argv[]) {
+    int frames = argc >= 2 ? atoi(argv[1]) : 100000;
+    int lag = argc >= 3 ? atoi(argv[2]) : 3;
+
+    if (frames <= 0 || lag < 0) {
+        fprintf(stderr, "用法:\n  framepool [frames] [lag]\n");
+        return 1;
+    }
+
+    // 每一帧最多截图 3 次，最多同时有 lag + 1 帧的截图等待归还
+    PendingCaptures pending(static_cast<size_t>(lag + 1) * 3);
+
+    int index = 0;
+
+    // 预热: 截取整个窗口的间隔较长，预热到池中有足够的每种大小的缓冲区
+    for (int end = index + 2 * 50 * (lag + 1); index < end; index++)
+        simulateFrame(index, lag, pending);
+
+    size_t before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int end = index + frames; index < end; index++)
+        simulateFrame(index, lag, pending);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    size_t steadyAllocations = allocations.load() - before;
+
+    auto [hits, misses, hitRate, retainedBytes, capacity] = frame::stats();
+    printf("稳定状态 %d 帧: 分配 %zu 次, 命中率 %.4f, 池中保留 %.1f MiB, 平均 %.3f us/帧\n", frames, steadyAllocations,
+        hitRate.second, retainedBytes.second / (1024 * 1024), elapsedMs * 1000 / frames);
+
+    // 上限小于文本框的缓冲区时，文本框的每次截图都要分配
+    frame::setCapacity(static_cast<double>(textBoxBytes / 2));
+    before = allocations.load();
+    int checkFrames = 1000;
+    for (int end = index + checkFrames; index < end; index++)
+        simulateFrame(index, lag, pending);
+    size_t cappedAllocations = allocations.load() - before;
+    printf("池的上限为 %zu 字节时 %d 帧: 分配 %zu 次\n", textBoxBytes / 2, checkFrames, cappedAllocations);
+
+    pending.releaseUntil(index + lag);
+
+    bool ok = steadyAllocations == 0 && cappedAllocations >= static_cast<size_t>(checkFrames);
+    printf(ok ? "通过\n" : "失败\n");
+    return ok ? 0 : 1;
+}
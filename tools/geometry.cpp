@@ -0,0 +1,115 @@
+// 窗口几何信息跟踪和坐标换算的测试工具
+//   geometry
+// 用模拟的窗口代替 Tracker::Query，依次改变窗口大小、DPI，关闭并重新打开窗口，检查每次 validate 的结果；
+// 每次变化后按 script.js 的用法更新 Calibration，与手算的结果对比 TopLeft 和 BottomCenter 两种基准位置换算出的坐标
+// 最后检查供脚本使用的函数在编号不存在或者 anchor 无效时返回 -1，以及销毁后编号不再有效
+
+#include <tuple>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+import geometry;
+
+
+int failures = 0;
+
+void check(const std::string& name, bool ok) {
+    failures += !ok;
+    printf("  %s: %s\n", name.c_str(), ok ? "通过" : "失败");
+}
+
+auto text(std::tuple<int, int, int, int> rect) -> std::string {
+    auto [left, top, right, bottom] = rect;
+    return "[" + std::to_string(left) + ", " + std::to_string(top) + ", " + std::to_string(right) + ", " + std::to_string(bottom) + "]";
+}
+
+
+// 模拟的窗口，closed 为 true 时查询失败
+struct FakeWindow {
+    geometry::WindowGeometry geometry { 1920, 1080, 96 };
+    bool closed = false;
+};
+
+// 窗口的一次变化，以及变化后 validate 的预期结果和换算出的坐标
+struct Step {
+    const char* name;
+    geometry::WindowGeometry geometry;
+    bool closed;
+    bool changed;
+    std::tuple<int, int> button;                // 隐藏对话按钮 (280, 35)，TopLeft
+    std::tuple<int, int, int, int> textBox;     // 对话文本框 [460, 870, 1460, 1010]，BottomCenter
+};
+
+
+int main() {
+    FakeWindow window;
+    geometry::Tracker tracker([&](geometry::WindowGeometry& result) {
+        if (window.closed)
+            return false;
+        result = window.geometry;
+        return true;
+    });
+
+    // 与 script.js 相同的点和区域
+    geometry::Calibration calibration(1920, 1080);
+    uint32_t button = calibration.addPoint(280, 35, geometry::Anchor::TopLeft);
+    uint32_t textBox = calibration.addRect({ 460, 870, 1460, 1010 }, geometry::Anchor::BottomCenter);
+
+    printf("初始窗口 1920 x 1080\n");
+    check("构造时查询一次", tracker.current() == geometry::WindowGeometry { 1920, 1080, 96 });
+    check("没有变化", !tracker.validate());
+    check("基准分辨率下坐标不变", calibration.point(button) == std::tuple(280, 35) && calibration.rect(textBox) == std::tuple(460, 870, 1460, 1010));
+
+    // 预期的坐标是手算的: 宽高比大于 16:9 时按高度缩放并水平居中，小于时按宽度缩放并贴住窗口底部
+    const Step steps[] = {
+        { "缩小到 1280 x 720", { 1280, 720, 96 }, false, true, { 187, 23 }, { 307, 580, 973, 673 } },
+        { "大小不变", { 1280, 720, 96 }, false, false, { 187, 23 }, { 307, 580, 973, 673 } },
+        { "DPI 变为 144", { 1280, 720, 144 }, false, true, { 187, 23 }, { 307, 580, 973, 673 } },
+        { "1600 x 900", { 1600, 900, 144 }, false, true, { 233, 29 }, { 383, 725, 1217, 842 } },
+        { "带鱼屏 2560 x 1080", { 2560, 1080, 96 }, false, true, { 280, 35 }, { 780, 870, 1780, 1010 } },
+        { "16:10 的 1920 x 1200", { 1920, 1200, 96 }, false, true, { 280, 35 }, { 460, 990, 1460, 1130 } },
+        { "关闭窗口", { 1920, 1200, 96 }, true, true, { 280, 35 }, { 460, 990, 1460, 1130 } },
+        { "窗口仍然关闭", { 1920, 1200, 96 }, true, false, { 280, 35 }, { 460, 990, 1460, 1130 } },
+        { "重新打开 3840 x 2160", { 3840, 2160, 192 }, false, true, { 560, 70 }, { 920, 1740, 2920, 2020 } },
+        { "恢复 1920 x 1080", { 1920, 1080, 96 }, false, true, { 280, 35 }, { 460, 870, 1460, 1010 } },
+    };
+
+    for (const Step& step: steps) {
+        printf("%s\n", step.name);
+        window.geometry = step.geometry;
+        window.closed = step.closed;
+
+        bool changed = tracker.validate();
+        check(changed ? "检测到变化" : "没有变化", changed == step.changed);
+        if (step.closed)
+            check("关闭的窗口大小为 0", tracker.current() == geometry::WindowGeometry { 0, 0, 0 });
+
+        // 与 script.js 一样，只在窗口大小有效时重新换算，窗口关闭时保留原来的坐标
+        if (changed)
+            calibration.update(tracker.current().width, tracker.current().height);
+
+        auto [x, y] = calibration.point(button);
+        check("TopLeft (" + std::to_string(x) + ", " + std::to_string(y) + ")", calibration.point(button) == step.button);
+        check("BottomCenter " + text(calibration.rect(textBox)), calibration.rect(textBox) == step.textBox);
+    }
+
+    printf("供脚本使用的函数\n");
+    uint32_t id = geometry::createCalibration(1920, 1080);
+    int32_t first = geometry::addCalibrationPoint(id, 280, 35, 0);
+    int32_t second = geometry::addCalibrationRect(id, { 460, 870, 1460, 1010 }, 1);
+    check("下标从 0 开始", first == 0 && second == 1);
+    check("编号不存在时返回 -1", geometry::addCalibrationPoint(id + 100, 0, 0, 0) == -1 && geometry::addCalibrationRect(id + 100, { 0, 0, 1, 1 }, 0) == -1);
+    check("anchor 无效时返回 -1", geometry::addCalibrationPoint(id, 0, 0, 2) == -1 && geometry::addCalibrationRect(id, { 0, 0, 1, 1 }, -1) == -1);
+
+    geometry::updateCalibration(id, 2560, 1080);
+    check("按编号换算", geometry::getCalibrationPoint(id, 0) == std::tuple(280, 35) && geometry::getCalibrationRect(id, 1) == std::tuple(780, 870, 1780, 1010));
+
+    geometry::destroyCalibration(id);
+    check("销毁后编号不存在", geometry::addCalibrationPoint(id, 280, 35, 0) == -1 && geometry::getCalibrationPoint(id, 0) == std::tuple(0, 0));
+
+    if (failures == 0)
+        printf("全部通过\n");
+    else printf("%d 项失败\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+// 梯度轮廓匹配的测试工具，使用合成的图像
+//   gradient [width] [height] [iterations]
+// 在带噪声的背景上画一个图标 (圆环和中间的竖条)，分别经过颜色滤镜、亮度减半、HDR 曲线和反色处理，
+// 检查用原始颜色的模板能否在每张图中找到图标，对比 SSE2 和标量实现的结果，并输出两者的耗时
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+import gradient;
+
+
+struct Image {
+    int width, height;
+    std::vector<std::byte> pixels;
+
+    int step() const { return width * 4; }
+    uint8_t* at(int x, int y) { return reinterpret_cast<uint8_t*>(pixels.data()) + (static_cast<size_t>(y) * width + x) * 4; }
+};
+
+
+// 带噪声的渐变背景
+Image makeBackground(int width, int height, uint32_t seed) {
+    Image image { width, height, std::vector<std::byte>(static_cast<size_t>(width) * height * 4) };
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> noise(-6, 6);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* pixel = image.at(x, y);
+            int base = 50 + 30 * x / width + 20 * y / height;
+            pixel[0] = static_cast<uint8_t>(base + 10 + noise(random));
+            pixel[1] = static_cast<uint8_t>(base + noise(random));
+            pixel[2] = static_cast<uint8_t>(base - 10 + noise(random));
+            pixel[3] = 255;
+        }
+    }
+    return image;
+}
+
+
+// 以 (left, top) 为左上角画 48 x 48 的图标: 隐藏对话按钮的配色，外圈为圆环，中间为竖条
+void drawIcon(Image& image, int left, int top) {
+    for (int y = 0; y < 48; y++) {
+        for (int x = 0; x < 48; x++) {
+            double dx = x - 23.5, dy = y - 23.5;
+            double distance = std::sqrt(dx * dx + dy * dy);
+            bool ring = distance >= 15 && distance <= 21;
+            bool bar = std::abs(dx) <= 3 && std::abs(dy) <= 10;
+            if (!ring && !bar)
+                continue;
+
+            uint8_t* pixel = image.at(left + x, top + y);
+            pixel[0] = 216, pixel[1] = 229, pixel[2] = 236;
+        }
+    }
+}
+
+
+void applyFilter(Image& image, const std::function<void(uint8_t* bgr)>& filter) {
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++)
+            filter(image.at(x, y));
+    }
+}
+
+
+uint8_t clampByte(double value) {
+    return static_cast<uint8_t>(std::clamp(std::lround(value), 0l, 255l));
+}
+
+
+int main(int argc, char* argv[]) {
+    int width = argc >= 2 ? atoi(argv[1]) : 960;
+    int height = argc >= 3 ? atoi(argv[2]) : 540;
+    int iterations = argc >= 4 ? atoi(argv[3]) : 20;
+
+    if (width < 200 || height < 120 || iterations <= 0) {
+        fprintf(stderr, "用法:\n  gradient [width] [height] [iterations]\n");
+        return 1;
+    }
+
+    constexpr int threshold = 32;
+    constexpr double minScore = 0.8;
+
+    // 模板: 在 56 x 56 的背景中间画图标，与游戏中截取图标的方式相同
+    Image templateImage = makeBackground(56, 56, 1);
+    drawIcon(templateImage, 4, 4);
+    gradient::GradientMap templateMap;
+    gradient::compute(templateImage.pixels.data(), templateImage.width, templateImage.height, templateImage.step(), templateMap);
+    gradient::OutlineTemplate outline = gradient::makeTemplate(templateMap, threshold, 96);
+
+    struct Variant {
+        const char* name;
+        std::function<void(uint8_t*)> filter;
+    };
+
+    std::vector<Variant> variants = {
+        { "原始", [](uint8_t*) {} },
+        { "颜色滤镜", [](uint8_t* p) { uint8_t b = p[0]; p[0] = clampByte(p[2] * 0.6); p[1] = clampByte(p[1] * 0.9 + 20); p[2] = clampByte(b * 1.1); } },
+        { "亮度减半", [](uint8_t* p) { for (int c = 0; c < 3; c++) p[c] = static_cast<uint8_t>(p[c] / 2); } },
+        { "HDR 曲线", [](uint8_t* p) { for (int c = 0; c < 3; c++) p[c] = clampByte(255 * std::pow(p[c] / 255.0, 0.6) * 1.1 - 10); } },
+        { "反色", [](uint8_t* p) { for (int c = 0; c < 3; c++) p[c] = static_cast<uint8_t>(255 - p[c]); } },
+    };
+
+    bool ok = true;
+    std::mt19937 random(7);
+
+    printf("模板 %zu 个特征点, SSE2 %s\n", outline.features.size(), gradient::simdAvailable() ? "可用" : "不可用");
+
+    for (size_t i = 0; i < variants.size(); i++) {
+        // 图标的左上角为 (left, top)，模板中图标的偏移为 (4, 4)
+        int left = 8 + static_cast<int>(random() % (width - 64));
+        int top = 8 + static_cast<int>(random() % (height - 64));
+
+        Image frame = makeBackground(width, height, static_cast<uint32_t>(100 + i));
+        drawIcon(frame, left, top);
+        applyFilter(frame, variants[i].filter);
+
+        gradient::GradientMap simd, scalar;
+        gradient::compute(frame.pixels.data(), width, height, frame.step(), simd, true);
+        gradient::compute(frame.pixels.data(), width, height, frame.step(), scalar, false);
+        bool identical = simd.magnitude == scalar.magnitude && simd.orientation == scalar.orientation;
+
+        std::vector<gradient::Match> matches = gradient::match(simd, outline, threshold, minScore);
+        bool found = !matches.empty() && std::abs(matches[0].x + 4 - left) <= 1 && std::abs(matches[0].y + 4 - top) <= 1;
+
+        const uint8_t* center = frame.at(left + 24, top + 24);
+        printf("  %-10s 图标颜色 (%3d, %3d, %3d)  %s", variants[i].name, center[2], center[1], center[0], found ? "找到" : "未找到");
+        if (!matches.empty())
+            printf(" (%d, %d) 得分 %.2f, 共 %zu 个结果", matches[0].x + 4, matches[0].y + 4, matches[0].score, matches.size());
+        printf(", 应为 (%d, %d)%s\n", left, top, identical ? "" : ", SSE2 与标量结果不同");
+
+        ok = ok && found && matches.size() == 1 && identical;
+    }
+
+    // 耗时
+    Image frame = makeBackground(width, height, 1000);
+    drawIcon(frame, width / 2, height / 2);
+    gradient::GradientMap map;
+
+    auto measure = [&](const std::function<void()>& run) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            run();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    double simdMs = measure([&]() { gradient::compute(frame.pixels.data(), width, height, frame.step(), map, true); });
+    double scalarMs = measure([&]() { gradient::compute(frame.pixels.data(), width, height, frame.step(), map, false); });
+    double matchMs = measure([&]() { gradient::match(map, outline, threshold, minScore); });
+
+    double megapixels = static_cast<double>(width) * height / 1e6;
+    printf("%d x %d: SSE2 %.3f ms (%.0f MPix/s), 标量 %.3f ms (%.0f MPix/s), 匹配 %.3f ms\n",
+        width, height, simdMs, megapixels / simdMs * 1000, scalarMs, megapixels / scalarMs * 1000, matchMs);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// 脚本热重载的文件监视测试工具，在临时目录中模拟编辑器保存文件的几种方式，检查 watch::Watcher 返回的文件
+//   hotreload [rounds] [quietMs]
+// 依次检查: 直接写入、连续多次写入只返回一次、先写临时文件再重命名、忽略其它扩展名、启动后新建的子目录
+// 然后修改 rounds 次文件 (默认 50)，测量从写入完成到 poll 返回修改的延迟，延迟中包括 quietMs (默认 50) 的合并时间
+// Linux 上使用 inotify，Windows 上使用 ReadDirectoryChangesW
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+import watch;
+
+
+namespace fs = std::filesystem;
+
+int failures = 0;
+
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+
+// 等待 poll 返回非空的结果，超时返回空
+auto waitChanges(watch::Watcher& watcher, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) -> std::vector<std::string> {
+    auto end = std::chrono::steady_clock::now() + timeout;
+    while(std::chrono::steady_clock::now() < end) {
+        std::vector<std::string> changes = watcher.poll();
+        if(!changes.empty())
+            return changes;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return {};
+}
+
+
+void check(const char* name, const std::vector<std::string>& changes, const std::vector<std::string>& expected) {
+    bool ok = changes == expected;
+    failures += !ok;
+
+    std::string text;
+    for(const std::string& change: changes)
+        text += (text.empty() ? "" : ", ") + change;
+    printf("  %-24s %s  [%s]\n", name, ok ? "通过" : "失败", text.c_str());
+}
+
+
+int main(int argc, char* argv[]) {
+    int rounds = argc >= 2 ? atoi(argv[1]) : 50;
+    int quietMs = argc >= 3 ? atoi(argv[2]) : 50;
+
+    if(rounds <= 0 || quietMs < 0) {
+        fprintf(stderr, "用法:\n  hotreload [rounds] [quietMs]\n");
+        return 1;
+    }
+
+    fs::path dir = fs::temp_directory_path() / ("hotreload-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(dir);
+    writeFile(dir / "script.js", "import './api.js';\n");
+    writeFile(dir / "api.js", "export const a = 1;\n");
+
+    {
+        watch::Watcher watcher(dir, ".js", quietMs);
+        if(!watcher.isValid()) {
+            fprintf(stderr, "无法监视目录 %s\n", dir.string().c_str());
+            fs::remove_all(dir);
+            return 1;
+        }
+
+        printf("监视 %s\n", dir.string().c_str());
+
+        writeFile(dir / "script.js", "import './api.js';\nconsole.log(1);\n");
+        check("直接写入", waitChanges(watcher), { "script.js" });
+
+        for(int i = 0; i < 10; i++)
+            writeFile(dir / "api.js", "export const a = " + std::to_string(i) + ";\n");
+        check("连续写入", waitChanges(watcher), { "api.js" });
+
+        writeFile(dir / "api.js.tmp", "export const a = 2;\n");
+        fs::rename(dir / "api.js.tmp", dir / "api.js");
+        check("写入临时文件后重命名", waitChanges(watcher), { "api.js" });
+
+        writeFile(dir / "notes.txt", "text\n");
+        check("忽略其它扩展名", waitChanges(watcher, std::chrono::milliseconds(quietMs + 200)), {});
+
+        fs::create_directories(dir / "lib");
+        writeFile(dir / "lib" / "util.js", "export const b = 1;\n");
+        check("新建的子目录", waitChanges(watcher), { "lib/util.js" });
+
+        writeFile(dir / "lib" / "util.js", "export const b = 2;\n");
+        check("修改子目录中的文件", waitChanges(watcher), { "lib/util.js" });
+
+        std::vector<double> latencies;
+        for(int i = 0; i < rounds; i++) {
+            writeFile(dir / "script.js", "console.log(" + std::to_string(i) + ");\n");
+            auto written = std::chrono::steady_clock::now();
+            std::vector<std::string> changes = waitChanges(watcher);
+            if(changes != std::vector<std::string> { "script.js" })
+                failures++;
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - written).count());
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        printf("  修改 %d 次, 延迟 p50 %.2f ms, 最大 %.2f ms (合并时间 %d ms)\n", rounds,
+            latencies[latencies.size() / 2], latencies.back(), quietMs);
+    }
+
+    fs::remove_all(dir);
+    if(failures == 0)
+        printf("全部通过\n");
+    else printf("%d 项失败\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// 运行指标的读取工具，读取程序写入共享内存的指标
+//   metrics [name]                         输出一次
+//   metrics watch [intervalMs] [name]      每隔 intervalMs 输出一次，直到程序退出
+//   metrics demo [seconds] [name]          模拟程序写入指标 (每 50ms 一帧，偶尔卡顿)，用于在没有游戏的环境中测试读取
+// name 默认为 GenshinAutoV2.metrics
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+import metrics;
+
+
+void print(const metrics::Snapshot& snapshot) {
+    double uptime = (snapshot.updateTimeMs - snapshot.startTimeMs) / 1000.0;
+    printf("pid %u  运行 %.1f 秒  (%lld ms 前更新)\n", snapshot.pid, uptime,
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - snapshot.updateTimeMs));
+    printf("  帧数 %llu  检测 %llu  按键 %llu  输入 %llu  卡顿 %llu\n",
+        static_cast<unsigned long long>(snapshot.ticks), static_cast<unsigned long long>(snapshot.detections),
+        static_cast<unsigned long long>(snapshot.presses), static_cast<unsigned long long>(snapshot.inputs),
+        static_cast<unsigned long long>(snapshot.stalls));
+    printf("  帧耗时 最近 %.2f ms  p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  最大 %.2f ms\n",
+        snapshot.lastTickMs, snapshot.p50TickMs, snapshot.p90TickMs, snapshot.p99TickMs, snapshot.maxTickMs);
+    printf("  内存 %.2f MB\n", snapshot.memoryBytes / (1024 * 1024));
+}
+
+
+// 模拟程序的主循环: 每帧 2~6ms，每 50 帧一次 80ms 的卡顿，每 20 帧检测到一次对话并按一次键
+int demo(double seconds, const char* name) {
+    if (!metrics::open(name, 200)) {
+        fprintf(stderr, "无法创建共享内存 %s，可能已有另一个实例在使用\n", name);
+        return 1;
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> tickMs(2, 6);
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+
+    for (uint64_t tick = 1; std::chrono::steady_clock::now() < end; tick++) {
+        bool stalled = tick % 50 == 0;
+        metrics::recordTick(stalled ? 80 : tickMs(random));
+        if (stalled)
+            metrics::addStall();
+
+        if (tick % 20 == 0) {
+            metrics::addDetection();
+            metrics::addPress();
+            metrics::addInput();
+        }
+
+        metrics::setMemoryBytes(4.0 * 1024 * 1024 + static_cast<double>(tick % 100) * 1024);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    metrics::close();
+    return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    std::string_view command = argc >= 2 ? argv[1] : "";
+
+    if (command == "demo")
+        return demo(argc >= 3 ? atof(argv[2]) : 10, argc >= 4 ? argv[3] : metrics::defaultName);
+
+    bool watch = command == "watch";
+    int intervalMs = watch && argc >= 3 ? atoi(argv[2]) : 1000;
+    const char* name = watch ? (argc >= 4 ? argv[3] : metrics::defaultName) : (argc >= 2 ? argv[1] : metrics::defaultName);
+
+    if (intervalMs <= 0 || command == "-h" || command == "--help") {
+        fprintf(stderr, "用法:\n  metrics [name]\n  metrics watch [intervalMs] [name]\n  metrics demo [seconds] [name]\n");
+        return 1;
+    }
+
+    metrics::Reader reader;
+    if (!reader.open(name)) {
+        fprintf(stderr, "找不到运行指标 %s (程序没有运行，或者版本不同)\n", name);
+        return 1;
+    }
+
+    do {
+        metrics::Snapshot snapshot;
+        if (!reader.read(snapshot)) {
+            fprintf(stderr, "读取失败\n");
+            return 1;
+        }
+
+        print(snapshot);
+        fflush(stdout);
+        if (watch)
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    } while (watch);
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+// 模块名解析缓存的测试工具，生成一个较大的模块树，对比每次导入都规范化路径和使用解析缓存时加载整个模块图的耗时
+//   modulegraph [modules] [sizeKB] [dir]
+// 生成 modules 个模块 (默认 400)，每个约 sizeKB (默认 16)，分布在多个子目录中，每个模块用相对路径导入几个其它模块
+// 按 quickjs 解析导入的顺序 (深度优先) 加载每个模块，每个模块都从磁盘读取
+//   不缓存: 每次导入规范化两次路径 (模块加载器和 evalFile 各一次)，与原来的模块加载器相同
+//   缓存:   与 qjs::Runtime::resolve 相同，首次加载和热重载 (同一个运行时再次加载，全部命中缓存) 各运行一次
+// 同时检查几种方式加载的模块和源码完全相同；模块生成在 dir (默认为临时目录) 下的 modulegraph 目录中，结束后删除
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+
+import modulepath;
+
+
+namespace fs = std::filesystem;
+
+constexpr int modulesPerDir = 25;
+constexpr int fanout = 4;
+
+
+auto modulePath(int i) -> std::string {
+    return "lib/dir" + std::to_string(i / modulesPerDir) + "/m" + std::to_string(i) + ".js";
+}
+
+
+// 模块名 -> 其中导入的模块名 (未规范化)，与生成的源码中的导入语句相同
+using Imports = std::unordered_map<std::string, std::vector<std::string>>;
+
+// 模块 i 导入 i * fanout + 1 ... i * fanout + fanout，组成一棵树；导入语句使用相对于自己所在目录的路径
+auto generate(const fs::path& dir, int modules, int sizeKB) -> Imports {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    Imports imports;
+    std::ofstream entry(dir / "script.js");
+    entry << "import { run } from \"./" << modulePath(0) << "\";\nrun();\n";
+    imports["script.js"] = { "./" + modulePath(0) };
+
+    for(int i = 0; i < modules; i++) {
+        fs::path path = dir / modulePath(i);
+        fs::create_directories(path.parent_path());
+        std::ofstream file(path);
+        std::vector<std::string>& specifiers = imports[modulePath(i)];
+
+        for(int j = 1; j <= fanout && i * fanout + j < modules; j++) {
+            int child = i * fanout + j;
+            std::string specifier = fs::path(modulePath(child)).lexically_relative(fs::path(modulePath(i)).parent_path()).generic_string();
+            if(!specifier.starts_with("."))
+                specifier = "./" + specifier;
+            file << "import * as child" << j << " from '" << specifier << "';\n";
+            specifiers.push_back(specifier);
+        }
+
+        file << "export const run = () => {};\n";
+
+        std::string filler = "export function f" + std::to_string(i) + "(a, b) { return a + b; }\n";
+        for(size_t written = 0; written < static_cast<size_t>(sizeKB) * 1024; written += filler.size())
+            file << filler;
+    }
+
+    return imports;
+}
+
+
+auto readFile(const fs::path& path) -> std::string {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+
+// 按 quickjs 的顺序加载模块图: 读取一个模块后，依次解析并加载它导入的每个模块
+// resolve(baseName, specifier) 返回规范化的模块名
+struct GraphLoad {
+    std::vector<std::string> order {};
+    std::unordered_map<std::string, std::string> sources {};
+};
+
+auto loadGraph(const fs::path& dir, const Imports& imports, const std::function<std::string(const std::string&, const std::string&)>& resolve) -> GraphLoad {
+    GraphLoad result;
+
+    std::function<void(const std::string&)> visit = [&](const std::string& name) {
+        if(result.sources.contains(name))
+            return;
+
+        result.order.push_back(name);
+        result.sources.emplace(name, readFile(dir / name));
+
+        auto it = imports.find(name);
+        if(it == imports.end())
+            return;
+        for(const std::string& specifier: it->second)
+            visit(resolve(name, specifier));
+    };
+
+    visit(resolve("", "script.js"));
+    return result;
+}
+
+
+auto uncachedLoad(const fs::path& dir, const Imports& imports) -> GraphLoad {
+    return loadGraph(dir, imports, [&](const std::string& baseName, const std::string& specifier) {
+        // 模块加载器规范化一次，evalFile 再规范化一次
+        std::string name = modulepath::normalize(dir, baseName, specifier);
+        return modulepath::normalize(dir, "", name);
+    });
+}
+
+
+// 与 qjs::Runtime::resolve 相同，规范化的模块名本身也加入缓存
+struct ResolveCache {
+    fs::path dir;
+    std::unordered_map<std::string, std::string> names {};
+    size_t normalized = 0;
+
+    auto resolve(const std::string& baseName, const std::string& specifier) -> const std::string& {
+        std::string key = modulepath::key(baseName, specifier);
+        auto it = names.find(key);
+        if(it != names.end())
+            return it->second;
+
+        std::string name = modulepath::normalize(dir, baseName, specifier);
+        normalized++;
+        names.try_emplace(modulepath::key("", name), name);
+        return names.emplace(std::move(key), std::move(name)).first->second;
+    }
+};
+
+auto cachedLoad(const fs::path& dir, const Imports& imports, ResolveCache& cache) -> GraphLoad {
+    return loadGraph(dir, imports, [&](const std::string& baseName, const std::string& specifier) {
+        // 模块加载器规范化一次，evalFile 再规范化一次 (命中缓存)
+        return cache.resolve("", cache.resolve(baseName, specifier));
+    });
+}
+
+
+auto measure(const std::function<void()>& func) -> double {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char* argv[]) {
+    int modules = argc >= 2 ? atoi(argv[1]) : 400;
+    int sizeKB = argc >= 3 ? atoi(argv[2]) : 16;
+    fs::path dir = (argc >= 4 ? fs::path(argv[3]) : fs::temp_directory_path()) / "modulegraph";
+
+    if(modules <= 0 || sizeKB <= 0) {
+        fprintf(stderr, "用法:\n  modulegraph [modules] [sizeKB] [dir]\n");
+        return 1;
+    }
+
+    Imports imports = generate(dir, modules, sizeKB);
+    printf("%d 个模块, 每个约 %d KB, 目录 %s\n", modules, sizeKB, dir.string().c_str());
+
+    // 先完整读取一遍，几种方式都在热缓存下比较
+    GraphLoad uncached = uncachedLoad(dir, imports), cached, reloaded;
+    double uncachedMs = measure([&]() { uncached = uncachedLoad(dir, imports); });
+
+    ResolveCache cache { dir };
+    double cachedMs = measure([&]() { cached = cachedLoad(dir, imports, cache); });
+    size_t firstNormalized = cache.normalized;
+    double reloadMs = measure([&]() { reloaded = cachedLoad(dir, imports, cache); });
+
+    size_t expected = static_cast<size_t>(modules) + 1;
+    bool ok = uncached.order.size() == expected && cached.order == uncached.order && cached.sources == uncached.sources
+        && reloaded.order == uncached.order && reloaded.sources == uncached.sources
+        && firstNormalized == expected && cache.normalized == firstNormalized;
+
+    printf("  不缓存:   %.1f ms, 规范化 %zu 次\n", uncachedMs, expected * 2);
+    printf("  首次加载: %.1f ms (%.2fx), 规范化 %zu 次\n", cachedMs, uncachedMs / cachedMs, firstNormalized);
+    printf("  热重载:   %.1f ms (%.2fx), 规范化 %zu 次\n", reloadMs, uncachedMs / reloadMs, cache.normalized - firstNormalized);
+
+    fs::remove_all(dir);
+    printf(ok ? "几种方式加载的模块图相同\n" : "几种方式加载的模块图不同\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// 多目标调度测试工具，使用模拟的目标代替游戏客户端
+//   multitarget [targets] [threads] [seconds] [workMs] [periodMs]
+// 先在只有 1 个线程的线程池中检查: 一个目标持有输入事务跨越多次 step 时，另一个目标的输入不会占住线程，持有者按时松开按键
+// 然后每个模拟目标每 periodMs 执行一帧，每帧忙等 workMs 模拟截图和检测，每 8 帧通过输入调度发送一次 (耗时 1ms 的) 输入，
+// 其它目标持有事务时下一帧重试；每 8 帧 (与单独的输入错开) 在输入事务中按下按键，等待 periodMs 后在下一次 step 中松开，
+// 与 script.js 中的 win.withInput 相同
+// 结束时输出总吞吐量、每个目标的帧数和延迟，以及输入的等待情况，并检查每个事务的按下和松开之间没有其它目标的输入
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+import scheduler;
+
+
+// 忙等，模拟占用 CPU 的工作
+void spin(double ms) {
+    auto end = scheduler::Clock::now() + std::chrono::duration_cast<scheduler::Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    while (scheduler::Clock::now() < end);
+}
+
+
+// 输入的记录，只在持有输入调度的锁时写入: 任务编号，以及 'i' (单独的输入)、'd' (按下)、'u' (松开)
+std::vector<std::pair<uint32_t, char>> inputs;
+
+// 与 main.cpp 中的输入函数相同，其它目标持有事务时不输入并返回 false
+bool input(char kind) {
+    auto lock = scheduler::lockInput();
+    if (!lock)
+        return false;
+    inputs.emplace_back(scheduler::currentJob(), kind);
+    spin(1);
+    return true;
+}
+
+
+// 每个按下之后的下一个输入都应该是同一个任务的松开
+auto interleaved() -> int {
+    int count = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i].second == 'd' && (i + 1 == inputs.size() || inputs[i + 1] != std::pair(inputs[i].first, 'u')))
+            count++;
+    }
+    return count;
+}
+
+
+// 1 个线程、2 个目标: holder 在事务中按下按键，75ms 后的下一次 step 中松开；other 在此期间每 5ms 尝试一次单独的输入
+// 如果输入调度在线程池的线程中等待事务结束，other 会占住唯一的线程，holder 直到事务过期 (2s) 才能松开按键
+auto heldAcrossSteps() -> bool {
+    using namespace std::chrono_literals;
+    auto start = scheduler::Clock::now();
+    auto elapsedMs = [&]() { return std::chrono::duration<double, std::milli>(scheduler::Clock::now() - start).count(); };
+
+    std::atomic<double> upMs = -1, inputMs = -1;
+    std::atomic<int> retries = 0;
+    {
+        scheduler::Pool pool(1);
+
+        pool.add("holder", [&, pressed = false]() mutable -> std::optional<scheduler::Clock::time_point> {
+            if (!pressed) {
+                pressed = scheduler::tryBeginInput() && input('d');
+                return scheduler::Clock::now() + 75ms;
+            }
+            input('u');
+            upMs = elapsedMs();
+            scheduler::endInput();
+            return std::nullopt;
+        });
+
+        pool.add("other", [&]() -> std::optional<scheduler::Clock::time_point> {
+            if (input('i')) {
+                inputMs = elapsedMs();
+                return std::nullopt;
+            }
+            retries++;
+            return scheduler::Clock::now() + 5ms;
+        });
+
+        pool.wait();
+    }
+
+    bool ordered = inputs.size() == 3 && inputs[0].second == 'd' && inputs[1].second == 'u' && inputs[2].second == 'i';
+    bool ok = ordered && upMs >= 75 && upMs < 500 && inputMs >= upMs && retries > 0;
+    printf("1 个线程跨 step 持有事务: 松开按键 %.1f ms, 另一个目标重试 %d 次后在 %.1f ms 输入: %s\n",
+        upMs.load(), retries.load(), inputMs.load(), ok ? "通过" : "失败");
+    inputs.clear();
+    return ok;
+}
+
+
+int main(int argc, char* argv[]) {
+    int targets = argc >= 2 ? atoi(argv[1]) : 8;
+    int threads = argc >= 3 ? atoi(argv[2]) : 4;
+    double seconds = argc >= 4 ? atof(argv[3]) : 3;
+    double workMs = argc >= 5 ? atof(argv[4]) : 4;
+    double periodMs = argc >= 6 ? atof(argv[5]) : 50;
+
+    if (targets <= 0 || threads <= 0 || seconds <= 0 || periodMs <= 0) {
+        fprintf(stderr, "用法:\n  multitarget [targets] [threads] [seconds] [workMs] [periodMs]\n");
+        return 1;
+    }
+
+    bool held = heldAcrossSteps();
+
+    auto period = std::chrono::duration_cast<scheduler::Clock::duration>(std::chrono::duration<double, std::milli>(periodMs));
+    auto deadline = scheduler::Clock::now() + std::chrono::duration_cast<scheduler::Clock::duration>(std::chrono::duration<double>(seconds));
+
+    scheduler::Pool pool(threads);
+
+    for (int i = 0; i < targets; i++) {
+        pool.add("target" + std::to_string(i), [=, tick = 0, pressed = false, single = false, next = scheduler::Clock::now()]() mutable -> std::optional<scheduler::Clock::time_point> {
+            // 事务中按下的按键在下一次 step 中松开，中间其它目标的 step 照常执行
+            if (pressed) {
+                input('u');
+                scheduler::endInput();
+                pressed = false;
+            }
+
+            spin(workMs);
+
+            if (++tick % 8 == 0)
+                single = true;
+
+            // 其它目标持有事务时不等待，下一帧再试
+            if (single)
+                single = !input('i');
+            else if (tick % 8 == 4 && scheduler::tryBeginInput()) {
+                input('d');
+                pressed = true;
+            }
+
+            // 与事件循环的计时器相同，下一帧从这一帧的到期时间开始计算
+            next += period;
+            if (next >= deadline) {
+                if (pressed) {
+                    input('u');
+                    scheduler::endInput();
+                }
+                return std::nullopt;
+            }
+            return next;
+        });
+    }
+
+    pool.wait();
+
+    printf("%d 个目标, %d 个线程, 每帧 %.1f ms / %.1f ms, 吞吐量 %.1f 帧/秒\n", targets, threads, workMs, periodMs, pool.throughput());
+
+    for (const scheduler::TargetStats& stats: pool.stats()) {
+        printf("  %-10s %6.0f 帧  平均延迟 %7.3f ms  最大延迟 %7.3f ms  CPU %7.1f ms\n", stats.name.c_str(), stats.steps,
+            stats.steps > 0 ? stats.totalLatencyMs / stats.steps : 0, stats.maxLatencyMs, stats.busyMs);
+    }
+
+    scheduler::InputStats stats = scheduler::inputStats();
+    printf("输入 %.0f 次, 等待 %.0f 次, 平均等待 %.3f ms, 最大等待 %.3f ms\n", stats.inputs, stats.waits,
+        stats.waits > 0 ? stats.totalWaitMs / stats.waits : 0, stats.maxWaitMs);
+
+    int broken = interleaved();
+    printf("输入事务 %.0f 次 (其它目标持有事务时重试 %.0f 次), 按下和松开之间插入其它输入 %d 次\n", stats.transactions, stats.busy, broken);
+    return broken == 0 && held ? 0 : 1;
+}
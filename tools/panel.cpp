@@ -0,0 +1,205 @@
+// 控制台状态面板的测试工具，把面板渲染到管道中，用一个简单的终端模拟器还原屏幕内容并检查
+//   panel [updates]
+// 先检查按显示宽度截断 (ASCII、中文、ANSI 转义序列) 和逐行比较的输出，
+// 然后启动面板并输出到管道，更新状态、计数器、帧耗时和事件，停止后检查还原出的每一行，
+// 最后连续更新 updates 次 (默认 2000) 状态，检查只有状态这一行被重写，并统计实际写入的字节数
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+import panel;
+
+
+int failures = 0;
+
+void check(const char* name, bool ok, const std::string& detail = "") {
+    failures += !ok;
+    printf("  %s: %s%s%s\n", name, ok ? "通过" : "失败", ok || detail.empty() ? "" : "  ", ok ? "" : detail.c_str());
+}
+
+
+// 去掉 ANSI 转义序列
+auto plain(const std::string& text) -> std::string {
+    std::string result;
+    for(size_t i = 0; i < text.size(); i++) {
+        if(text[i] != '\x1b') {
+            result += text[i];
+            continue;
+        }
+        size_t end = text.find_first_of("ABCDHJKmsu", i + 1);
+        i = end == std::string::npos ? text.size() : end;
+    }
+    return result;
+}
+
+
+// 只支持面板用到的序列: 光标定位 ESC[row;colH、ESC[H，清屏 ESC[2J / ESC[3J，清除到行尾 ESC[K，颜色 ESC[...m
+struct Terminal {
+    std::vector<std::string> rows;
+    size_t row = 0;
+    std::vector<size_t> rowWrites;      // 每一行被光标定位重写的次数
+
+    explicit Terminal(size_t lines): rows(lines), rowWrites(lines + 1) {}
+
+    void feed(const std::string& output) {
+        for(size_t i = 0; i < output.size(); i++) {
+            char c = output[i];
+            if(c == '\n') {
+                row++;
+                continue;
+            }
+            if(c != '\x1b') {
+                if(row < rows.size())
+                    rows[row] += c;
+                continue;
+            }
+
+            size_t end = output.find_first_of("ABCDHJKmsu", i + 1);
+            if(end == std::string::npos)
+                return;
+            std::string params = output.substr(i + 2, end - i - 2);
+
+            switch(output[end]) {
+            case 'H':
+                row = params.empty() ? 0 : static_cast<size_t>(atoi(params.c_str()) - 1);
+                if(row < rows.size())
+                    rows[row].clear();      // 面板总是从行首重写整行
+                rowWrites[std::min(row, rows.size())]++;
+                break;
+            case 'J':
+                for(std::string& line: rows)
+                    line.clear();
+                break;
+            case 'm':
+                if(row < rows.size())
+                    rows[row] += output.substr(i, end - i + 1);
+                break;
+            }
+            i = end;
+        }
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    int updates = argc >= 2 ? atoi(argv[1]) : 2000;
+    if(updates <= 0) {
+        fprintf(stderr, "用法:\n  panel [updates]\n");
+        return 1;
+    }
+
+    using namespace console;
+
+    printf("按显示宽度截断\n");
+    check("ASCII", plain(panel::fitWidth("abcdefgh", 5)) == "abcde");
+    check("中文按两个字符宽度", plain(panel::fitWidth("状态: 等待剧情对话", 9)) == "状态: 等");
+    check("保留转义序列", panel::fitWidth(std::string(ansi::blue) + "Pid" + ansi::reset, 3) == std::string(ansi::blue) + "Pid" + ansi::reset + ansi::reset);
+    check("换行和制表符替换为空格", plain(panel::fitWidth("a\tb\nc", 10)) == "a b c");
+
+    printf("逐行比较\n");
+    std::vector<std::string> front;
+    std::vector<std::string> back { "title", "state", "ticks" };
+    std::string output = panel::diff(front, back);
+    check("第一次输出所有行", output == "\x1b[1;1Htitle\x1b[K\x1b[2;1Hstate\x1b[K\x1b[3;1Hticks\x1b[K", output);
+
+    back = { "title", "state", "ticks" };
+    check("没有变化时不输出", panel::diff(front, back).empty());
+
+    back = { "title", "state 2", "ticks" };
+    output = panel::diff(front, back);
+    check("只重写变化的行", output == "\x1b[2;1Hstate 2\x1b[K" && front[1] == "state 2", output);
+
+    // 渲染到管道，后台线程读取管道中的所有输出
+    int fds[2];
+#ifdef _WIN32
+    int created = _pipe(fds, 1 << 20, _O_BINARY);
+#else
+    int created = pipe(fds);
+#endif
+    if(created != 0) {
+        fprintf(stderr, "无法创建管道\n");
+        return 1;
+    }
+
+    FILE* writer = fdopen(fds[1], "wb");
+    std::string received;
+    std::mutex receivedMutex;
+    std::thread reader([&]() {
+        char buffer[4096];
+        for(int n; (n = static_cast<int>(read(fds[0], buffer, sizeof(buffer)))) > 0; ) {
+            std::lock_guard lock(receivedMutex);
+            received.append(buffer, static_cast<size_t>(n));
+        }
+    });
+
+    constexpr short cols = 60, lines = 12;
+    printf("渲染到管道 (%d x %d)\n", cols, lines);
+    panel::start("GenshinAuto v2.4", cols, lines, 5, writer);
+    panel::setState("剧情对话中");
+    panel::setCounter("按键", 3);
+    panel::addCounter("按键", 2);
+    panel::addCounter("推进对话", 1);
+    panel::recordTick(4);
+    panel::recordTick(6);
+    for(int i = 0; i < 10; i++)
+        panel::event("事件 " + std::to_string(i));
+    panel::event("第一行\n第二行");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    size_t beforeUpdates = 0;
+    {
+        std::lock_guard lock(receivedMutex);
+        beforeUpdates = received.size();
+    }
+    for(int i = 0; i < updates; i++) {
+        panel::setState(("剧情对话中 " + std::to_string(i)).c_str());
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    panel::stop();
+    fclose(writer);
+    reader.join();
+    close(fds[0]);
+
+    Terminal terminal(lines);
+    terminal.feed(received.substr(0, beforeUpdates));
+    std::vector<size_t> initialWrites = terminal.rowWrites;
+    terminal.feed(received.substr(beforeUpdates));
+
+    auto row = [&](int index) { return plain(terminal.rows[index]); };
+    check("标题", row(0) == "GenshinAuto v2.4", row(0));
+    check("最后一次的状态", row(1) == "状态: 剧情对话中 " + std::to_string(updates - 1), row(1));
+    check("帧耗时", row(2).starts_with("帧耗时: 6 ms  平均: ") && row(2).ends_with("帧数: 2"), row(2));
+    check("计数器", row(3) == "按键: 5  推进对话: 1  ", row(3));
+    check("分隔线", row(4) == std::string(cols - 1, '-'));
+    // 面板共 lines - 1 行，事件区域只保留最近的 lines - 6 个事件，多行文本拆分为多个事件
+    check("最近的事件", row(5).ends_with("事件 6") && row(lines - 3).ends_with("第一行") && row(lines - 2).ends_with("第二行"), row(5));
+
+    // 状态更新期间只应该重写状态这一行 (不包括停止时把光标移到面板下方)
+    size_t refreshes = terminal.rowWrites[1] - initialWrites[1];
+    size_t otherWrites = 0;
+    for(size_t i = 0; i < static_cast<size_t>(lines - 1); i++)
+        otherWrites += i == 1 ? 0 : terminal.rowWrites[i] - initialWrites[i];
+    check("更新期间只重写状态行", refreshes > 0 && otherWrites == 0, "其他行重写 " + std::to_string(otherWrites) + " 次");
+
+    size_t updateBytes = received.size() - beforeUpdates;
+    printf("%d 次更新状态: 刷新 %zu 次, 写入 %zu 字节, 平均每次刷新 %zu 字节\n",
+        updates, refreshes, updateBytes, updateBytes / std::max<size_t>(refreshes, 1));
+
+    if(failures == 0)
+        printf("全部通过\n");
+    else printf("%d 项失败\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+// 进程监视工具
+//   processwatch <name>...                 每 200ms 扫描一次，输出指定进程的启动和退出
+//   processwatch --bench <count> <name>... 扫描 count 次，输出每次扫描的平均耗时
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+import process;
+
+
+int main(int argc, char* argv[]) {
+    int benchCount = 0;
+    int first = 1;
+
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0) {
+        benchCount = atoi(argv[2]);
+        first = 3;
+    }
+
+    std::vector<std::string> names(argv + first, argv + argc);
+    if (names.empty()) {
+        fprintf(stderr, "用法:\n  processwatch <name>...\n  processwatch --bench <count> <name>...\n");
+        return 1;
+    }
+
+    process::Watcher watcher(names);
+
+    if (benchCount > 0) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < benchCount; i++)
+            watcher.scan();
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        printf("扫描 %d 次，平均 %.1f us/次，匹配 %zu 个进程\n", benchCount, elapsed / benchCount, watcher.running().size());
+        return 0;
+    }
+
+    while (true) {
+        for (const process::Event& event: watcher.scan())
+            printf("%s %u %s\n", event.appeared ? "appear" : "exit  ", event.pid, event.name.c_str());
+        fflush(stdout);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+}
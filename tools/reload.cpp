@@ -0,0 +1,223 @@
+// 热重载的测试工具，用模拟的上下文代替 quickjs
+//   reload
+// 模拟的上下文与 qjs::Context 相同: 从运行时的编译缓存加载模块，脚本执行时添加计时器、创建原生资源，销毁时删除自己的计时器并释放资源
+// 在临时目录中依次检查: 没有修改的模块使用缓存；只改变修改时间或者只改变大小都会重新编译；
+// 替换上下文时旧的上下文的计时器和资源被释放，新的上下文的不受影响；加载时有语法错误则保留旧的上下文；
+// 脚本主动释放的资源不会被重复释放
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <optional>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <stdexcept>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+import reload;
+import timer;
+
+
+using namespace std::chrono_literals;
+
+int failures = 0;
+
+void check(const std::string& name, bool ok) {
+    failures += !ok;
+    printf("  %s: %s\n", name.c_str(), ok ? "通过" : "失败");
+}
+
+
+// 模拟的原生资源，记录每个编号被释放的次数
+std::map<uint32_t, int> releases {};
+uint32_t nextHandle = 1;
+
+auto createHandle() -> uint32_t {
+    uint32_t id = nextHandle++;
+    releases[id] = 0;
+    return id;
+}
+
+void destroyHandle(uint32_t id) {
+    releases[id]++;
+}
+
+bool isLive(uint32_t id) {
+    return releases.contains(id) && releases[id] == 0;
+}
+
+
+struct Runtime {
+    std::filesystem::path dir;
+    timer::Queue<int> timers {};                // 值为添加计时器的上下文
+    reload::Cache<std::string> moduleCache {};  // 模块名 -> "编译" 后的源码
+    int compiled = 0;
+    int cached = 0;
+};
+
+struct Context {
+    Runtime& rt;
+    int id;
+    reload::Resources resources {};
+    std::vector<uint32_t> handles {};
+
+    Context(Runtime& rt, int id) : rt(rt), id(id) {}
+
+    // 与 compileModule 相同: 文件的修改时间和大小都没有变化时使用缓存，否则读取并编译，编译失败的模块不缓存
+    void compile(const std::string& name) {
+        std::filesystem::path path = rt.dir / name;
+        std::optional<reload::Stamp> stamp = reload::stamp(path);
+        if(stamp && rt.moduleCache.find(name, *stamp)) {
+            rt.cached++;
+            return;
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        std::string code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if(code.find("syntax error") != std::string::npos)
+            throw std::runtime_error(name + ": SyntaxError");
+        rt.compiled++;
+        if(stamp)
+            rt.moduleCache.store(name, *stamp, code);
+    }
+
+    void load() {
+        compile("script.js");
+        compile("lib.js");
+    }
+
+    // 模拟的脚本: 添加一个计时器，创建两个资源并主动释放其中一个
+    void run() {
+        rt.timers.push(std::chrono::steady_clock::time_point {} + 1s, id);
+        for(int i = 0; i < 2; i++) {
+            handles.push_back(createHandle());
+            resources.own(destroyHandle, handles.back());
+        }
+        resources.release(destroyHandle, handles.front());
+    }
+
+    // 与 qjs::Context 的析构函数相同
+    ~Context() {
+        rt.timers.removeIf([&](int context) { return context == id; });
+        resources.releaseAll();
+    }
+};
+
+
+void write(const std::filesystem::path& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+}
+
+auto countTimers(Runtime& rt, int context) -> int {
+    int count = 0;
+    timer::Queue<int> kept;
+    while(auto timer = rt.timers.popDue(std::chrono::steady_clock::time_point::max())) {
+        count += timer->value == context;
+        kept.push(timer->timeout, timer->value);
+    }
+    rt.timers = std::move(kept);
+    return count;
+}
+
+
+int main() {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "genshin-reload-test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    write(dir / "script.js", "import './lib.js';");
+    write(dir / "lib.js", "export const a = 1;");
+
+    Runtime rt { dir };
+    reload::Slot<Context> slot;
+    int nextContext = 1;
+
+    // 与 runWithReload 相同: 新的上下文创建资源 (prepare) 并加载模块图，成功后替换旧的上下文再执行
+    // 返回加载失败时的错误信息
+    Context* previous = nullptr;
+    bool oldAliveDuringLoad = true;
+    uint32_t prepared = 0;
+    auto reload = [&]() -> std::optional<std::string> {
+        int compiled = rt.compiled, cached = rt.cached;
+        previous = slot.get();
+        std::optional<std::string> error = slot.replace([&]() {
+            auto fresh = std::make_unique<Context>(rt, nextContext++);
+            prepared = createHandle();
+            fresh->resources.own(destroyHandle, prepared);
+            fresh->load();
+            oldAliveDuringLoad = oldAliveDuringLoad && slot.get() == previous && (!previous || countTimers(rt, previous->id) == 1);
+            return fresh;
+        });
+        if(!error)
+            slot.get()->run();
+        printf("  (编译 %d 个，使用缓存 %d 个)\n", rt.compiled - compiled, rt.cached - cached);
+        return error;
+    };
+
+    printf("首次加载\n");
+    check("加载成功", !reload() && slot.get());
+    check("编译所有模块", rt.compiled == 2 && rt.cached == 0);
+    Context* first = slot.get();
+    std::vector<uint32_t> firstHandles = first->handles;
+    uint32_t firstPrepared = prepared;
+    check("主动释放的资源立即释放", !isLive(firstHandles[0]) && isLive(firstHandles[1]) && isLive(firstPrepared));
+
+    printf("没有修改时重新加载\n");
+    check("加载成功", !reload() && slot.get() != first);
+    check("全部使用缓存", rt.compiled == 2 && rt.cached == 2);
+    check("加载期间旧的上下文仍在运行", oldAliveDuringLoad);
+    check("旧的上下文的计时器被删除", countTimers(rt, 1) == 0 && countTimers(rt, 2) == 1);
+    check("旧的上下文的资源被释放", !isLive(firstHandles[1]) && !isLive(firstPrepared));
+    check("每个资源只释放一次", releases[firstHandles[0]] == 1 && releases[firstHandles[1]] == 1 && releases[firstPrepared] == 1);
+    check("新的上下文的资源不受影响", isLive(slot.get()->handles[1]) && isLive(prepared));
+
+    printf("修改时间变化，大小不变\n");
+    std::optional<reload::Stamp> before = reload::stamp(dir / "lib.js");
+    write(dir / "lib.js", "export const a = 2;");
+    std::filesystem::last_write_time(dir / "lib.js", before->writeTime + 2s);
+    check("缓存失效", !rt.moduleCache.find("lib.js", *reload::stamp(dir / "lib.js")));
+    check("只重新编译修改的模块", !reload() && rt.compiled == 3 && rt.cached == 3);
+
+    printf("大小变化，修改时间不变\n");
+    before = reload::stamp(dir / "lib.js");
+    write(dir / "lib.js", "export const a = 10;");
+    std::filesystem::last_write_time(dir / "lib.js", before->writeTime);
+    check("只重新编译修改的模块", !reload() && rt.compiled == 4 && rt.cached == 4);
+
+    printf("语法错误\n");
+    Context* running = slot.get();
+    int runningId = running->id;
+    std::vector<uint32_t> runningHandles = running->handles;
+    uint32_t runningPrepared = prepared;
+    write(dir / "lib.js", "export const a = syntax error;");
+    std::optional<std::string> error = reload();
+    check("报告错误: " + error.value_or(""), error && error->find("lib.js") != std::string::npos);
+    check("保留旧的上下文", slot.get() == running && countTimers(rt, runningId) == 1);
+    check("旧的上下文的资源不受影响", isLive(runningHandles[1]) && isLive(runningPrepared));
+    check("加载失败的上下文的资源被释放", prepared != runningPrepared && releases[prepared] == 1);
+
+    printf("修复语法错误\n");
+    write(dir / "lib.js", "export const a = 3;");
+    check("加载成功并替换", !reload() && slot.get() != running);
+    check("没有缓存编译失败的模块", rt.compiled == 5);
+    check("旧的上下文的计时器和资源被释放", countTimers(rt, runningId) == 0 && !isLive(runningHandles[1]) && !isLive(runningPrepared));
+
+    printf("文件不存在\n");
+    check("不缓存", !reload::stamp(dir / "missing.js"));
+
+    slot = {};
+    bool allReleased = true;
+    for(const auto& [id, count]: releases)
+        allReleased = allReleased && count == 1;
+    check("销毁最后一个上下文后所有资源都只释放了一次", allReleased && rt.timers.empty());
+
+    std::filesystem::remove_all(dir);
+
+    if(failures == 0)
+        printf("全部通过\n");
+    else printf("%d 项失败\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// 计时器队列和虚拟时钟的测试工具，用模拟的事件循环代替 quickjs
+//   timers
+// 与 Context::loop 相同，每次执行最多一个到期的计时器，没有到期的计时器时让时钟等待到下一个到期时间
+// 在虚拟时钟上依次检查: 到期时间相同的计时器按添加的顺序执行；回调中添加的计时器和同步 sleep 推进的时间；
+// 销毁上下文时只删除这个上下文的计时器；Date.now 的时间；虚拟的 1 小时不需要真实等待；两次运行的结果完全相同
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+
+import timer;
+
+
+using namespace std::chrono_literals;
+
+int failures = 0;
+
+void check(const std::string& name, bool ok) {
+    failures += !ok;
+    printf("  %s: %s\n", name.c_str(), ok ? "通过" : "失败");
+}
+
+
+struct Callback {
+    std::function<void()> func;
+    int context;        // 添加计时器的上下文
+};
+
+struct EventLoop {
+    timer::VirtualClock clock { 1700000000000.0 };
+    timer::Queue<Callback> timers {};
+    std::vector<std::string> trace {};
+
+    void setTimeout(const char* name, int delayMs, std::function<void()> body = nullptr, int context = 1) {
+        timers.push(clock.now() + std::chrono::milliseconds(delayMs), { [this, name, body]() {
+            // 记录计时器的名称和执行时的 Date.now (相对于开始时间)
+            trace.push_back(std::string(name) + "@" + std::to_string(static_cast<long long>(clock.epochMs() - 1700000000000.0)));
+            if(body)
+                body();
+        }, context });
+    }
+
+    void loop() {
+        while(!timers.empty()) {
+            if(auto timer = timers.popDue(clock.now()))
+                timer->value.func();
+            else clock.sleepUntil(timers.nextTimeout());
+        }
+    }
+};
+
+
+auto run() -> std::vector<std::string> {
+    EventLoop loop;
+
+    loop.setTimeout("a", 100);
+    loop.setTimeout("b", 0, [&]() {
+        // 同步 sleep 推进虚拟时间，之后添加的计时器从新的时间开始计算
+        loop.clock.sleepFor(30ms);
+        loop.setTimeout("f", 0, [&]() {
+            // 模拟热重载时销毁上下文 2，只删除它添加的计时器
+            loop.timers.removeIf([](const Callback& callback) { return callback.context == 2; });
+        });
+    });
+    loop.setTimeout("c", 100);
+    loop.setTimeout("d", 50, [&]() { loop.setTimeout("e", 50); });
+    loop.setTimeout("h", 75, nullptr, 2);
+    loop.setTimeout("g", 3600000);
+
+    loop.loop();
+    return loop.trace;
+}
+
+
+auto join(const std::vector<std::string>& items) -> std::string {
+    std::string result;
+    for(const std::string& item: items)
+        result += (result.empty() ? "" : " ") + item;
+    return result;
+}
+
+
+int main() {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> first = run();
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::vector<std::string> second = run();
+
+    // b 在 0ms 执行并 sleep 30ms，f 在 30ms 执行并删除上下文 2 的 h；d 在 50ms 添加 e，
+    // e 与 a、c 同时到期，但编号最大，排在最后；g 在虚拟的 1 小时后执行
+    const std::vector<std::string> expected = { "b@0", "f@30", "d@50", "a@100", "c@100", "e@100", "g@3600000" };
+
+    printf("执行顺序: %s\n", join(first).c_str());
+    check("与预期的顺序和时间相同", first == expected);
+    check("两次运行的结果相同", first == second);
+    check("虚拟的 1 小时用时 " + std::to_string(static_cast<int>(elapsedMs * 1000)) + " us", elapsedMs < 100);
+
+    printf("计时器队列\n");
+    timer::Queue<int> queue;
+    auto now = std::chrono::steady_clock::time_point {};
+    uint32_t id0 = queue.push(now + 10ms, 0), id1 = queue.push(now + 10ms, 1), id2 = queue.push(now, 2);
+    check("编号按添加的顺序递增", id0 == 0 && id1 == 1 && id2 == 2);
+    check("没有到期时不取出", queue.popDue(now + 5ms)->value == 2 && !queue.popDue(now + 5ms));
+    check("下一个到期时间", queue.nextTimeout() == now + 10ms);
+    queue.removeIf([](int value) { return value == 0; });
+    check("删除后其它计时器仍然按顺序到期", queue.size() == 1 && queue.popDue(now + 10ms)->value == 1 && queue.empty());
+
+    if(failures == 0)
+        printf("全部通过\n");
+    else printf("%d 项失败\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+// 性能追踪的开销测试工具
+//   tracebench [threads] [spans] [output]
+// 每个线程连续记录 spans 个范围事件，分别测量关闭和开启追踪时每个事件的平均耗时，
+// 然后把开启时记录的事件导出到 output (默认为 trace.json)，可以在 chrome://tracing 或 https://ui.perfetto.dev 中打开检查
+// 线程数默认为 CPU 核心数，超过核心数时耗时中包含等待调度的时间
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+import trace;
+
+
+// 所有线程同时记录 spans 个事件，返回每个事件的平均耗时 (ns)
+double measure(int threads, int spans) {
+    std::vector<double> perSpanNs(threads);
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&, i]() {
+            trace::setThreadName("worker " + std::to_string(i));
+
+            auto start = std::chrono::steady_clock::now();
+            for (int j = 0; j < spans; j++) {
+                trace::Span span("bench", "tool");
+            }
+            perSpanNs[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / spans;
+        });
+    }
+
+    double total = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[i].join();
+        total += perSpanNs[i];
+    }
+    return total / threads;
+}
+
+
+int main(int argc, char* argv[]) {
+    int threads = argc >= 2 ? atoi(argv[1]) : static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    int spans = argc >= 3 ? atoi(argv[2]) : 1000000;
+    std::string output = argc >= 4 ? argv[3] : "trace.json";
+
+    if (threads <= 0 || spans <= 0) {
+        fprintf(stderr, "用法:\n  tracebench [threads] [spans] [output]\n");
+        return 1;
+    }
+
+    double disabledNs = measure(threads, spans);
+
+    trace::enable();
+    double enabledNs = measure(threads, spans);
+
+    auto start = std::chrono::steady_clock::now();
+    bool saved = trace::exportJson(output);
+    double exportMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    auto [events, overwritten, bufferThreads] = trace::stats();
+    printf("%d 个线程, 每个线程 %d 个事件\n", threads, spans);
+    printf("  关闭 %.2f ns/事件, 开启 %.2f ns/事件\n", disabledNs, enabledNs);
+    printf("  记录 %.0f 个事件 (覆盖 %.0f 个), %.0f 个线程, 导出 %s %.1f ms\n",
+        events.second, overwritten.second, bufferThreads.second, saved ? "成功" : "失败", exportMs);
+
+    return saved && events.second == static_cast<double>(threads) * spans ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+// 事件循环看门狗的测试工具，用模拟的事件循环代替 quickjs
+//   watchdog [budgetMs]
+// 模拟的 JS 代码在忙等待的同时定期调用 interrupt，与 quickjs 执行 JS 代码时调用中断回调的方式相同
+// 依次检查: 第一帧开始之前和空闲时不算卡顿；预算 budgetMs (默认 50) 以内的帧不报告；
+// 慢脚本只报告一次并记录调用栈；卡在原生函数中时记录原生函数的名称；开启中断时慢脚本在预算之后不久就被中断；
+// 卡顿的帧之后的下一帧不受影响
+
+#include <string>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+import watchdog;
+
+
+using Clock = std::chrono::steady_clock;
+using Watchdog = watchdog::Watchdog<const char*>;
+
+int failures = 0;
+
+void check(const std::string& name, bool ok) {
+    failures += !ok;
+    printf("  %s: %s\n", name.c_str(), ok ? "通过" : "失败");
+}
+
+auto elapsedMs(Clock::time_point start) -> double {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+// 模拟一帧 JS 代码: 忙等待 durationMs，每 0.1ms 调用一次 interrupt
+// 返回 interrupt 是否要求中断；被中断时立即结束这一帧
+struct Script {
+    int captures = 0;
+
+    bool run(Watchdog& dog, double durationMs, const char* stack) {
+        auto start = Clock::now();
+        auto nextCheck = start;
+        while(elapsedMs(start) < durationMs) {
+            if(Clock::now() < nextCheck)
+                continue;
+            nextCheck += std::chrono::microseconds(100);
+
+            watchdog::Interrupt action = dog.interrupt();
+            if(action == watchdog::Interrupt::None)
+                continue;
+
+            captures++;
+            dog.stack = stack;
+            if(action == watchdog::Interrupt::Abort)
+                return true;
+        }
+        return false;
+    }
+};
+
+
+// 执行一帧，返回这一帧是否被报告为卡顿
+auto tick(Watchdog& dog, const std::function<void()>& body, watchdog::StallReport& report, double& tickMs) -> bool {
+    auto start = Clock::now();
+    dog.beginTick();
+    body();
+    tickMs = elapsedMs(start);
+    return dog.endTick(tickMs, report);
+}
+
+
+int main(int argc, char* argv[]) {
+    double budgetMs = argc >= 2 ? atof(argv[1]) : 50;
+    if(budgetMs <= 0) {
+        fprintf(stderr, "用法:\n  watchdog [budgetMs]\n");
+        return 1;
+    }
+
+    Watchdog dog;
+    Script script;
+    watchdog::StallReport report {};
+    double tickMs = 0;
+
+    printf("开始之前 (预算 %.0f ms)\n", budgetMs);
+    check("没有开始任何一帧时不算卡顿", !dog.isStalled() && dog.interrupt() == watchdog::Interrupt::None);
+    dog.start(budgetMs, false);
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(budgetMs * 3));
+    check("空闲超过预算也不算卡顿", !dog.isStalled() && dog.interrupt() == watchdog::Interrupt::None);
+
+    printf("预算以内的帧\n");
+    int stalledTicks = 0;
+    for(int i = 0; i < 20; i++)
+        stalledTicks += tick(dog, [&]() { script.run(dog, budgetMs / 10, "fast"); }, report, tickMs);
+    check("20 帧都没有报告卡顿", stalledTicks == 0 && script.captures == 0);
+
+    printf("慢脚本\n");
+    bool stalled = tick(dog, [&]() { script.run(dog, budgetMs * 4, "at slowLoop (script.js:10)"); }, report, tickMs);
+    check("报告卡顿 (" + std::to_string(static_cast<int>(tickMs)) + " ms)", stalled && report.durationMs >= budgetMs * 4);
+    check("只记录一次调用栈", script.captures == 1 && report.stack == "at slowLoop (script.js:10)" && !report.aborted);
+
+    printf("卡在原生函数中\n");
+    stalled = tick(dog, [&]() {
+        dog.currentBinding.store("captureWindow");
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(budgetMs * 3));
+        dog.currentBinding.store(nullptr);
+        // 回到 JS 代码后第一次调用中断回调时记录调用栈
+        script.run(dog, 1, "at capture (script.js:20)");
+    }, report, tickMs);
+    const char* binding = dog.stalledBinding.load();
+    check("报告卡顿", stalled);
+    check("记录正在执行的原生函数", binding && std::string(binding) == "captureWindow" && report.stack == "at capture (script.js:20)");
+
+    printf("卡顿之后的下一帧\n");
+    stalled = tick(dog, [&]() { script.run(dog, budgetMs / 10, "fast"); }, report, tickMs);
+    check("不受上一帧的影响", !stalled && !dog.isStalled());
+
+    printf("开启中断\n");
+    dog.start(budgetMs, true);
+    bool interrupted = false;
+    stalled = tick(dog, [&]() { interrupted = script.run(dog, budgetMs * 20, "at endless (script.js:30)"); }, report, tickMs);
+    check("慢脚本被中断 (" + std::to_string(static_cast<int>(tickMs)) + " ms)", interrupted && stalled && report.aborted && tickMs < budgetMs * 3);
+
+    stalled = tick(dog, [&]() { interrupted = script.run(dog, budgetMs / 10, "fast"); }, report, tickMs);
+    check("下一帧正常执行", !stalled && !interrupted && !dog.aborted);
+
+    dog.start(0, false);
+    check("关闭后不再检测", !dog.thread.joinable());
+    printf("共 %.0f 次卡顿，最长的一帧 %.1f ms\n", dog.stalls, dog.worstTickMs);
+
+    if(failures == 0)
+        printf("全部通过\n");
+    else printf("%d 项失败\n", failures);
+    return failures == 0 ? 0 : 1;
+}